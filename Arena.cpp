@@ -0,0 +1,143 @@
+#include "Arena.hpp"
+#include "Numa.hpp"
+#include "Slab.hpp"
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstdint>
+
+namespace slab {
+
+namespace {
+
+inline std::size_t log2Of(std::size_t bytes) { return static_cast<std::size_t>(__builtin_ctzll(bytes)); }
+
+} // namespace
+
+Arena::Arena(std::size_t region_bytes, HugePages huge_pages, int node)
+    : region_bytes_(std::max(kHugePageSize, (region_bytes + kHugePageSize - 1) & ~(kHugePageSize - 1))),
+      node_(node),
+      huge_pages_(huge_pages),
+      extent_meta_(sizeof(Extent)) {}
+
+Arena::~Arena() {
+    for (Extent* region = regions_; region != nullptr; region = region->next) {
+        munmap(region->base, region->bytes);
+    }
+}
+
+void* Arena::allocate(std::size_t bytes) {
+    if (bytes < kMinSpan || (bytes & (bytes - 1)) != 0) return nullptr;
+    std::size_t order = log2Of(bytes);
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    // A freed span of this size, else split the smallest larger one
+    for (std::size_t from = order; from < kOrders; ++from) {
+        Extent* extent = free_[from];
+        if (extent == nullptr) continue;
+        free_[from] = extent->next;
+        char* span = extent->base;
+        extent_meta_.deallocate(extent);
+        while (from > order) {
+            --from;
+            pushFree(span + (std::size_t{1} << from), from);   // the upper half
+        }
+        return span;
+    }
+
+    // Carve from the current region; the padding that aligns the span
+    // goes on the free lists rather than being lost
+    char* aligned = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(bump_) + bytes - 1) & ~(bytes - 1));
+    if (bump_ == nullptr || aligned + bytes > bumpEnd_) {
+        if (!mapRegion(std::max(region_bytes_, bytes), std::max(kHugePageSize, bytes))) return nullptr;
+        aligned = bump_;
+    }
+    releaseRange(bump_, aligned);
+    bump_ = aligned + bytes;
+    return aligned;
+}
+
+void Arena::deallocate(void* span, std::size_t bytes) {
+    // Huge TLB pages can only be dropped whole: on those regions this
+    // fails and the span stays committed until it is reused
+    madvise(span, bytes, MADV_DONTNEED);
+    std::lock_guard<std::mutex> guard(mutex_);
+    pushFree(static_cast<char*>(span), log2Of(bytes));
+}
+
+HugePages Arena::huge_pages() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return huge_pages_;
+}
+
+void Arena::lock() {
+    mutex_.lock();
+    extent_meta_.lock();   // taken under mutex_ everywhere else too
+}
+
+void Arena::unlock() {
+    extent_meta_.unlock();
+    mutex_.unlock();
+}
+
+std::size_t Arena::reserved_bytes() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return reserved_bytes_;
+}
+
+bool Arena::mapRegion(std::size_t bytes, std::size_t alignment) {
+    bytes = (bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    Extent* region = static_cast<Extent*>(extent_meta_.allocate());
+    if (region == nullptr) return false;
+
+    void* memory = nullptr;
+    if (huge_pages_ == HugePages::kExplicit && alignment == kHugePageSize) {
+        memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED) {
+            memory = nullptr;
+            huge_pages_ = HugePages::kTransparent;   // none reserved, or not supported
+        }
+    }
+    if (memory == nullptr) {
+        // MAP_NORESERVE: the region is address space, not a commitment
+        memory = mapAligned(bytes, alignment, MAP_NORESERVE);
+        if (memory == nullptr) {
+            extent_meta_.deallocate(region);
+            return false;
+        }
+        if (huge_pages_ == HugePages::kTransparent) madvise(memory, bytes, MADV_HUGEPAGE);
+    }
+    if (node_ >= 0) preferNumaNode(memory, bytes, static_cast<unsigned>(node_));   // before any page is touched
+
+    releaseRange(bump_, bumpEnd_);
+    region->base = static_cast<char*>(memory);
+    region->bytes = bytes;
+    region->next = regions_;
+    regions_ = region;
+    reserved_bytes_ += bytes;
+    bump_ = region->base;
+    bumpEnd_ = region->base + bytes;
+    return true;
+}
+
+void Arena::pushFree(char* base, std::size_t order) {
+    Extent* extent = static_cast<Extent*>(extent_meta_.allocate());
+    if (extent == nullptr) return;   // the span stays reserved but unused
+    extent->base = base;
+    extent->bytes = std::size_t{1} << order;
+    extent->next = free_[order];
+    free_[order] = extent;
+}
+
+void Arena::releaseRange(char* begin, char* end) {
+    // Largest naturally aligned piece at each step; every offset in a
+    // region is a multiple of kMinSpan, so nothing smaller is left over
+    while (begin < end) {
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(begin);
+        std::size_t order = log2Of(address);
+        while ((std::size_t{1} << order) > static_cast<std::size_t>(end - begin)) --order;
+        pushFree(begin, order);
+        begin += std::size_t{1} << order;
+    }
+}
+
+} // namespace slab
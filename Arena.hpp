@@ -0,0 +1,73 @@
+#pragma once
+
+#include "MetaAllocator.hpp"
+#include <cstddef>
+#include <mutex>
+
+namespace slab {
+
+enum class HugePages {
+    kNone,          // ordinary 4KB pages
+    kTransparent,   // madvise(MADV_HUGEPAGE): the kernel backs regions with 2MB pages where it can
+    kExplicit,      // MAP_HUGETLB from the reserved pool; falls back to kTransparent if none are free
+};
+
+// Address space beneath the slabs. Regions of region_bytes are reserved
+// with one mmap each and carved into spans, so the slabs of a pool sit
+// side by side instead of wherever the kernel put each mapping. Pages are
+// committed when first touched. A freed span goes back to the OS with
+// madvise(MADV_DONTNEED) and is reused for the next span of its size.
+// Regions themselves are unmapped only when the arena is destroyed.
+// Thread-safe.
+class Arena {
+public:
+    static constexpr std::size_t kHugePageSize = std::size_t{2} << 20;
+    static constexpr std::size_t kMinSpan = std::size_t{1} << 12;
+
+    // region_bytes is rounded up to whole huge pages. With node >= 0 each
+    // region prefers that NUMA node's memory.
+    Arena(std::size_t region_bytes, HugePages huge_pages, int node = -1);
+    ~Arena();
+
+    // bytes is a power of two of at least kMinSpan; the span is aligned to
+    // bytes. nullptr if a new region cannot be mapped.
+    void* allocate(std::size_t bytes);
+    void  deallocate(void* span, std::size_t bytes);   // decommit; the address range stays reserved
+
+    std::size_t reserved_bytes() const;             // every region mapped so far
+    HugePages   huge_pages() const;                 // kTransparent after an explicit fallback
+
+    void lock();                                    // the arena and its extent table, for fork handlers
+    void unlock();
+
+    Arena(const Arena&)            = delete;
+    Arena& operator=(const Arena&) = delete;
+
+private:
+    static constexpr std::size_t kOrders = 64;
+
+    // A free span or a region; kept off the span itself so that
+    // recording a free span does not fault its first page back in
+    struct Extent {
+        char*       base;
+        std::size_t bytes;
+        Extent*     next;
+    };
+
+    const std::size_t region_bytes_;
+    const int         node_;
+    HugePages         huge_pages_;
+    mutable std::mutex mutex_;
+    Extent*           free_[kOrders] = {};   // free spans by log2 of their size
+    Extent*           regions_ = nullptr;
+    std::size_t       reserved_bytes_ = 0;
+    char*             bump_ = nullptr;       // carved in address order from the newest region
+    char*             bumpEnd_ = nullptr;
+    MetaAllocator     extent_meta_;
+
+    bool  mapRegion(std::size_t bytes, std::size_t alignment); // new current region; the old one's tail goes on the free lists
+    void  pushFree(char* base, std::size_t order);
+    void  releaseRange(char* begin, char* end); // free [begin, end) as naturally aligned spans
+};
+
+} // namespace slab
@@ -0,0 +1,95 @@
+#include "BitmapSlab.hpp"
+#include "PageMap.hpp"
+#include <sys/mman.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace slab {
+
+BitmapSlab::BitmapSlab(std::size_t chunkSize, std::size_t bytes)
+    : chunkSize_(chunkSize < 1 ? 1 : chunkSize),
+      chunks_((bytes > kMaxBytes ? kMaxBytes : bytes) / chunkSize_),
+      words_((chunks_ + 255) / 256 * 4),
+      mappedBytes_(0),
+      memory_(nullptr),
+      free_(nullptr),
+      // Exact for every offset below kMaxBytes: the rounding error stays
+      // under 2^-21, smaller than the gap between any two quotients
+      indexMagic_((std::uint64_t{1} << kIndexShift) / chunkSize_ + 1) {
+    // The bitmap starts on its own cache line after the chunks, aligned
+    // for 256-bit loads
+    std::size_t bitmap_offset = (chunks_ * chunkSize_ + 63) & ~std::size_t{63};
+    mappedBytes_ = (bitmap_offset + words_ * sizeof(std::uint64_t) + PageMap::kPageSize - 1) & ~(PageMap::kPageSize - 1);
+    memory_ = static_cast<char*>(mapAligned(mappedBytes_, PageMap::kPageSize));
+    if (memory_ == nullptr) {
+        // An empty bitmap: allocate() always fails without reading free_
+        chunks_ = 0;
+        words_ = 0;
+        mappedBytes_ = 0;
+        return;
+    }
+    free_ = reinterpret_cast<std::uint64_t*>(memory_ + bitmap_offset);
+    for (std::size_t w = 0; w < words_; ++w) free_[w] = validBits(w);
+}
+
+BitmapSlab::~BitmapSlab() {
+    if (memory_ != nullptr) munmap(memory_, mappedBytes_);
+}
+
+void* BitmapSlab::allocate() {
+    std::size_t w = firstFree_;
+#if defined(__AVX2__)
+    // Up to a 256-bit boundary one word at a time, then four words per test
+    while (w < words_ && (w & 3) != 0 && free_[w] == 0) ++w;
+    if (w < words_ && (w & 3) == 0) {
+        for (; w < words_; w += 4) {
+            __m256i group = _mm256_load_si256(reinterpret_cast<const __m256i*>(free_ + w));
+            if (!_mm256_testz_si256(group, group)) break;
+        }
+        while (w < words_ && free_[w] == 0) ++w;
+    }
+#else
+    while (w < words_ && free_[w] == 0) ++w;
+#endif
+    firstFree_ = w;
+    if (w >= words_) return nullptr;
+
+    std::uint64_t bits = free_[w];
+    std::size_t index = w * 64 + static_cast<std::size_t>(__builtin_ctzll(bits));
+    free_[w] = bits & (bits - 1);
+    ++liveChunks_;
+    return memory_ + index * chunkSize_;
+}
+
+bool BitmapSlab::deallocate(void* ptr) {
+    std::size_t index;
+    if (!chunkIndex(ptr, index)) return false;
+    std::uint64_t bit = std::uint64_t{1} << (index % 64);
+    std::uint64_t& word = free_[index / 64];
+    if (word & bit) return false;   // already free
+    word |= bit;
+    --liveChunks_;
+    if (index / 64 < firstFree_) firstFree_ = index / 64;
+    return true;
+}
+
+bool BitmapSlab::is_live(const void* ptr) const {
+    std::size_t index;
+    return chunkIndex(ptr, index) && (free_[index / 64] & (std::uint64_t{1} << (index % 64))) == 0;
+}
+
+std::size_t BitmapSlab::count_live() const {
+    std::size_t free_chunks = 0;
+    for (std::size_t w = 0; w < words_; ++w) free_chunks += static_cast<std::size_t>(__builtin_popcountll(free_[w]));
+    return chunks_ - free_chunks;
+}
+
+bool BitmapSlab::chunkIndex(const void* ptr, std::size_t& index) const {
+    if (!contains(ptr)) return false;
+    std::size_t offset = static_cast<std::size_t>(static_cast<const char*>(ptr) - memory_);
+    index = static_cast<std::size_t>((offset * indexMagic_) >> kIndexShift);
+    return index * chunkSize_ == offset;
+}
+
+} // namespace slab
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Slab.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace slab {
+
+// Slab variant that tracks its chunks in an occupancy bitmap kept after
+// the chunk area, instead of a free list threaded through the chunks.
+// Nothing is written into a freed chunk, so chunks can be any size down
+// to one byte. Allocation always takes the lowest free address, found
+// with tzcnt, skipping 256 fully used chunks per AVX2 test. Frees of a
+// pointer that is not a live chunk are detected and refused. Live chunks
+// can be enumerated. Single-threaded.
+class BitmapSlab {
+public:
+    static constexpr std::size_t kMaxBytes = std::size_t{2} << 20;   // keeps the index arithmetic exact
+
+    BitmapSlab(std::size_t chunkSize, std::size_t bytes = Slab::kSlabSize); // maps its own memory; chunkSize >= 1, bytes <= kMaxBytes
+    ~BitmapSlab();
+
+    void* allocate();               // lowest free chunk; nullptr if full or the mapping failed
+    bool  deallocate(void* ptr);    // false, changing nothing, if ptr is not a live chunk of this slab (a double free)
+
+    bool  is_live(const void* ptr) const;
+    inline bool empty() const { return liveChunks_ == 0; }
+    inline bool full() const { return liveChunks_ == chunks_; }
+    inline std::size_t live_chunks() const { return liveChunks_; }
+    std::size_t count_live() const; // popcount over the bitmap; always equals live_chunks()
+    inline std::size_t chunk_count() const { return chunks_; }
+    inline std::size_t chunk_size() const { return chunkSize_; }
+    inline void* memory() const { return memory_; }
+    inline bool contains(const void* ptr) const {
+        const char* p = static_cast<const char*>(ptr);
+        return p >= memory_ && p < memory_ + chunks_ * chunkSize_;
+    }
+
+    template <typename Fn>
+    void for_each_live(Fn fn) const {   // fn(void*) for every live chunk, in address order
+        for (std::size_t w = 0; w < words_; ++w) {
+            std::uint64_t live = ~free_[w] & validBits(w);
+            while (live != 0) {
+                fn(memory_ + (w * 64 + static_cast<std::size_t>(__builtin_ctzll(live))) * chunkSize_);
+                live &= live - 1;
+            }
+        }
+    }
+
+    BitmapSlab(const BitmapSlab&)            = delete;
+    BitmapSlab& operator=(const BitmapSlab&) = delete;
+
+private:
+    static constexpr unsigned kIndexShift = 42;
+
+    std::size_t    chunkSize_;
+    std::size_t    chunks_;
+    std::size_t    words_;          // 64-bit bitmap words, padded to a multiple of four
+    std::size_t    mappedBytes_;
+    char*          memory_;         // chunks, then the bitmap
+    std::uint64_t* free_;           // bit set: chunk free; padding bits stay clear
+    std::uint64_t  indexMagic_;     // offset * indexMagic_ >> kIndexShift == offset / chunkSize_
+    std::size_t    liveChunks_ = 0;
+    std::size_t    firstFree_ = 0;  // no free bit in any word before this one
+
+    inline std::uint64_t validBits(std::size_t w) const {
+        std::size_t first = w * 64;
+        if (first >= chunks_) return 0;
+        return chunks_ - first >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << (chunks_ - first)) - 1;
+    }
+    bool chunkIndex(const void* ptr, std::size_t& index) const;   // false if ptr is not the start of a chunk
+};
+
+} // namespace slab
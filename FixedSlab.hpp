@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Slab.hpp"
+#include <sys/mman.h>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace slab {
+
+template <std::size_t ChunkSize, std::size_t SlabBytes>
+class FixedPool;
+
+// Slab whose geometry is fixed at compile time. Chunk count, stride and
+// bounds are constants, so there is nothing to divide or load. The header
+// lives at the end of the slab's own SlabBytes-aligned mapping: the slab
+// owning a chunk is the chunk's address with its low bits masked off, plus a
+// constant, with no page map. Single-threaded; see FixedPool for the list
+// management.
+template <std::size_t ChunkSize, std::size_t SlabBytes = Slab::kSlabSize>
+class FixedSlab {
+    friend class FixedPool<ChunkSize, SlabBytes>;
+
+public:
+    static_assert(ChunkSize >= sizeof(Node) && ChunkSize % alignof(Node) == 0,
+                  "a free chunk must hold a Node");
+    static_assert((SlabBytes & (SlabBytes - 1)) == 0 && SlabBytes >= Slab::kSlabAlignment,
+                  "owner() masks addresses: SlabBytes must be a power of two of at least a page");
+
+    static constexpr std::size_t kChunkSize = ChunkSize;
+    static constexpr std::size_t kSlabBytes = SlabBytes;
+    // Chunks start at the aligned base, so each keeps the natural alignment
+    // of ChunkSize. The header goes after the last one, in the slack
+    // SlabBytes % ChunkSize when it fits there: at most one chunk is lost.
+    static constexpr std::size_t kHeaderBytes = sizeof(Node*) + sizeof(char*) + sizeof(std::size_t) + 2 * sizeof(FixedSlab*);
+    static constexpr std::size_t kChunks = (SlabBytes - kHeaderBytes) / ChunkSize;
+    static constexpr std::size_t kHeaderOffset = SlabBytes - kHeaderBytes;
+    static constexpr std::size_t kAlignment = ChunkSize & (~ChunkSize + 1);
+
+    static_assert(kChunks >= 1, "SlabBytes too small for ChunkSize");
+
+    static FixedSlab* create() {            // nullptr if mmap fails
+        static_assert(sizeof(FixedSlab) <= kHeaderBytes, "header overlaps the last chunk");
+        static_assert(kHeaderOffset % alignof(FixedSlab) == 0, "header misaligned");
+        char* memory = static_cast<char*>(mapAligned(SlabBytes, SlabBytes));
+        return memory != nullptr ? new (memory + kHeaderOffset) FixedSlab() : nullptr;
+    }
+    static void destroy(FixedSlab* slab) {
+        char* memory = slab->base();
+        slab->~FixedSlab();
+        munmap(memory, SlabBytes);
+    }
+    static inline FixedSlab* owner(const void* ptr) {
+        return reinterpret_cast<FixedSlab*>((reinterpret_cast<std::uintptr_t>(ptr) & ~(SlabBytes - 1)) + kHeaderOffset);
+    }
+
+    inline void* allocate() {               // nullptr if full
+        if (freeList_ != nullptr) {
+            Node* node = freeList_;
+            freeList_ = node->next;
+            ++liveChunks_;
+            return node;
+        }
+        if (bump_ == base() + kChunks * ChunkSize) return nullptr;
+        void* chunk = bump_;
+        bump_ += ChunkSize;
+        ++liveChunks_;
+        return chunk;
+    }
+    inline void deallocate(void* ptr) {     // ptr must be a chunk of this slab
+        Node* node = static_cast<Node*>(ptr);
+        node->next = freeList_;
+        freeList_ = node;
+        --liveChunks_;
+    }
+
+    inline bool empty() const { return liveChunks_ == 0; }
+    inline bool full() const { return liveChunks_ == kChunks; }
+    inline std::size_t live_chunks() const { return liveChunks_; }
+    inline bool contains(const void* ptr) const {
+        const char* p = static_cast<const char*>(ptr);
+        return p >= base() && p < base() + kChunks * ChunkSize;
+    }
+
+    FixedSlab(const FixedSlab&)            = delete;
+    FixedSlab& operator=(const FixedSlab&) = delete;
+
+private:
+    FixedSlab() : bump_(base()) {}
+    ~FixedSlab() = default;
+
+    inline char* base() { return reinterpret_cast<char*>(this) - kHeaderOffset; }
+    inline const char* base() const { return reinterpret_cast<const char*>(this) - kHeaderOffset; }
+
+    Node*       freeList_ = nullptr;  // recycled chunks
+    char*       bump_;                // next never-used chunk, carved lazily like Slab
+    std::size_t liveChunks_ = 0;
+
+    // Owned by FixedPool's slab lists
+    FixedSlab*  prev_ = nullptr;
+    FixedSlab*  next_ = nullptr;
+};
+
+} // namespace slab
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "Slab.hpp"
+#include <sys/mman.h>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace slab {
+
+// Pool of T addressed by 32-bit handles instead of pointers: IndexBits of
+// slot index and the rest generation. A handle resolves through one load
+// from the slot array, which gives the object's position; a handle whose
+// object was destroyed no longer matches its slot's generation and
+// resolves to nullptr. Live objects are kept packed at the front of one
+// array (a destroy moves the last object into the hole), so iterating over
+// them is a linear scan. Objects therefore move: hold handles, not
+// pointers, across a destroy. The arrays are reserved once for capacity
+// objects with mmap and committed as they fill, so growing never copies.
+// Not thread-safe.
+//
+// A freed slot waits behind kReuseAfter others before it is handed out
+// again, and its generation advances twice per use (odd while live). A
+// stale handle is caught until its slot has been reused
+// 2^(31 - IndexBits) times.
+template <typename T, unsigned IndexBits = 24>
+class HandlePool {
+    static_assert(IndexBits >= 8 && IndexBits <= 28, "leave room for the generation");
+    static_assert(std::is_nothrow_move_constructible_v<T>, "destroy() moves the last object into the hole");
+    static_assert(alignof(T) <= Slab::kSlabAlignment, "the object array is page aligned");
+
+public:
+    static constexpr std::uint32_t kIndexMask = (std::uint32_t{1} << IndexBits) - 1;
+    static constexpr std::uint32_t kMaxObjects = std::uint32_t{1} << IndexBits;
+    static constexpr std::uint32_t kReuseAfter = 1024;
+
+    struct Handle {
+        std::uint32_t value = 0;            // 0 is never a live object's handle
+
+        inline std::uint32_t index() const { return value & kIndexMask; }
+        inline std::uint32_t generation() const { return value >> IndexBits; }
+        inline explicit operator bool() const { return value != 0; }
+        inline bool operator==(const Handle& other) const { return value == other.value; }
+    };
+
+    explicit HandlePool(std::uint32_t capacity = kMaxObjects)
+        : capacity_(capacity < kMaxObjects ? capacity : kMaxObjects) {
+        slots_ = static_cast<Slot*>(reserve(capacity_ * sizeof(Slot)));
+        owners_ = static_cast<std::uint32_t*>(reserve(capacity_ * sizeof(std::uint32_t)));
+        objects_ = static_cast<T*>(reserve(capacity_ * sizeof(T)));
+        if (slots_ == nullptr || owners_ == nullptr || objects_ == nullptr) {
+            release();
+            capacity_ = 0;   // create() always fails
+        }
+    }
+    ~HandlePool() {
+        for (std::uint32_t position = 0; position < size_; ++position) objects_[position].~T();
+        release();
+    }
+
+    template <typename... Args>
+    Handle create(Args&&... args) {         // a null handle if the pool is full; exceptions from T's constructor propagate, changing nothing
+        if (size_ == capacity_) return Handle{};
+        new (objects_ + size_) T(std::forward<Args>(args)...);
+
+        std::uint32_t index;
+        if (free_count_ > kReuseAfter || slot_count_ == capacity_) {
+            index = free_head_;
+            free_head_ = slots_[index].position;
+            --free_count_;
+        } else {
+            index = slot_count_++;
+        }
+        Slot& slot = slots_[index];
+        slot.position = size_;
+        slot.generation = nextGeneration(slot.generation);
+        owners_[size_++] = index;
+        return Handle{slot.generation << IndexBits | index};
+    }
+
+    bool destroy(Handle handle) {           // false, changing nothing, if the handle is stale or null
+        T* object = get(handle);
+        if (object == nullptr) return false;
+        std::uint32_t index = handle.index();
+        std::uint32_t last = size_ - 1;
+        std::uint32_t position = slots_[index].position;
+
+        object->~T();
+        if (position != last) {
+            new (object) T(std::move(objects_[last]));
+            objects_[last].~T();
+            owners_[position] = owners_[last];
+            slots_[owners_[position]].position = position;
+        }
+        --size_;
+
+        Slot& slot = slots_[index];
+        slot.generation = nextGeneration(slot.generation);   // even: free
+        if (free_count_++ == 0) free_head_ = index;
+        else slots_[free_tail_].position = index;
+        free_tail_ = index;
+        return true;
+    }
+
+    inline T* get(Handle handle) const {    // nullptr if stale or null
+        std::uint32_t index = handle.index();
+        if (index >= slot_count_) return nullptr;
+        std::uint32_t generation = handle.generation();
+        return slots_[index].generation == generation && (generation & 1) != 0 ? objects_ + slots_[index].position : nullptr;
+    }
+    inline bool valid(Handle handle) const { return get(handle) != nullptr; }
+
+    // Live objects, packed in no particular order
+    inline T* begin() const { return objects_; }
+    inline T* end() const { return objects_ + size_; }
+    inline std::uint32_t size() const { return size_; }
+    inline std::uint32_t capacity() const { return capacity_; }
+    inline bool empty() const { return size_ == 0; }
+    inline Handle handle_at(std::uint32_t position) const {  // of begin()[position]
+        std::uint32_t index = owners_[position];
+        return Handle{slots_[index].generation << IndexBits | index};
+    }
+
+    void trim() {                           // return the pages past the live objects to the OS
+        std::size_t used = roundToPages(size_ * sizeof(T));
+        std::size_t reserved = roundToPages(capacity_ * sizeof(T));
+        if (used < reserved) madvise(reinterpret_cast<char*>(objects_) + used, reserved - used, MADV_DONTNEED);
+    }
+
+    HandlePool(const HandlePool&)            = delete;
+    HandlePool& operator=(const HandlePool&) = delete;
+
+private:
+    static constexpr std::uint32_t kGenerationMask = ~std::uint32_t{0} >> IndexBits;
+
+    struct Slot {
+        std::uint32_t position = 0;         // live: the object's position; free: the next free slot
+        std::uint32_t generation = 0;       // odd while live
+    };
+
+    std::uint32_t  capacity_;
+    Slot*          slots_ = nullptr;
+    std::uint32_t* owners_ = nullptr;       // slot of the object at each position
+    T*             objects_ = nullptr;
+    std::uint32_t  size_ = 0;
+    std::uint32_t  slot_count_ = 0;         // slots ever handed out
+    std::uint32_t  free_head_ = 0;          // FIFO of freed slots
+    std::uint32_t  free_tail_ = 0;
+    std::uint32_t  free_count_ = 0;
+
+    // The mask's range is even, so wrapping keeps the parity
+    static inline std::uint32_t nextGeneration(std::uint32_t generation) { return (generation + 1) & kGenerationMask; }
+
+    static std::size_t roundToPages(std::size_t bytes) {
+        return (bytes + Slab::kSlabAlignment - 1) & ~(Slab::kSlabAlignment - 1);
+    }
+    static void* reserve(std::size_t bytes) {
+        return bytes == 0 ? nullptr : mapAligned(roundToPages(bytes), Slab::kSlabAlignment, MAP_NORESERVE);
+    }
+    void release() {
+        if (slots_ != nullptr) munmap(slots_, roundToPages(capacity_ * sizeof(Slot)));
+        if (owners_ != nullptr) munmap(owners_, roundToPages(capacity_ * sizeof(std::uint32_t)));
+        if (objects_ != nullptr) munmap(objects_, roundToPages(capacity_ * sizeof(T)));
+    }
+};
+
+} // namespace slab
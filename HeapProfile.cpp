@@ -0,0 +1,257 @@
+#include "HeapProfile.hpp"
+#include "PageMap.hpp"
+#include "Slab.hpp"
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+
+namespace slab {
+
+namespace {
+
+// Set while this thread is inside HeapProfiler::sample(): the allocations
+// backtrace() makes when it first loads the unwinder are not sampled
+thread_local bool in_sample = false;
+
+inline std::size_t pointerSlot(const void* ptr, std::size_t slots) {
+    return static_cast<std::size_t>((reinterpret_cast<std::uintptr_t>(ptr) >> 3) * 0x9E3779B97F4A7C15ull >> 20) & (slots - 1);
+}
+
+std::uint64_t stackHash(void* const* frames, unsigned depth) {
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    for (unsigned i = 0; i < depth; ++i) {
+        hash = (hash ^ reinterpret_cast<std::uintptr_t>(frames[i])) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+} // namespace
+
+double HeapProfile::estimate(std::uint64_t samples, std::uint64_t bytes) const {
+    if (samples == 0 || sample_bytes == 0) return 0.0;
+    double average = static_cast<double>(bytes) / static_cast<double>(samples);
+    return static_cast<double>(bytes) / -std::expm1(-average / static_cast<double>(sample_bytes));
+}
+
+double HeapProfile::estimated_live_bytes() const {
+    double total = 0.0;
+    for (const Site& site : sites) total += estimate(site.live_samples, site.live_bytes);
+    return total;
+}
+
+double HeapProfile::estimated_alloc_bytes() const {
+    double total = 0.0;
+    for (const Site& site : sites) total += estimate(site.alloc_samples, site.alloc_bytes);
+    return total;
+}
+
+void HeapProfile::write_pprof(std::ostream& out) const {
+    std::uint64_t live_samples = 0, live_bytes = 0, alloc_samples = 0, alloc_bytes = 0;
+    for (const Site& site : sites) {
+        live_samples += site.live_samples;
+        live_bytes += site.live_bytes;
+        alloc_samples += site.alloc_samples;
+        alloc_bytes += site.alloc_bytes;
+    }
+    out << "heap profile: " << live_samples << ": " << live_bytes << " [" << alloc_samples << ": "
+        << alloc_bytes << "] @ heap_v2/" << sample_bytes << "\n";
+    for (const Site& site : sites) {
+        if (site.alloc_samples == 0) continue;
+        out << site.live_samples << ": " << site.live_bytes << " [" << site.alloc_samples << ": "
+            << site.alloc_bytes << "] @";
+        for (unsigned i = 0; i < site.depth; ++i) out << " " << site.frames[i];
+        out << "\n";
+    }
+
+    out << "\nMAPPED_LIBRARIES:\n";
+    std::ifstream maps("/proc/self/maps");
+    out << maps.rdbuf();
+}
+
+void HeapProfile::write_text(std::ostream& out, std::size_t max_sites) const {
+    std::vector<const Site*> order;
+    order.reserve(sites.size());
+    for (const Site& site : sites) {
+        if (site.alloc_samples != 0) order.push_back(&site);
+    }
+    std::sort(order.begin(), order.end(), [this](const Site* a, const Site* b) {
+        return estimate(a->live_samples, a->live_bytes) > estimate(b->live_samples, b->live_bytes);
+    });
+
+    std::ios_base::fmtflags flags = out.flags();   // restored below; the stream is the caller's
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(0) << "heap profile: ~" << estimated_live_bytes() << " bytes live, ~"
+        << estimated_alloc_bytes() << " allocated, sampling every " << sample_bytes << " bytes";
+    if (dropped_samples != 0) out << " (" << dropped_samples << " samples dropped)";
+    out << "\n";
+    for (std::size_t i = 0; i < order.size() && i < max_sites; ++i) {
+        const Site& site = *order[i];
+        out << std::setw(14) << estimate(site.live_samples, site.live_bytes) << " live "
+            << std::setw(14) << estimate(site.alloc_samples, site.alloc_bytes) << " allocated\n";
+        if (site.depth == 0) out << "      (no stack: the site table was full, or unwinding failed)\n";
+        for (unsigned f = 0; f < site.depth; ++f) {
+            Dl_info info;
+            out << "      " << site.frames[f];
+            if (dladdr(site.frames[f], &info) != 0 && info.dli_sname != nullptr) {
+                int status = 0;
+                char* name = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+                out << " " << (name != nullptr ? name : info.dli_sname);
+                std::free(name);
+            }
+            out << "\n";
+        }
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+HeapProfiler::HeapProfiler(std::size_t sample_bytes) : sample_bytes_(sample_bytes) {
+    if (sample_bytes_ == 0) return;
+    std::size_t site_bytes = kMaxSites * sizeof(HeapProfile::Site);
+    std::size_t slot_bytes = kSiteSlots * sizeof(std::uint32_t);
+    std::size_t live_bytes = kLiveSlots * sizeof(LiveSample);
+    mapped_bytes_ = site_bytes + slot_bytes + live_bytes;
+    // Zeroed pages, committed only as the tables fill
+    char* memory = static_cast<char*>(mapAligned(mapped_bytes_, PageMap::kPageSize, MAP_NORESERVE));
+    if (memory == nullptr) abort();
+    sites_ = reinterpret_cast<HeapProfile::Site*>(memory);
+    site_slots_ = reinterpret_cast<std::uint32_t*>(memory + site_bytes);
+    live_ = reinterpret_cast<LiveSample*>(memory + site_bytes + slot_bytes);
+}
+
+HeapProfiler::~HeapProfiler() {
+    if (sites_ != nullptr) munmap(sites_, mapped_bytes_);
+}
+
+std::int64_t HeapProfiler::nextInterval(std::uint64_t& state) const {
+    // xorshift64*, then -log(u) for u uniform in (0, 1]
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    double u = static_cast<double>(((state * 0x2545F4914F6CDD1Dull) >> 11) + 1) * 0x1.0p-53;
+    return static_cast<std::int64_t>(-std::log(u) * static_cast<double>(sample_bytes_)) + 1;
+}
+
+bool HeapProfiler::sample(const void* ptr, std::size_t size, unsigned skip) {
+    if (in_sample) return false;
+    in_sample = true;
+    void* frames[HeapProfile::kMaxFrames + 8];
+    skip = std::min(skip + 1, 8u);   // and this frame
+    int captured = backtrace(frames, static_cast<int>(HeapProfile::kMaxFrames + skip));
+    unsigned depth = captured > static_cast<int>(skip) ? static_cast<unsigned>(captured) - skip : 0;
+
+    bool recorded = false;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (live_count_ >= kLiveSlots / 4 * 3) {
+            ++dropped_;
+        } else {
+            std::size_t slot = pointerSlot(ptr, kLiveSlots);
+            while (live_[slot].ptr != nullptr && live_[slot].ptr != ptr) slot = (slot + 1) & (kLiveSlots - 1);
+            if (live_[slot].ptr == nullptr) {
+                std::uint32_t index = findSite(frames + skip, depth);
+                HeapProfile::Site& site = sites_[index];
+                ++site.live_samples;
+                site.live_bytes += size;
+                ++site.alloc_samples;
+                site.alloc_bytes += size;
+                live_[slot] = LiveSample{ptr, index, size};
+                ++live_count_;
+                recorded = true;
+            }
+        }
+    }
+    in_sample = false;
+    return recorded;
+}
+
+bool HeapProfiler::forget(const void* ptr) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::size_t slot = pointerSlot(ptr, kLiveSlots);
+    while (live_[slot].ptr != ptr) {
+        if (live_[slot].ptr == nullptr) return false;
+        slot = (slot + 1) & (kLiveSlots - 1);
+    }
+    HeapProfile::Site& site = sites_[live_[slot].site];
+    --site.live_samples;
+    site.live_bytes -= live_[slot].size;
+    --live_count_;
+
+    // Backward-shift deletion: pull later entries of the probe run into
+    // the hole, so lookups never need tombstones
+    std::size_t hole = slot;
+    for (std::size_t next = (hole + 1) & (kLiveSlots - 1); live_[next].ptr != nullptr; next = (next + 1) & (kLiveSlots - 1)) {
+        std::size_t home = pointerSlot(live_[next].ptr, kLiveSlots);
+        // Movable unless its home lies cyclically in (hole, next]
+        bool stays = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (stays) continue;
+        live_[hole] = live_[next];
+        hole = next;
+    }
+    live_[hole] = LiveSample{nullptr, 0, 0};
+    return true;
+}
+
+void HeapProfiler::forget_all() {
+    if (!enabled()) return;
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (std::size_t slot = 0; slot < kLiveSlots; ++slot) {
+        if (live_[slot].ptr != nullptr) live_[slot] = LiveSample{nullptr, 0, 0};
+    }
+    for (std::size_t index = 0; index < site_count_; ++index) {
+        sites_[index].live_samples = 0;
+        sites_[index].live_bytes = 0;
+    }
+    live_count_ = 0;
+}
+
+void HeapProfiler::snapshot(HeapProfile& out) const {
+    out.sample_bytes = sample_bytes_;
+    out.sites.clear();
+    if (!enabled()) return;
+
+    // Reserve outside the lock: if this pool serves malloc, the vector's
+    // allocation comes back through it and may be sampled
+    for (;;) {
+        std::size_t count;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            count = site_count_;
+        }
+        out.sites.reserve(count);
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (site_count_ > out.sites.capacity()) continue;
+        out.sites.assign(sites_, sites_ + site_count_);
+        out.dropped_samples = dropped_;
+        return;
+    }
+}
+
+std::uint32_t HeapProfiler::findSite(void* const* frames, unsigned depth) {
+    if (depth == 0) return 0;
+    std::uint64_t hash = stackHash(frames, depth);
+    std::size_t slot = static_cast<std::size_t>(hash) & (kSiteSlots - 1);
+    while (std::uint32_t entry = site_slots_[slot]) {
+        const HeapProfile::Site& site = sites_[entry - 1];
+        if (site.depth == depth && std::equal(frames, frames + depth, site.frames)) return entry - 1;
+        slot = (slot + 1) & (kSiteSlots - 1);
+    }
+    if (site_count_ == kMaxSites) return 0;
+
+    std::uint32_t index = static_cast<std::uint32_t>(site_count_++);
+    HeapProfile::Site& site = sites_[index];
+    std::copy(frames, frames + depth, site.frames);
+    site.depth = depth;
+    site_slots_[slot] = index + 1;
+    return index;
+}
+
+} // namespace slab
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+namespace slab {
+
+// Snapshot returned by PoolAllocator::heap_profile(): one site per distinct
+// stack that allocated a sampled object. Counts are raw samples; estimate()
+// scales them back up to the whole heap.
+struct HeapProfile {
+    static constexpr unsigned kMaxFrames = 32;
+
+    struct Site {
+        void*         frames[kMaxFrames];  // return addresses, innermost first
+        unsigned      depth = 0;           // 0: stacks that did not fit the site table, or could not be unwound
+        std::uint64_t live_samples = 0;    // sampled objects not yet freed
+        std::uint64_t live_bytes = 0;      // their requested sizes
+        std::uint64_t alloc_samples = 0;   // every sample since the pool was created
+        std::uint64_t alloc_bytes = 0;
+    };
+
+    std::size_t       sample_bytes = 0;    // mean bytes allocated between samples; 0 if profiling is off
+    std::uint64_t     dropped_samples = 0; // not tracked: too many sampled objects were live
+    std::vector<Site> sites;
+
+    // Bytes that samples of average size bytes / samples stand for. An
+    // object of s bytes is sampled with probability 1 - exp(-s / sample_bytes).
+    double estimate(std::uint64_t samples, std::uint64_t bytes) const;
+    double estimated_live_bytes() const;
+    double estimated_alloc_bytes() const;
+
+    // gperftools' legacy heap format ("heap_v2"), which pprof reads: it
+    // unsamples the counts itself and symbolizes through the mapping list
+    // at the end. Live objects are inuse_space, cumulative ones
+    // alloc_space; pprof -base against an earlier dump gives the
+    // allocation rate between the two.
+    void write_pprof(std::ostream& out) const;
+    // The max_sites sites with the most estimated live bytes, with the
+    // symbols dladdr finds for their frames
+    void write_text(std::ostream& out, std::size_t max_sites = 20) const;
+};
+
+// Sampled objects of one pool, from the allocation that sampled them until
+// their free. The pool decides which allocations to sample (a byte
+// countdown per thread, see PoolAllocator::countSample); this captures the
+// stack and keeps it. Tables are mapped once at construction and never
+// grow, so recording does not allocate. Thread-safe.
+class HeapProfiler {
+public:
+    explicit HeapProfiler(std::size_t sample_bytes);   // 0: off, nothing mapped
+    ~HeapProfiler();
+
+    inline bool enabled() const { return sample_bytes_ != 0; }
+    inline std::size_t sample_bytes() const { return sample_bytes_; }
+
+    // Bytes to allocate before the next sample: exponentially distributed
+    // with mean sample_bytes, so sampling is a Poisson process over bytes.
+    // state is the calling thread's generator; any non-zero seed.
+    std::int64_t nextInterval(std::uint64_t& state) const;
+
+    // Capture the caller's stack, minus skip frames, for ptr. False if it
+    // was not recorded: the table is full, ptr is already sampled, or the
+    // calling thread is inside sample() already (backtrace() allocates the
+    // first time it runs).
+    bool sample(const void* ptr, std::size_t size, unsigned skip);
+    bool forget(const void* ptr);   // true if ptr was sampled; it is not any more
+    void forget_all();              // every live sample, as after PoolAllocator::reset()
+    void snapshot(HeapProfile& out) const;
+    inline void lock() { mutex_.lock(); }     // around fork()
+    inline void unlock() { mutex_.unlock(); }
+
+    HeapProfiler(const HeapProfiler&)            = delete;
+    HeapProfiler& operator=(const HeapProfiler&) = delete;
+
+private:
+    static constexpr std::size_t kMaxSites = 4096;                  // sites_[0] collects the overflow
+    static constexpr std::size_t kSiteSlots = 2 * kMaxSites;
+    static constexpr std::size_t kLiveSlots = std::size_t{1} << 16; // at most 3/4 used
+
+    struct LiveSample {
+        const void*   ptr;   // nullptr: empty slot
+        std::uint32_t site;
+        std::uint64_t size;
+    };
+
+    const std::size_t  sample_bytes_;
+    mutable std::mutex mutex_;
+    HeapProfile::Site* sites_ = nullptr;     // dense, in order of first sample
+    std::uint32_t*     site_slots_ = nullptr; // open-addressed on the stack hash; index + 1, 0 if empty
+    std::size_t        site_count_ = 1;
+    LiveSample*        live_ = nullptr;      // open-addressed on the pointer, linear probing
+    std::size_t        live_count_ = 0;
+    std::uint64_t      dropped_ = 0;
+    std::size_t        mapped_bytes_ = 0;
+
+    std::uint32_t findSite(void* const* frames, unsigned depth); // adds it if new; 0 once the table is full, and for empty stacks
+};
+
+} // namespace slab
@@ -0,0 +1,62 @@
+#include "MetaAllocator.hpp"
+#include <sys/mman.h>
+#include <algorithm>
+
+namespace slab {
+
+namespace {
+
+// Every object starts on a cache line, so headers of neighbouring slabs
+// never share one
+constexpr std::size_t kMetaAlignment = 64;
+
+} // namespace
+
+MetaAllocator::MetaAllocator(std::size_t objectSize)
+    : objectSize_((objectSize + kMetaAlignment - 1) & ~(kMetaAlignment - 1)) {}
+
+MetaAllocator::~MetaAllocator() {
+    std::size_t bytes = std::max(kBlockSize, kMetaAlignment + objectSize_);
+    Block* block = blocks_;
+    while (block != nullptr) {
+        Block* next = block->next;
+        munmap(block, bytes);
+        block = next;
+    }
+}
+
+void* MetaAllocator::allocate() {
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    if (freeList_ != nullptr) {
+        Node* node = freeList_;
+        freeList_ = node->next;
+        return node;
+    }
+
+    if (bump_ == bumpEnd_) {
+        // The first cache line of each block holds the teardown link
+        std::size_t bytes = std::max(kBlockSize, kMetaAlignment + objectSize_);
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) return nullptr;
+
+        Block* block = static_cast<Block*>(memory);
+        block->next = blocks_;
+        blocks_ = block;
+        bump_ = static_cast<char*>(memory) + kMetaAlignment;
+        bumpEnd_ = bump_ + (bytes - kMetaAlignment) / objectSize_ * objectSize_;
+    }
+
+    void* ptr = bump_;
+    bump_ += objectSize_;
+    return ptr;
+}
+
+void MetaAllocator::deallocate(void* ptr) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    Node* node = static_cast<Node*>(ptr);
+    node->next = freeList_;
+    freeList_ = node;
+}
+
+} // namespace slab
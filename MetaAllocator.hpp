@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Slab.hpp"
+#include <cstddef>
+#include <mutex>
+
+namespace slab {
+
+// Fixed-size allocator for the pool's own bookkeeping (Slab headers, thread
+// caches). Blocks come straight from mmap, so the pool never calls malloc
+// or operator new itself and can sit underneath them. Thread-safe; memory
+// goes back to the OS only when the allocator is destroyed.
+class MetaAllocator {
+public:
+    explicit MetaAllocator(std::size_t objectSize);
+    ~MetaAllocator();
+
+    void* allocate();           // objectSize bytes, aligned for any object the pool keeps; nullptr if mmap fails
+    void  deallocate(void* ptr);
+
+    // Around fork(): hold the lock so the child never copies a half-done
+    // allocate(); the child may unlock it too
+    inline void lock() { mutex_.lock(); }
+    inline void unlock() { mutex_.unlock(); }
+
+    MetaAllocator(const MetaAllocator&)            = delete;
+    MetaAllocator& operator=(const MetaAllocator&) = delete;
+
+private:
+    static constexpr std::size_t kBlockSize = std::size_t{1} << 16;  // 64KB per mmap
+
+    struct Block {
+        Block* next;
+    };
+
+    std::size_t objectSize_;
+    std::mutex  mutex_;
+    Node*       freeList_ = nullptr;  // recycled objects
+    char*       bump_ = nullptr;      // carved lazily from the newest block, like Slab
+    char*       bumpEnd_ = nullptr;
+    Block*      blocks_ = nullptr;    // every block, for teardown
+};
+
+} // namespace slab
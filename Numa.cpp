@@ -0,0 +1,51 @@
+#include "Numa.hpp"
+#include <fcntl.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace slab {
+
+unsigned numaNodeCount() {
+    // Read with open(2), not stdio: a pool serving malloc calls this while
+    // it is being constructed, and fopen allocates
+    char text[256];
+    int fd = ::open("/sys/devices/system/node/online", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 1;
+    ssize_t length = ::read(fd, text, sizeof(text) - 1);
+    ::close(fd);
+    if (length <= 0) return 1;
+    text[length] = '\0';
+
+    // "0", "0-1" or "0-3,5": the highest node named, plus one
+    unsigned count = 1, value = 0;
+    bool digits = false;
+    for (const char* p = text;; ++p) {
+        if (*p >= '0' && *p <= '9') {
+            value = value * 10 + static_cast<unsigned>(*p - '0');
+            digits = true;
+            continue;
+        }
+        if (digits && value + 1 > count) count = value + 1;
+        value = 0;
+        digits = false;
+        if (*p != '-' && *p != ',') break;
+    }
+    return count;
+}
+
+unsigned currentNumaNode() {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+    return node;
+}
+
+bool preferNumaNode(void* memory, std::size_t bytes, unsigned node) {
+    unsigned long mask[4] = {};
+    constexpr unsigned kBits = sizeof(mask) * 8;
+    if (node >= kBits) return false;
+    mask[node / (sizeof(unsigned long) * 8)] = 1UL << (node % (sizeof(unsigned long) * 8));
+    return syscall(SYS_mbind, memory, bytes, MPOL_PREFERRED, mask, kBits, 0) == 0;
+}
+
+} // namespace slab
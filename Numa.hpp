@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+namespace slab {
+
+// NUMA queries through the raw syscalls, so nothing here needs libnuma
+// and every call degrades to node 0 on hosts (or kernels) without NUMA.
+
+unsigned numaNodeCount();    // nodes online; 1 if unknown
+unsigned currentNumaNode();  // node of the CPU the caller is running on; 0 if unknown
+
+// Ask the kernel to place [memory, memory + bytes) on node when its pages
+// are first touched, falling back to other nodes if it is full. False if
+// the policy could not be set (no such node, or no NUMA support).
+bool preferNumaNode(void* memory, std::size_t bytes, unsigned node);
+
+} // namespace slab
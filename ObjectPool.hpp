@@ -0,0 +1,160 @@
+#pragma once
+
+#include "FixedSlab.hpp"
+#include "PageMap.hpp"
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace slab {
+
+// Single-size pool over FixedSlab: the compile-time counterpart of one
+// PoolAllocator size class. There is no class lookup; a free finds its
+// slab by masking the pointer. Only owns() consults a page map, of the
+// slabs currently listed. Not thread-safe.
+template <std::size_t ChunkSize, std::size_t SlabBytes = Slab::kSlabSize>
+class FixedPool {
+public:
+    using SlabType = FixedSlab<ChunkSize, SlabBytes>;
+
+    // Empty slabs kept for reuse, as PoolOptions::max_empty_slabs_per_class
+    explicit FixedPool(std::size_t max_empty_slabs = 2) : max_empty_(max_empty_slabs) {}
+    ~FixedPool() {
+        releaseAll(partial_);
+        releaseAll(full_);
+        releaseAll(empty_);
+    }
+
+    inline void* allocate() {               // nullptr only if mmap fails
+        SlabType* slab = partial_;
+        if (__builtin_expect(slab == nullptr, 0)) {
+            slab = grow();
+            if (slab == nullptr) return nullptr;
+        }
+        void* ptr = slab->allocate();
+        if (__builtin_expect(slab->full(), 0)) {
+            unlink(partial_, slab);
+            pushFront(full_, slab);
+        }
+        return ptr;
+    }
+
+    inline void deallocate(void* ptr) {     // ptr from this pool's allocate()
+        if (ptr == nullptr) return;
+        SlabType* slab = SlabType::owner(ptr);
+        if (__builtin_expect(slab->full(), 0)) {
+            unlink(full_, slab);
+            pushFront(partial_, slab);
+        }
+        slab->deallocate(ptr);
+        if (__builtin_expect(slab->empty(), 0)) onEmpty(slab);
+    }
+
+    inline bool owns(const void* ptr) const {
+        // The header is read only once the map says the slab is ours
+        const SlabType* owner = SlabType::owner(ptr);
+        return listed_.get(owner) != nullptr && owner->contains(ptr);
+    }
+
+    void trim() {                           // unmap every retained empty slab
+        releaseAll(empty_);
+        empty_ = nullptr;
+        empty_count_ = 0;
+    }
+
+    FixedPool(const FixedPool&)            = delete;
+    FixedPool& operator=(const FixedPool&) = delete;
+
+private:
+    SlabType* partial_ = nullptr;   // allocation comes from the front
+    SlabType* full_ = nullptr;
+    SlabType* empty_ = nullptr;     // retained for reuse, at most max_empty_
+    std::size_t empty_count_ = 0;
+    const std::size_t max_empty_;
+    PageMap     listed_;            // header page of each partial or full slab
+
+    SlabType* grow() {
+        SlabType* slab = empty_;
+        if (slab != nullptr) {
+            unlink(empty_, slab);
+            --empty_count_;
+        } else {
+            slab = SlabType::create();
+        }
+        if (slab != nullptr) {
+            pushFront(partial_, slab);
+            listed_.set(slab, 1, reinterpret_cast<Slab*>(slab));   // only tested for nullptr
+        }
+        return slab;
+    }
+
+    void onEmpty(SlabType* slab) {
+        if (slab == partial_ && slab->next_ == nullptr) return;   // the last one stays where it is
+        unlink(partial_, slab);
+        listed_.clear(slab, 1);
+        if (empty_count_ < max_empty_) {
+            pushFront(empty_, slab);
+            ++empty_count_;
+        } else {
+            SlabType::destroy(slab);
+        }
+    }
+
+    static void pushFront(SlabType*& head, SlabType* slab) {
+        slab->prev_ = nullptr;
+        slab->next_ = head;
+        if (head != nullptr) head->prev_ = slab;
+        head = slab;
+    }
+    static void unlink(SlabType*& head, SlabType* slab) {
+        if (slab->prev_ != nullptr) slab->prev_->next_ = slab->next_;
+        else head = slab->next_;
+        if (slab->next_ != nullptr) slab->next_->prev_ = slab->prev_;
+        slab->prev_ = slab->next_ = nullptr;
+    }
+    static void releaseAll(SlabType* slab) {
+        while (slab != nullptr) {
+            SlabType* next = slab->next_;
+            SlabType::destroy(slab);
+            slab = next;
+        }
+    }
+};
+
+// Typed front end: constructs and destroys T in chunks sized and aligned
+// for it. Not thread-safe.
+template <typename T, std::size_t SlabBytes = Slab::kSlabSize>
+class ObjectPool {
+    static constexpr std::size_t kRaw = sizeof(T) > sizeof(Node) ? sizeof(T) : sizeof(Node);
+    static constexpr std::size_t kAlign = alignof(T) > alignof(Node) ? alignof(T) : alignof(Node);
+    static_assert(kAlign <= SlabBytes, "chunks are aligned at most to the slab");
+
+public:
+    // Rounding up to a multiple of the alignment also aligns every chunk
+    static constexpr std::size_t kChunkSize = (kRaw + kAlign - 1) / kAlign * kAlign;
+
+    template <typename... Args>
+    T* create(Args&&... args) {             // nullptr only if mmap fails; exceptions from T's constructor propagate
+        void* memory = pool_.allocate();
+        if (memory == nullptr) return nullptr;
+        try {
+            return new (memory) T(std::forward<Args>(args)...);
+        } catch (...) {
+            pool_.deallocate(memory);
+            throw;
+        }
+    }
+
+    void destroy(T* object) {
+        if (object == nullptr) return;
+        object->~T();
+        pool_.deallocate(object);
+    }
+
+    inline bool owns(const T* object) const { return pool_.owns(object); }
+
+private:
+    FixedPool<kChunkSize, SlabBytes> pool_;
+};
+
+} // namespace slab
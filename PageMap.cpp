@@ -0,0 +1,70 @@
+#include "PageMap.hpp"
+#include <sys/mman.h>
+#include <cstdlib>
+
+namespace slab {
+
+namespace {
+
+void* mapZeroed(std::size_t bytes) {
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) abort();  // nothing sensible to hand back to the caller
+    return p;
+}
+
+} // namespace
+
+PageMap::PageMap() : leaves_(nullptr) {
+    root_ = static_cast<std::atomic<Leaf*>*>(mapZeroed(kRootLength * sizeof(std::atomic<Leaf*>)));
+}
+
+PageMap::~PageMap() {
+    Leaf* leaf = leaves_.load(std::memory_order_acquire);
+    while (leaf != nullptr) {
+        Leaf* next = leaf->next;
+        munmap(leaf, sizeof(Leaf));
+        leaf = next;
+    }
+    munmap(root_, kRootLength * sizeof(std::atomic<Leaf*>));
+}
+
+void PageMap::set(const void* base, std::size_t bytes, Slab* slab) {
+    fill(base, bytes, slab);
+}
+
+void PageMap::clear(const void* base, std::size_t bytes) {
+    fill(base, bytes, nullptr);
+}
+
+PageMap::Leaf* PageMap::getOrCreateLeaf(std::uintptr_t key) {
+    std::atomic<Leaf*>& slot = root_[key >> kLeafBits];
+    Leaf* leaf = slot.load(std::memory_order_acquire);
+    if (leaf != nullptr) return leaf;
+
+    // Two threads may race to populate the same root slot; the loser unmaps.
+    Leaf* fresh = static_cast<Leaf*>(mapZeroed(sizeof(Leaf)));
+    if (!slot.compare_exchange_strong(leaf, fresh, std::memory_order_acq_rel)) {
+        munmap(fresh, sizeof(Leaf));
+        return leaf;
+    }
+
+    Leaf* head = leaves_.load(std::memory_order_relaxed);
+    do {
+        fresh->next = head;
+    } while (!leaves_.compare_exchange_weak(head, fresh, std::memory_order_release,
+                                            std::memory_order_relaxed));
+    return fresh;
+}
+
+void PageMap::fill(const void* base, std::size_t bytes, Slab* slab) {
+    std::uintptr_t first = reinterpret_cast<std::uintptr_t>(base) >> kPageShift;
+    std::uintptr_t last  = (reinterpret_cast<std::uintptr_t>(base) + bytes - 1) >> kPageShift;
+
+    for (std::uintptr_t key = first; key <= last; ++key) {
+        Leaf* leaf = getOrCreateLeaf(key);
+        leaf->slabs[key & (kLeafLength - 1)].store(slab, std::memory_order_release);
+    }
+}
+
+} // namespace slab
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace slab {
+
+class Slab;
+
+// Radix page map from address to owning Slab. Every page a slab covers is
+// registered on creation, so deallocate() resolves ownership with two
+// dependent loads instead of scanning the slab vectors. Nodes are mmap'd
+// on demand; untouched parts of the tree cost only address space.
+class PageMap {
+public:
+    static constexpr std::size_t kPageShift = 12;                        // 4KB pages
+    static constexpr std::size_t kPageSize  = std::size_t{1} << kPageShift;
+
+    PageMap();
+    ~PageMap();
+
+    void set(const void* base, std::size_t bytes, Slab* slab); // map every page of [base, base + bytes)
+    void clear(const void* base, std::size_t bytes);           // unmap every page of [base, base + bytes)
+
+    // nullptr if ptr does not belong to a registered slab
+    inline Slab* get(const void* ptr) const {
+        std::uintptr_t key = reinterpret_cast<std::uintptr_t>(ptr) >> kPageShift;
+        if (__builtin_expect(key >> kKeyBits, 0)) return nullptr;
+        Leaf* leaf = root_[key >> kLeafBits].load(std::memory_order_acquire);
+        if (__builtin_expect(leaf == nullptr, 0)) return nullptr;
+        return leaf->slabs[key & (kLeafLength - 1)].load(std::memory_order_acquire);
+    }
+
+    PageMap(const PageMap&)            = delete;
+    PageMap& operator=(const PageMap&) = delete;
+
+private:
+    static constexpr std::size_t kAddressBits = 48;                      // x86-64 / AArch64 user space
+    static constexpr std::size_t kKeyBits     = kAddressBits - kPageShift;
+    static constexpr std::size_t kLeafBits    = kKeyBits / 2;
+    static constexpr std::size_t kRootBits    = kKeyBits - kLeafBits;
+    static constexpr std::size_t kLeafLength  = std::size_t{1} << kLeafBits;
+    static constexpr std::size_t kRootLength  = std::size_t{1} << kRootBits;
+
+    struct Leaf {
+        std::atomic<Slab*> slabs[kLeafLength];
+        Leaf*              next;     // chain of every leaf, for teardown
+    };
+
+    std::atomic<Leaf*>* root_;       // kRootLength entries, mmap'd
+    std::atomic<Leaf*>  leaves_;     // head of the leaf chain
+
+    Leaf* getOrCreateLeaf(std::uintptr_t key);
+    void  fill(const void* base, std::size_t bytes, Slab* slab);
+};
+
+} // namespace slab
@@ -1,171 +1,1224 @@
 #include "PoolAllocator.hpp"
+#include "Numa.hpp"
+#include <cstdio>
 #include <cstdlib>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
 
 namespace slab {
 
-PoolAllocator::PoolAllocator() {
-    slabs_8_.push_back(new Slab(8));
-    slabs_16_.push_back(new Slab(16));
-    slabs_32_.push_back(new Slab(32));
-    slabs_64_.push_back(new Slab(64));
-    slabs_128_.push_back(new Slab(128));
-    slabs_256_.push_back(new Slab(256));
-    slabs_512_.push_back(new Slab(512));
-    slabs_1024_.push_back(new Slab(1024));
+namespace {
+
+std::atomic<std::uint64_t> next_allocator_id{1};
+
+// One-entry memo of the last pool this thread touched, so the common case
+// skips pthread_getspecific. Ids are never reused, so a stale entry can
+// never match a live pool.
+thread_local std::uint64_t tls_cache_owner = 0;
+thread_local void*         tls_cache = nullptr;
+
+// Chunks moved between a thread cache and the slabs at a time
+constexpr std::size_t kMaxBatch = 64;
+
+std::uint32_t batchSize(std::size_t chunk_size, std::size_t slab_bytes) {
+    return static_cast<std::uint32_t>(std::clamp<std::size_t>(slab_bytes / chunk_size / 4, 2, kMaxBatch));
+}
+
+void abortOnMisuse(const char* message, const void* ptr) {
+    std::fprintf(stderr, "slab::PoolAllocator: %s (%p)\n", message, ptr);
+    std::abort();
+}
+
+// Reuse a cached large span only if it wastes at most a quarter of itself
+constexpr bool spanFits(std::size_t span_bytes, std::size_t bytes) {
+    return span_bytes >= bytes && span_bytes - bytes <= span_bytes / 4;
+}
+
+} // namespace
+
+struct PoolAllocator::ThreadCache {
+    struct Bin {
+        Node*         head = nullptr;
+        std::uint32_t count = 0;
+        // Counted per call in plain fields only this thread touches, and
+        // folded into the StatCounters below on refill and flush. Allocations
+        // are not counted at all: every chunk that left the bin since the
+        // last fold and did not go back to the slabs was handed out.
+        std::uint32_t folded_count = 0;  // count at the last fold
+        std::uint64_t freed = 0;         // into the bin since then
+        std::uint64_t requested = 0;
+        StatCounter   allocs;          // this thread's share of the class counters
+        StatCounter   frees;
+        StatCounter   requested_bytes;
+
+        inline void foldStats() {
+            allocs.add(folded_count + freed - count);
+            frees.add(freed);
+            requested_bytes.add(requested);
+            folded_count = count;
+            freed = 0;
+            requested = 0;
+        }
+    };
+
+    PoolAllocator* owner;
+    ThreadCache*   prev = nullptr;
+    ThreadCache*   next = nullptr;
+    TraceLog::Buffer* trace = nullptr;     // this thread's events, when tracing
+    std::int64_t   sample_countdown = 0;   // heap profiling: bytes until the next sample
+    std::uint64_t  sample_rng = 0;
+    unsigned       node = 0;               // NUMA node whose slabs refill the bins
+    StatCounter    local_frees;            // NUMA pools only
+    StatCounter    remote_frees;
+    Bin            bins[SizeClassMap::kMaxClasses];
+
+    explicit ThreadCache(PoolAllocator* pool) : owner(pool) {}
+};
+
+PoolAllocator::PoolAllocator() : PoolAllocator(PoolOptions{}) {}
+
+PoolAllocator::PoolAllocator(const PoolOptions& options)
+    : size_map_(options.size_classes),
+      node_count_(std::min(options.numa_nodes != 0 ? options.numa_nodes : numaNodeCount(), kMaxNumaNodes)),
+      use_arena_(options.arena_bytes != 0),
+      first_node_(options.arena_bytes, options.huge_pages, node_count_ > 1 ? 0 : -1),
+      large_cache_limit_(options.large_cache_bytes),
+      max_empty_slabs_(options.max_empty_slabs_per_class),
+      most_occupied_(options.slab_selection == SlabSelection::kMostOccupied),
+      verify_sized_frees_(options.verify_sized_frees),
+      error_handler_(options.error_handler != nullptr ? options.error_handler : &abortOnMisuse),
+      foreign_free_(options.foreign_free != nullptr ? options.foreign_free : &std::free),
+      collect_stats_(options.collect_stats),
+      trace_log_(options.trace_path),
+      tracing_(trace_log_.enabled()),
+      profiler_(options.profile_sample_bytes),
+      profiling_(profiler_.enabled()),
+      slab_meta_(sizeof(Slab)),
+      cache_meta_(sizeof(ThreadCache)),
+      thread_safe_(options.thread_safe),
+      id_(next_allocator_id.fetch_add(1, std::memory_order_relaxed)) {
+    nodes_[0] = &first_node_;
+    for (unsigned node = 1; node < node_count_; ++node) {
+        void* memory = mapAligned(sizeof(NumaNode), PageMap::kPageSize);
+        if (memory == nullptr) abort();
+        nodes_[node] = new (memory) NumaNode(options.arena_bytes, options.huge_pages, static_cast<int>(node));
+    }
+    if (node_count_ > 1) local_node_ = currentNumaNode() % node_count_;
+    if (profiling_) {
+        sample_rng_ = id_ * 0x9E3779B97F4A7C15ull;
+        sample_countdown_ = profiler_.nextInterval(sample_rng_);
+    }
+
+    for (unsigned node = 0; node < node_count_; ++node) {
+        for (std::size_t cls = 0; cls < size_map_.count(); ++cls) {
+            SizeClass& size_class = sizeClass(node, cls);
+            size_class.chunk_size = size_map_.classSize(cls);
+            size_class.slab_bytes = size_map_.slabBytes(cls);
+            size_class.batch = batchSize(size_class.chunk_size, size_class.slab_bytes);
+            std::size_t chunks = size_class.slab_bytes / size_class.chunk_size;
+            for (std::size_t b = 1; b < kOccupancyBuckets; ++b) {
+                size_class.bucket_floor[b] = static_cast<std::uint32_t>((chunks * b + kOccupancyBuckets - 1) / kOccupancyBuckets);
+            }
+        }
+    }
+
+    if (thread_safe_) {
+        pthread_key_create(&cache_key_, &PoolAllocator::releaseThreadCache);
+
+        if (options.trim_interval_ms > 0) {
+            auto interval = std::chrono::milliseconds(options.trim_interval_ms);
+            trim_thread_ = std::thread([this, interval] {
+                std::unique_lock<std::mutex> lock(trim_mutex_);
+                while (!trim_cv_.wait_for(lock, interval, [this] { return trim_stop_; })) {
+                    lock.unlock();
+                    trim();
+                    lock.lock();
+                }
+            });
+        }
+    }
 }
 
 PoolAllocator::~PoolAllocator() {
-    for (Slab* slab : slabs_8_) delete slab;
-    for (Slab* slab : slabs_16_) delete slab;
-    for (Slab* slab : slabs_32_) delete slab;
-    for (Slab* slab : slabs_64_) delete slab;
-    for (Slab* slab : slabs_128_) delete slab;
-    for (Slab* slab : slabs_256_) delete slab;
-    for (Slab* slab : slabs_512_) delete slab;
-    for (Slab* slab : slabs_1024_) delete slab;
+    if (trim_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(trim_mutex_);
+            trim_stop_ = true;
+        }
+        trim_cv_.notify_one();
+        trim_thread_.join();
+    }
+
+    if (thread_safe_) {
+        // Threads still running keep a dangling key value; deleting the key
+        // first means their exit no longer calls back into this pool.
+        pthread_key_delete(cache_key_);
+        ThreadCache* cache = caches_;
+        while (cache != nullptr) {
+            ThreadCache* next = cache->next;
+            trace_log_.releaseBuffer(cache->trace);
+            cache->~ThreadCache();
+            cache_meta_.deallocate(cache);
+            cache = next;
+        }
+    }
+
+    trace_log_.releaseBuffer(local_trace_);
+    destroyAllSlabs();
+    releaseLargeCache(0);
+    for (unsigned node = 1; node < node_count_; ++node) {
+        nodes_[node]->~NumaNode();
+        munmap(nodes_[node], sizeof(NumaNode));
+    }
 }
 
 void* PoolAllocator::allocate(std::size_t size) {
-    if (__builtin_expect(size > kMaxPoolSize, 0)) {
-        return malloc(size);
+    void* ptr = __builtin_expect(size > size_map_.maxSize(), 0)
+                    ? allocateLarge(size)
+                    : allocateSmall(size_map_.classIndex(size), size);
+    if (__builtin_expect(tracing_, 0)) traceEvent(TraceOp::kAllocate, size, ptr);
+    if (__builtin_expect(profiling_, 0) && ptr != nullptr) countSample(ptr, size);
+    return ptr;
+}
+
+void* PoolAllocator::allocate(std::size_t size, std::size_t alignment) {
+    if (alignment <= SizeClassMap::kAlignment) return allocate(size);
+    if ((alignment & (alignment - 1)) != 0) return nullptr;
+
+    // A larger class may be needed to get one whose chunks are aligned
+    std::size_t cls = size_map_.alignedClassIndex(size, alignment);
+    void* ptr = cls == size_map_.count() ? allocateLarge(size, std::max(alignment, PageMap::kPageSize))
+                                         : allocateSmall(cls, size);
+    if (__builtin_expect(tracing_, 0)) traceEvent(TraceOp::kAllocate, size, ptr, alignment);
+    if (__builtin_expect(profiling_, 0) && ptr != nullptr) countSample(ptr, size);
+    return ptr;
+}
+
+void* PoolAllocator::allocateSmall(std::size_t cls, std::size_t size) {
+    if (thread_safe_) {
+        ThreadCache* cache = threadCache();
+        ThreadCache::Bin& bin = cache->bins[cls];
+        if (__builtin_expect(bin.head == nullptr, 0)) {
+            refill(cache, cls);
+            if (bin.head == nullptr) return nullptr;   // no slab could be mapped
+        }
+        Node* node = bin.head;
+        bin.head = node->next;
+        --bin.count;
+        if (collect_stats_) bin.requested += size;
+        return node;
+    }
+
+    // Allocations are not counted here either: stats() adds the chunks
+    // still live in the slabs to the frees
+    void* ptr = allocateFromSlabs(local_node_, cls);
+    if (collect_stats_ && ptr != nullptr) sizeClass(local_node_, cls).requested_bytes.add(size);
+    return ptr;
+}
+
+void* PoolAllocator::allocateFromSlabs(unsigned node, std::size_t cls) {
+    SizeClass& size_class = sizeClass(node, cls);
+    Slab* slab = size_class.partial.front();
+    if (__builtin_expect(slab == nullptr, 0)) {
+        slab = getOrCreateSlab(node, cls);
+        if (slab == nullptr) return nullptr;
+    }
+
+    void* ptr = slab->allocate();
+    if (__builtin_expect(!slab->has_free_chunks(), 0)) {
+        retireIfExhausted(size_class, slab);
     }
-    
-    if (__builtin_expect(size <= 8, 1)) {
-        if (__builtin_expect(last_used_slab_8_ && last_used_slab_8_->has_free_chunks(), 1)) {
-            return last_used_slab_8_->allocate();
+    return ptr;
+}
+
+std::size_t PoolAllocator::allocateFromSlabs(unsigned node, std::size_t cls, void** out, std::size_t n) {
+    SizeClass& size_class = sizeClass(node, cls);
+    std::size_t got = 0;
+    while (got < n) {
+        Slab* slab = size_class.partial.front();
+        if (slab == nullptr) {
+            slab = getOrCreateSlab(node, cls);
+            if (slab == nullptr) break;
+        }
+        std::size_t taken = slab->allocateBatch(out + got, n - got);
+        if (thread_safe_) slab->handOut(taken);
+        got += taken;
+        if (!slab->has_free_chunks()) {
+            retireIfExhausted(size_class, slab);
         }
-        Slab* slab = getOrCreateSlab(slabs_8_, 8);
-        last_used_slab_8_ = slab;
-        return slab->allocate();
     }
-    if (size <= 16) {
-        if (last_used_slab_16_ && last_used_slab_16_->has_free_chunks()) {
-            return last_used_slab_16_->allocate();
+    return got;
+}
+
+void PoolAllocator::retireIfExhausted(SizeClass& size_class, Slab* slab) {
+    // Park it on the full list, unless (thread-safe mode) a remote free
+    // raced in and it still has chunks to give
+    if (!thread_safe_ || slab->markFull()) {
+        size_class.partial.remove(slab);
+        size_class.full.push_back(slab);
+    }
+}
+
+std::size_t PoolAllocator::allocate_bulk(std::size_t size, std::size_t n, void** out) {
+    std::size_t got = allocateBulk(size, n, out);
+    if (__builtin_expect(tracing_, 0)) {
+        for (std::size_t i = 0; i < got; ++i) traceEvent(TraceOp::kAllocate, size, out[i]);
+    }
+    if (__builtin_expect(profiling_, 0)) {
+        for (std::size_t i = 0; i < got; ++i) countSample(out[i], size);
+    }
+    return got;
+}
+
+std::size_t PoolAllocator::allocateBulk(std::size_t size, std::size_t n, void** out) {
+    if (__builtin_expect(size > size_map_.maxSize(), 0)) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = allocateLarge(size);
+            if (out[i] == nullptr) return i;
         }
-        Slab* slab = getOrCreateSlab(slabs_16_, 16);
-        last_used_slab_16_ = slab;
-        return slab->allocate();
+        return n;
     }
-    if (size <= 32) {
-        if (last_used_slab_32_ && last_used_slab_32_->has_free_chunks()) {
-            return last_used_slab_32_->allocate();
+
+    std::size_t cls = size_map_.classIndex(size);
+
+    if (thread_safe_) {
+        // Drain the thread cache first, then go to the slabs for the rest
+        // directly rather than refilling the bin batch by batch
+        ThreadCache* cache = threadCache();
+        ThreadCache::Bin& bin = cache->bins[cls];
+        std::size_t got = 0;
+        while (got < n && bin.head != nullptr) {
+            out[got++] = bin.head;
+            bin.head = bin.head->next;
+            --bin.count;
+        }
+        std::size_t from_bin = got;
+        if (got < n) {
+            std::lock_guard<std::mutex> guard(sizeClass(cache->node, cls).mutex);
+            got += allocateFromSlabs(cache->node, cls, out + got, n - got);
         }
-        Slab* slab = getOrCreateSlab(slabs_32_, 32);
-        last_used_slab_32_ = slab;
-        return slab->allocate();
+        if (collect_stats_) {
+            bin.allocs.add(got - from_bin);   // those from the bin are counted on the next fold
+            bin.requested += got * size;
+        }
+        return got;
     }
-    if (size <= 64) {
-        if (last_used_slab_64_ && last_used_slab_64_->has_free_chunks()) {
-            return last_used_slab_64_->allocate();
+
+    std::size_t got = allocateFromSlabs(local_node_, cls, out, n);
+    if (collect_stats_) sizeClass(local_node_, cls).requested_bytes.add(got * size);
+    return got;
+}
+
+void PoolAllocator::deallocate(void* ptr) {
+    if (ptr == nullptr) return;   // not a foreign pointer
+    // Frees are logged before the chunk can be handed out again, so a
+    // reader never sees an address allocated twice without a free between
+    if (__builtin_expect(tracing_, 0)) traceEvent(TraceOp::kFree, 0, ptr);
+    if (__builtin_expect(profiling_, 0)) forgetSample(ptr);
+    deallocateUnsized(ptr);
+}
+
+void PoolAllocator::deallocateUnsized(void* ptr) {
+    Slab* slab = findSlabForPointer(ptr);
+    if (!slab) {
+        foreign_frees_.addShared(1);
+        foreign_free_(ptr);
+        return;
+    }
+
+    if (__builtin_expect(slab->chunk_size() > size_map_.maxSize(), 0)) {
+        deallocateLarge(slab, ptr);
+        return;
+    }
+
+    std::size_t cls = size_map_.classIndex(slab->chunk_size());
+    Node* node = static_cast<Node*>(ptr);
+    if (thread_safe_) {
+        if (node_count_ > 1 && freeIfRemote(slab, node, node, 1)) return;
+        cacheChunks(cls, node, node, 1);
+        return;
+    }
+
+    slab->deallocate(ptr);
+    onChunksFreed(sizeClass(slab->node(), cls), slab, 1);
+}
+
+void PoolAllocator::deallocate(void* ptr, std::size_t size) {
+    deallocateInClass(ptr, size, size > size_map_.maxSize() ? size_map_.count() : size_map_.classIndex(size));
+}
+
+void PoolAllocator::deallocate(void* ptr, std::size_t size, std::size_t alignment) {
+    if (alignment <= SizeClassMap::kAlignment) {
+        deallocate(ptr, size);
+        return;
+    }
+    deallocateInClass(ptr, size, size_map_.alignedClassIndex(size, alignment));
+}
+
+void PoolAllocator::deallocateInClass(void* ptr, std::size_t size, std::size_t cls) {
+    if (ptr == nullptr) return;
+    if (__builtin_expect(tracing_, 0)) traceEvent(TraceOp::kFree, size, ptr);
+    if (__builtin_expect(profiling_, 0)) forgetSample(ptr);
+    if (__builtin_expect(verify_sized_frees_, 0) && !checkSizedFree(ptr, cls)) {
+        deallocateUnsized(ptr);
+        return;
+    }
+    if (__builtin_expect(cls == size_map_.count(), 0)) {
+        deallocateUnsized(ptr);
+        return;
+    }
+
+    // The class comes from the size; unless the pool spans NUMA nodes,
+    // the thread cache needs nothing else
+    if (thread_safe_) {
+        Node* node = static_cast<Node*>(ptr);
+        if (node_count_ > 1) {
+            Slab* slab = findSlabForPointer(ptr);
+            if (__builtin_expect(slab == nullptr, 0)) {
+                deallocateUnsized(ptr);   // not the pool's: handled as an unsized free would be
+                return;
+            }
+            if (freeIfRemote(slab, node, node, 1)) return;
         }
-        Slab* slab = getOrCreateSlab(slabs_64_, 64);
-        last_used_slab_64_ = slab;
-        return slab->allocate();
+        cacheChunks(cls, node, node, 1);
+        return;
     }
-    
-    if (size <= 128) {
-        Slab* slab = getOrCreateSlab(slabs_128_, 128);
-        return slab->allocate();
+
+    Slab* slab = findSlabForPointer(ptr);
+    if (__builtin_expect(slab == nullptr, 0)) {
+        deallocateUnsized(ptr);
+        return;
     }
-    if (size <= 256) {
-        Slab* slab = getOrCreateSlab(slabs_256_, 256);
-        return slab->allocate();
+    slab->deallocate(ptr);
+    onChunksFreed(sizeClass(slab->node(), cls), slab, 1);
+}
+
+void PoolAllocator::cacheChunks(std::size_t cls, Node* first, Node* last, std::size_t n) {
+    ThreadCache* cache = threadCache();
+    ThreadCache::Bin& bin = cache->bins[cls];
+    last->next = bin.head;
+    bin.head = first;
+    bin.count += static_cast<std::uint32_t>(n);
+    if (collect_stats_) bin.freed += n;
+    std::uint32_t batch = sizeClass(cache->node, cls).batch;
+    if (__builtin_expect(bin.count > 2 * batch, 0)) {
+        flush(cache, cls, batch);
     }
-    if (size <= 512) {
-        Slab* slab = getOrCreateSlab(slabs_512_, 512);
-        return slab->allocate();
+}
+
+bool PoolAllocator::freeIfRemote(Slab* slab, Node* first, Node* last, std::size_t n) {
+    // A chunk from another node's slab would be handed out again on this
+    // node if it went into the bin, so it goes straight back to its slab
+    ThreadCache* cache = threadCache();
+    if (slab->node() == cache->node) {
+        cache->local_frees.add(n);
+        return false;
     }
-    if (size <= 1024) {
-        Slab* slab = getOrCreateSlab(slabs_1024_, 1024);
-        return slab->allocate();
+    cache->remote_frees.add(n);
+    if (collect_stats_) cache->bins[size_map_.classIndex(slab->chunk_size())].frees.add(n);
+    returnChain(slab, first, last, n);
+    return true;
+}
+
+void PoolAllocator::returnChain(Slab* slab, Node* first, Node* last, std::size_t n) {
+    if (slab->deallocateRemote(first, last, n)) {
+        // It was parked as full, or has just emptied; its owner finds it
+        // again on refill
+        sizeClassOf(slab).pending.push(slab);
     }
-    
-    return malloc(size);
 }
 
-void PoolAllocator::deallocate(void* ptr) {
+void PoolAllocator::onChunksFreed(SizeClass& size_class, Slab* slab, std::size_t n) {
+    if (collect_stats_) size_class.frees.add(n);
+    if (node_count_ > 1) (slab->node() == local_node_ ? local_frees_ : remote_frees_).add(n);
+    if (__builtin_expect(slab->list() == &size_class.full, 0)) {
+        size_class.full.remove(slab);
+        addPartial(size_class, slab);
+    }
+    onLiveChunksDropped(size_class, slab);
+}
+
+void PoolAllocator::onLiveChunksDropped(SizeClass& size_class, Slab* slab) {
+    if (__builtin_expect(slab->empty(), 0)) {
+        onSlabEmpty(size_class, slab);
+        return;
+    }
+    SlabList* list = slab->list();
+    if (most_occupied_ && list != &size_class.partial) {
+        // Filed in a bucket: move it down once it drops below the floor
+        std::size_t bucket = static_cast<std::size_t>(list - size_class.by_occupancy);
+        if (slab->live_chunks() < size_class.bucket_floor[bucket]) {
+            list->remove(slab);
+            size_class.by_occupancy[occupancyBucket(size_class, slab->live_chunks())].push_back(slab);
+        }
+    }
+}
+
+bool PoolAllocator::checkSizedFree(void* ptr, std::size_t cls) const {
+    const Slab* slab = findSlabForPointer(ptr);
+    const char* error = nullptr;
+    if (slab == nullptr) {
+        error = "sized free of a pointer this pool does not own";
+    } else if (slab->chunk_size() > size_map_.maxSize()) {
+        if (cls != size_map_.count()) error = "sized free: size does not match the large object";
+    } else if (cls == size_map_.count() || size_map_.classSize(cls) != slab->chunk_size()) {
+        error = "sized free: size maps to a different class than the owning slab";
+    }
+
+    if (error == nullptr) return true;
+    error_handler_(error, ptr);
+    return false;
+}
+
+void PoolAllocator::deallocate_bulk(void** ptrs, std::size_t n) {
+    if (__builtin_expect(tracing_, 0)) {
+        for (std::size_t i = 0; i < n; ++i) {
+            if (ptrs[i] != nullptr) traceEvent(TraceOp::kFree, 0, ptrs[i]);
+        }
+    }
+    if (__builtin_expect(profiling_, 0)) {
+        for (std::size_t i = 0; i < n; ++i) {
+            if (ptrs[i] != nullptr) forgetSample(ptrs[i]);
+        }
+    }
+    std::size_t i = 0;
+    while (i < n) {
+        if (ptrs[i] == nullptr) {
+            ++i;
+            continue;
+        }
+        Slab* slab = findSlabForPointer(ptrs[i]);
+        if (!slab) {
+            foreign_frees_.addShared(1);
+            foreign_free_(ptrs[i++]);
+            continue;
+        }
+        if (__builtin_expect(slab->chunk_size() > size_map_.maxSize(), 0)) {
+            deallocateLarge(slab, ptrs[i++]);
+            continue;
+        }
+
+        // A range check against the slab in hand is cheaper than the page map
+        std::size_t end = i + 1;
+        while (end < n && slab->contains(ptrs[end])) ++end;
+        deallocateRun(slab, ptrs + i, end - i);
+        i = end;
+    }
+}
+
+void PoolAllocator::deallocate_bulk(void** ptrs, std::size_t n, std::size_t size) {
+    if (__builtin_expect(verify_sized_frees_, 0)) {
+        std::size_t cls = size > size_map_.maxSize() ? size_map_.count() : size_map_.classIndex(size);
+        for (std::size_t i = 0; i < n; ++i) {
+            if (ptrs[i] != nullptr && !checkSizedFree(ptrs[i], cls)) {
+                deallocate_bulk(ptrs, n);
+                return;
+            }
+        }
+    }
+    if (!thread_safe_ || node_count_ > 1 || size > size_map_.maxSize() || n == 0) {
+        deallocate_bulk(ptrs, n);
+        return;
+    }
+
+    if (__builtin_expect(tracing_, 0)) {
+        for (std::size_t i = 0; i < n; ++i) {
+            if (ptrs[i] != nullptr) traceEvent(TraceOp::kFree, size, ptrs[i]);
+        }
+    }
+    if (__builtin_expect(profiling_, 0)) {
+        for (std::size_t i = 0; i < n; ++i) forgetSample(ptrs[i]);
+    }
+
+    // The class comes from the size, so the chunks go straight into the
+    // thread cache without resolving their slabs at all. Null entries are
+    // skipped, as deallocate(nullptr, size) ignores them.
+    Node* first = nullptr;
+    Node* last = nullptr;
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        Node* node = static_cast<Node*>(ptrs[i]);
+        if (node == nullptr) continue;
+        if (last != nullptr) last->next = node;
+        else first = node;
+        last = node;
+        ++count;
+    }
+    if (count != 0) cacheChunks(size_map_.classIndex(size), first, last, count);
+}
+
+void PoolAllocator::deallocateRun(Slab* slab, void** ptrs, std::size_t n) {
+    std::size_t cls = size_map_.classIndex(slab->chunk_size());
+
+    Node* first = static_cast<Node*>(ptrs[0]);
+    Node* last = first;
+    for (std::size_t i = 1; i < n; ++i) {
+        Node* node = static_cast<Node*>(ptrs[i]);
+        last->next = node;
+        last = node;
+    }
+
+    if (thread_safe_) {
+        if (node_count_ > 1 && freeIfRemote(slab, first, last, n)) return;
+        cacheChunks(cls, first, last, n);
+        return;
+    }
+
+    slab->deallocateBatch(first, last, n);
+    onChunksFreed(sizeClass(slab->node(), cls), slab, n);
+}
+
+void PoolAllocator::reset() {
+    if (thread_safe_) {
+        // Cached chunks point into slabs that are about to go away
+        std::lock_guard<std::mutex> guard(caches_mutex_);
+        for (ThreadCache* cache = caches_; cache != nullptr; cache = cache->next) {
+            for (ThreadCache::Bin& bin : cache->bins) {
+                if (collect_stats_) bin.foldStats();
+                bin.head = nullptr;
+                bin.count = 0;
+                bin.folded_count = 0;
+            }
+        }
+    } else if (collect_stats_) {
+        // stats() counts allocations from the chunks still live; these
+        // never will be freed, so they move to the class's own count
+        for (std::size_t index = 0; index < node_count_ * size_map_.count(); ++index) {
+            SizeClass& size_class = sizeClass(static_cast<unsigned>(index / size_map_.count()), index % size_map_.count());
+            std::size_t live = 0;
+            auto count = [&](const SlabList& list) {
+                for (Slab* slab = list.front(); slab != nullptr; slab = SlabList::next(slab)) live += slab->live_chunks();
+            };
+            size_class.forEachPartialList(count);
+            count(size_class.full);
+            size_class.allocs.add(live);
+        }
+    }
+
+    profiler_.forget_all();
+    destroyAllSlabs();
+    releaseLargeCache(0);
+}
+
+void PoolAllocator::trim() {
+    for (std::size_t index = 0; index < node_count_ * size_map_.count(); ++index) {
+        SizeClass& size_class = sizeClass(static_cast<unsigned>(index / size_map_.count()), index % size_map_.count());
+        std::unique_lock<std::mutex> lock(size_class.mutex, std::defer_lock);
+        if (thread_safe_) lock.lock();
+
+        if (thread_safe_) adoptPending(size_class);
+
+        // Full slabs are left alone, and so are slabs a pusher still holds
+        size_class.forEachPartialList([&](SlabList& list) {
+            Slab* slab = list.front();
+            while (slab != nullptr) {
+                Slab* next = SlabList::next(slab);
+                slab->collectRemote();
+                if (slab->empty() && (!thread_safe_ || slab->settled())) {
+                    list.remove(slab);
+                    destroySlab(slab);
+                }
+                slab = next;
+            }
+        });
+        while (Slab* empty = size_class.empty.pop_front()) {
+            destroySlab(empty);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(large_mutex_, std::defer_lock);
+    if (thread_safe_) lock.lock();
+    releaseLargeCache(0);
+}
+
+bool PoolAllocator::owns(const void* ptr) const {
+    return page_map_.get(ptr) != nullptr;
+}
+
+void* PoolAllocator::reallocate(void* ptr, std::size_t new_size) {
+    if (ptr == nullptr) return allocate(new_size);
+    if (new_size == 0) {
+        deallocate(ptr);
+        return nullptr;
+    }
+
     Slab* slab = findSlabForPointer(ptr);
-    if (slab) {
-        slab->deallocate(ptr);
+    if (slab == nullptr) {
+        error_handler_("reallocate of a pointer this pool does not own", ptr);
+        return nullptr;
+    }
+    // A trace, like the profile, sees a resize as a free and an allocation
+    // at the new address
+    std::size_t usable = slab->chunk_size();
+    bool large = usable > size_map_.maxSize();
+    bool in_place = new_size <= usable && new_size > usable / 2;
+    bool remapped = false;
+    bool sampled = slab->sampled() != 0;   // read first: a remap rebuilds the span's Slab
+    if (!in_place && large && new_size > size_map_.maxSize()) in_place = remapped = remapLarge(slab, new_size);
+    if (in_place) {
+        void* resized = large ? slab->memory() : ptr;   // a remap may have moved the span
+        if (__builtin_expect(tracing_, 0)) {
+            traceEvent(TraceOp::kFree, 0, ptr);
+            traceEvent(TraceOp::kAllocate, new_size, resized);
+        }
+        if (__builtin_expect(profiling_, 0)) {
+            if (!remapped) forgetSample(ptr);
+            else if (sampled) profiler_.forget(ptr);   // the rebuilt Slab counts no samples
+            countSample(resized, new_size);
+        }
+        return resized;
+    }
+
+    // allocate() profiles the new block; ptr's sample goes only once the
+    // move has succeeded, with deallocate()
+    void* fresh = allocate(new_size);
+    if (fresh == nullptr) return nullptr;
+    std::memcpy(fresh, ptr, std::min(usable, new_size));
+    deallocate(ptr);
+    return fresh;
+}
+
+bool PoolAllocator::remapLarge(Slab* span, std::size_t size) {
+    std::size_t old_bytes = span->bytes();
+    std::size_t bytes = (size + PageMap::kPageSize - 1) & ~(PageMap::kPageSize - 1);
+    // Grow by at least half, so a buffer growing a little at a time is
+    // remapped (and its page-map entries rewritten) O(log n) times. The
+    // extra pages cost nothing until they are touched.
+    if (bytes > old_bytes) {
+        bytes = std::max(bytes, (old_bytes + old_bytes / 2 + PageMap::kPageSize - 1) & ~(PageMap::kPageSize - 1));
+    }
+    void* old_memory = span->memory();
+
+    // Unregister first: once mremap moves the span, another thread may be
+    // handed the old range and register it
+    page_map_.clear(old_memory, old_bytes);
+    void* memory = mremap(old_memory, old_bytes, bytes, MREMAP_MAYMOVE);
+    if (memory == MAP_FAILED) {
+        page_map_.set(old_memory, old_bytes, span);
+        return false;
+    }
+
+    span->~Slab();
+    new (span) Slab(bytes, memory, bytes);
+    span->allocate();
+    page_map_.set(memory, bytes, span);
+    if (bytes > old_bytes) {
+        addMappedBytes(bytes - old_bytes);
+        large_live_bytes_.fetch_add(bytes - old_bytes, std::memory_order_relaxed);
     } else {
-        free(ptr);
+        mapped_bytes_.fetch_sub(old_bytes - bytes, std::memory_order_relaxed);
+        large_live_bytes_.fetch_sub(old_bytes - bytes, std::memory_order_relaxed);
     }
+    return true;
 }
 
-void PoolAllocator::reset() {
-    for (Slab* slab : slabs_8_) delete slab;
-    for (Slab* slab : slabs_16_) delete slab;
-    for (Slab* slab : slabs_32_) delete slab;
-    for (Slab* slab : slabs_64_) delete slab;
-    for (Slab* slab : slabs_128_) delete slab;
-    for (Slab* slab : slabs_256_) delete slab;
-    for (Slab* slab : slabs_512_) delete slab;
-    for (Slab* slab : slabs_1024_) delete slab;
-    
-    slabs_8_.clear();
-    slabs_16_.clear();
-    slabs_32_.clear();
-    slabs_64_.clear();
-    slabs_128_.clear();
-    slabs_256_.clear();
-    slabs_512_.clear();
-    slabs_1024_.clear();
-    
-    last_used_slab_8_ = nullptr;
-    last_used_slab_16_ = nullptr;
-    last_used_slab_32_ = nullptr;
-    last_used_slab_64_ = nullptr;
-    
-    slabs_8_.push_back(new Slab(8));
-    slabs_16_.push_back(new Slab(16));
-    slabs_32_.push_back(new Slab(32));
-    slabs_64_.push_back(new Slab(64));
-    slabs_128_.push_back(new Slab(128));
-    slabs_256_.push_back(new Slab(256));
-    slabs_512_.push_back(new Slab(512));
-    slabs_1024_.push_back(new Slab(1024));
-}
-
-Slab* PoolAllocator::getOrCreateSlab(std::vector<Slab*>& slabs, std::size_t chunk_size) {
-    for (Slab* slab : slabs) {
-        if (slab->has_free_chunks()) {
-            return slab;
+std::size_t PoolAllocator::usable_size(const void* ptr) const {
+    const Slab* slab = page_map_.get(ptr);
+    return slab != nullptr ? slab->chunk_size() : 0;
+}
+
+PoolStats PoolAllocator::stats() {
+    PoolStats stats;
+    stats.class_count = size_map_.count();
+
+    // Other threads' counts reach their StatCounters on their next refill
+    // or flush; the calling thread's can be folded now
+    if (thread_safe_ && collect_stats_) {
+        if (auto* own = static_cast<ThreadCache*>(pthread_getspecific(cache_key_))) {
+            for (std::size_t cls = 0; cls < size_map_.count(); ++cls) own->bins[cls].foldStats();
+        }
+    }
+
+    for (std::size_t index = 0; index < node_count_ * size_map_.count(); ++index) {
+        std::size_t cls = index % size_map_.count();
+        SizeClass& size_class = sizeClass(static_cast<unsigned>(index / size_map_.count()), cls);
+        ClassStats& out = stats.classes[cls];   // summed over nodes
+        out.chunk_size = size_class.chunk_size;
+        out.slab_bytes = size_class.slab_bytes;
+
+        std::unique_lock<std::mutex> lock(size_class.mutex, std::defer_lock);
+        if (thread_safe_) lock.lock();
+
+        // Chunks freed remotely into full slabs still count as live until
+        // the owner adopts them
+        std::size_t capacity = 0, live = 0;
+        auto count = [&](const SlabList& list) {
+            for (Slab* slab = list.front(); slab != nullptr; slab = SlabList::next(slab)) {
+                capacity += slab->bytes() / slab->chunk_size();
+                live += slab->live_chunks();
+            }
+            out.slabs += list.size();
+        };
+        size_class.forEachPartialList(count);
+        count(size_class.full);
+        count(size_class.empty);
+        out.live_chunks += live;
+        out.free_chunks += capacity - live;
+        out.empty_slabs += size_class.empty.size();
+        out.slabs_created += size_class.slabs_created;
+        out.slabs_destroyed += size_class.slabs_destroyed;
+        out.allocs += size_class.allocs.get();
+        if (!thread_safe_ && collect_stats_) out.allocs += size_class.frees.get() + live;   // see allocateSmall
+        out.frees += size_class.frees.get();
+        out.requested_bytes += size_class.requested_bytes.get();
+    }
+
+    if (thread_safe_) {
+        std::lock_guard<std::mutex> guard(caches_mutex_);
+        for (ThreadCache* cache = caches_; cache != nullptr; cache = cache->next) {
+            for (std::size_t cls = 0; cls < size_map_.count(); ++cls) {
+                const ThreadCache::Bin& bin = cache->bins[cls];
+                stats.classes[cls].allocs += bin.allocs.get();
+                stats.classes[cls].frees += bin.frees.get();
+                stats.classes[cls].requested_bytes += bin.requested_bytes.get();
+            }
+            stats.local_frees += cache->local_frees.get();
+            stats.remote_frees += cache->remote_frees.get();
         }
     }
-    
-    Slab* new_slab = new Slab(chunk_size);
-    slabs.push_back(new_slab);
-    return new_slab;
+
+    {
+        std::unique_lock<std::mutex> lock(large_mutex_, std::defer_lock);
+        if (thread_safe_) lock.lock();
+        stats.large_cached_bytes = large_cached_bytes_;
+    }
+    stats.large_allocs = large_allocs_.get();
+    stats.large_frees = large_frees_.get();
+    stats.large_cache_hits = large_cache_hits_.get();
+    stats.large_live_bytes = large_live_bytes_.load(std::memory_order_relaxed);
+    stats.foreign_frees = foreign_frees_.get();
+    stats.mapped_bytes = mapped_bytes_.load(std::memory_order_relaxed);
+    stats.peak_mapped_bytes = peak_mapped_bytes_.load(std::memory_order_relaxed);
+    for (unsigned node = 0; node < node_count_; ++node) stats.arena_reserved_bytes += nodes_[node]->arena.reserved_bytes();
+    stats.numa_nodes = node_count_;
+    stats.local_frees += local_frees_.get();
+    stats.remote_frees += remote_frees_.get();
+    return stats;
 }
 
-Slab* PoolAllocator::findSlabForPointer(void* ptr) {
-    for (Slab* slab : slabs_8_) {
-        if (slab->contains(ptr)) return slab;
+void PoolAllocator::prepare_fork() {
+    // Outer locks first: nothing takes caches_mutex_ or large_mutex_ while
+    // holding a class lock, and class locks are held around the arena and
+    // slab header allocations
+    caches_mutex_.lock();
+    large_mutex_.lock();
+    for (unsigned node = 0; node < node_count_; ++node) {
+        for (std::size_t cls = 0; cls < size_map_.count(); ++cls) sizeClass(node, cls).mutex.lock();
     }
-    for (Slab* slab : slabs_16_) {
-        if (slab->contains(ptr)) return slab;
+    for (unsigned node = 0; node < node_count_; ++node) nodes_[node]->arena.lock();
+    slab_meta_.lock();
+    cache_meta_.lock();
+    profiler_.lock();
+    trace_log_.lock();
+}
+
+void PoolAllocator::after_fork() {
+    trace_log_.unlock();
+    profiler_.unlock();
+    cache_meta_.unlock();
+    slab_meta_.unlock();
+    for (unsigned node = node_count_; node-- > 0;) nodes_[node]->arena.unlock();
+    for (unsigned node = node_count_; node-- > 0;) {
+        for (std::size_t cls = size_map_.count(); cls-- > 0;) sizeClass(node, cls).mutex.unlock();
     }
-    for (Slab* slab : slabs_32_) {
-        if (slab->contains(ptr)) return slab;
+    large_mutex_.unlock();
+    caches_mutex_.unlock();
+}
+
+void PoolAllocator::flush_trace() {
+    if (!tracing_) return;
+    if (thread_safe_) trace_log_.flush(threadCache()->trace);
+    else trace_log_.flush(local_trace_);
+}
+
+HeapProfile PoolAllocator::heap_profile() const {
+    HeapProfile profile;
+    profiler_.snapshot(profile);
+    return profile;
+}
+
+void PoolAllocator::set_numa_node(unsigned node) {
+    if (node >= node_count_) return;
+    if (!thread_safe_) {
+        local_node_ = node;
+        return;
     }
-    for (Slab* slab : slabs_64_) {
-        if (slab->contains(ptr)) return slab;
+    // Bins must only ever hold chunks of the cache's own node
+    ThreadCache* cache = threadCache();
+    if (cache->node == node) return;
+    for (std::size_t cls = 0; cls < size_map_.count(); ++cls) flush(cache, cls, 0);
+    cache->node = node;
+}
+
+void PoolAllocator::traceEvent(TraceOp op, std::size_t size, const void* ptr, std::size_t alignment) {
+    TraceLog::Buffer*& buffer = thread_safe_ ? threadCache()->trace : local_trace_;
+    if (__builtin_expect(buffer == nullptr, 0)) buffer = trace_log_.createBuffer();
+    trace_log_.record(buffer, op, size, ptr, alignment);
+}
+
+inline void PoolAllocator::countSample(void* ptr, std::size_t size) {
+    std::int64_t& countdown = thread_safe_ ? threadCache()->sample_countdown : sample_countdown_;
+    countdown -= static_cast<std::int64_t>(size);
+    if (__builtin_expect(countdown <= 0, 0)) sampleAllocation(ptr, size);
+}
+
+__attribute__((noinline)) void PoolAllocator::sampleAllocation(void* ptr, std::size_t size) {
+    if (thread_safe_) {
+        ThreadCache* cache = threadCache();
+        cache->sample_countdown = profiler_.nextInterval(cache->sample_rng);
+    } else {
+        sample_countdown_ = profiler_.nextInterval(sample_rng_);
     }
-    
-    for (Slab* slab : slabs_128_) {
-        if (slab->contains(ptr)) return slab;
+    // Skip this frame and the public entry point, so stacks start at the caller
+    if (profiler_.sample(ptr, size, 2)) findSlabForPointer(ptr)->add_sampled(1);
+}
+
+inline void PoolAllocator::forgetSample(const void* ptr) {
+    Slab* slab = page_map_.get(ptr);
+    if (slab != nullptr && slab->sampled() != 0 && profiler_.forget(ptr)) slab->add_sampled(-1);
+}
+
+void PoolAllocator::addMappedBytes(std::size_t bytes) {
+    std::size_t now = mapped_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    std::size_t peak = peak_mapped_bytes_.load(std::memory_order_relaxed);
+    while (now > peak && !peak_mapped_bytes_.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
     }
-    for (Slab* slab : slabs_256_) {
-        if (slab->contains(ptr)) return slab;
+}
+
+void* PoolAllocator::allocateLarge(std::size_t size, std::size_t alignment) {
+    // A span is told apart from a slab by a chunk size above every class,
+    // so small requests with huge alignments still get a span that big
+    size = std::max(size, size_map_.maxSize() + 1);
+    std::size_t bytes = (size + PageMap::kPageSize - 1) & ~(PageMap::kPageSize - 1);
+
+    {
+        std::unique_lock<std::mutex> lock(large_mutex_, std::defer_lock);
+        if (thread_safe_) lock.lock();
+
+        // Best fit among recently freed spans
+        Slab* best = nullptr;
+        for (Slab* span = large_cache_.front(); span != nullptr; span = SlabList::next(span)) {
+            bool aligned = (reinterpret_cast<std::uintptr_t>(span->memory()) & (alignment - 1)) == 0;
+            if (aligned && spanFits(span->bytes(), bytes) && (best == nullptr || span->bytes() < best->bytes())) {
+                best = span;
+            }
+        }
+        if (best != nullptr) {
+            large_cache_.remove(best);
+            large_cached_bytes_ -= best->bytes();
+            large_allocs_.addShared(1);
+            large_cache_hits_.addShared(1);
+            large_live_bytes_.fetch_add(best->bytes(), std::memory_order_relaxed);
+            return best->allocate();
+        }
     }
-    for (Slab* slab : slabs_512_) {
-        if (slab->contains(ptr)) return slab;
+
+    void* memory = mapAligned(bytes, alignment);
+    if (memory == nullptr) return nullptr;
+    void* header = slab_meta_.allocate();
+    if (header == nullptr) {
+        munmap(memory, bytes);
+        return nullptr;
     }
-    for (Slab* slab : slabs_1024_) {
-        if (slab->contains(ptr)) return slab;
+
+    Slab* span = new (header) Slab(bytes, memory, bytes);
+    page_map_.set(memory, bytes, span);
+    addMappedBytes(bytes);
+    large_allocs_.addShared(1);
+    large_live_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    return span->allocate();
+}
+
+void PoolAllocator::deallocateLarge(Slab* span, void* ptr) {
+    span->deallocate(ptr);
+    large_frees_.addShared(1);
+    large_live_bytes_.fetch_sub(span->bytes(), std::memory_order_relaxed);
+
+    std::unique_lock<std::mutex> lock(large_mutex_, std::defer_lock);
+    if (thread_safe_) lock.lock();
+
+    large_cache_.push_back(span);
+    large_cached_bytes_ += span->bytes();
+    if (large_cached_bytes_ > large_cache_limit_) {
+        releaseLargeCache(large_cache_limit_);
+    }
+}
+
+void PoolAllocator::releaseLargeCache(std::size_t limit) {
+    while (large_cached_bytes_ > limit && !large_cache_.empty()) {
+        Slab* span = large_cache_.pop_front();
+        large_cached_bytes_ -= span->bytes();
+        destroySlab(span);
+    }
+}
+
+void PoolAllocator::onSlabEmpty(SizeClass& size_class, Slab* slab) {
+    // The slab currently being allocated from stays, or alternating
+    // allocate/free on one object would create and destroy a slab each time
+    if (slab == size_class.partial.front()) return;
+
+    slab->list()->remove(slab);
+    if (size_class.empty.size() < max_empty_slabs_) {
+        size_class.empty.push_back(slab);
+    } else {
+        destroySlab(slab);
+    }
+}
+
+void PoolAllocator::adoptPending(SizeClass& size_class) {
+    Slab* slab = size_class.pending.takeAll();
+    while (slab != nullptr) {
+        Slab* next = PendingSlabs::next(slab);   // before adopted(): it may be queued again
+        slab->adopted();
+        slab->collectRemote();
+        // Queued for emptying, it may have been allocated from and parked
+        // since; it then waits for the next pusher
+        if (slab->list() == &size_class.full && slab->has_free_chunks()) {
+            size_class.full.remove(slab);
+            addPartial(size_class, slab);
+        }
+        if (slab->empty() && slab->settled()) onSlabEmpty(size_class, slab);
+        slab = next;
+    }
+}
+
+void PoolAllocator::addPartial(SizeClass& size_class, Slab* slab) {
+    if (most_occupied_) {
+        size_class.by_occupancy[occupancyBucket(size_class, slab->live_chunks())].push_back(slab);
+    } else {
+        size_class.partial.push_back(slab);
+    }
+}
+
+std::size_t PoolAllocator::occupancyBucket(const SizeClass& size_class, std::size_t live) const {
+    std::size_t bucket = kOccupancyBuckets - 1;
+    while (bucket > 0 && live < size_class.bucket_floor[bucket]) --bucket;
+    return bucket;
+}
+
+Slab* PoolAllocator::takeMostOccupied(SizeClass& size_class) {
+    for (std::size_t bucket = kOccupancyBuckets; bucket-- > 0;) {
+        while (Slab* slab = size_class.by_occupancy[bucket].pop_front()) {
+            // Thread-safe pools: remote frees since the slab was filed may
+            // have left it in too high a bucket
+            if (thread_safe_) {
+                slab->collectRemote();
+                std::size_t actual = occupancyBucket(size_class, slab->live_chunks());
+                if (actual < bucket) {
+                    size_class.by_occupancy[actual].push_back(slab);
+                    continue;
+                }
+            }
+            return slab;
+        }
     }
     return nullptr;
 }
 
+Slab* PoolAllocator::getOrCreateSlab(unsigned node, std::size_t cls) {
+    SizeClass& size_class = sizeClass(node, cls);
+
+    if (thread_safe_) {
+        adoptPending(size_class);
+        if (!size_class.partial.empty()) return size_class.partial.front();
+    }
+
+    Slab* slab = most_occupied_ ? takeMostOccupied(size_class) : nullptr;
+    if (slab != nullptr) {
+        size_class.partial.push_front(slab);
+        return slab;
+    }
+    slab = size_class.empty.pop_front();
+    if (slab == nullptr) {
+        slab = createSlab(node, cls);
+        if (slab == nullptr) return nullptr;
+    }
+    size_class.partial.push_front(slab);
+    return slab;
+}
+
+PoolAllocator::ThreadCache* PoolAllocator::threadCache() {
+    if (__builtin_expect(tls_cache_owner == id_, 1)) {
+        return static_cast<ThreadCache*>(tls_cache);
+    }
+    return createThreadCache();
+}
+
+PoolAllocator::ThreadCache* PoolAllocator::createThreadCache() {
+    auto* cache = static_cast<ThreadCache*>(pthread_getspecific(cache_key_));
+    if (cache == nullptr) {
+        void* memory = cache_meta_.allocate();
+        if (memory == nullptr) abort();  // every thread-safe call needs a cache
+        cache = new (memory) ThreadCache(this);
+        if (node_count_ > 1) cache->node = currentNumaNode() % node_count_;
+        if (profiling_) {
+            cache->sample_rng = (reinterpret_cast<std::uintptr_t>(cache) ^ id_) * 0x9E3779B97F4A7C15ull | 1;
+            cache->sample_countdown = profiler_.nextInterval(cache->sample_rng);
+        }
+        {
+            std::lock_guard<std::mutex> guard(caches_mutex_);
+            cache->next = caches_;
+            if (caches_ != nullptr) caches_->prev = cache;
+            caches_ = cache;
+        }
+    }
+    // Memoize first: pthread_setspecific may itself allocate, and if this
+    // pool is serving malloc that call has to find the cache
+    tls_cache_owner = id_;
+    tls_cache = cache;
+    pthread_setspecific(cache_key_, cache);
+    return cache;
+}
+
+void PoolAllocator::refill(ThreadCache* cache, std::size_t cls) {
+    ThreadCache::Bin& bin = cache->bins[cls];
+    if (collect_stats_) bin.foldStats();
+
+    void* chunks[kMaxBatch];
+    std::size_t got;
+    {
+        SizeClass& size_class = sizeClass(cache->node, cls);
+        std::lock_guard<std::mutex> guard(size_class.mutex);
+        adoptPending(size_class);   // slabs emptied since, so the cap applies
+        got = allocateFromSlabs(cache->node, cls, chunks, size_class.batch);
+    }
+    for (std::size_t i = 0; i < got; ++i) {
+        Node* node = static_cast<Node*>(chunks[i]);
+        node->next = bin.head;
+        bin.head = node;
+    }
+    bin.count += static_cast<std::uint32_t>(got);
+    bin.folded_count = bin.count;
+}
+
+void PoolAllocator::flush(ThreadCache* cache, std::size_t cls, std::size_t keep) {
+    ThreadCache::Bin& bin = cache->bins[cls];
+    if (collect_stats_) bin.foldStats();
+
+    // Keep the most recently freed (cache-hot) chunks, give back the rest
+    Node* rest = bin.head;
+    Node* last_kept = nullptr;
+    for (std::size_t i = 0; i < keep && rest != nullptr; ++i) {
+        last_kept = rest;
+        rest = rest->next;
+    }
+    if (last_kept != nullptr) {
+        last_kept->next = nullptr;
+    } else {
+        bin.head = nullptr;
+    }
+    bin.count = static_cast<std::uint32_t>(std::min<std::size_t>(keep, bin.count));
+    bin.folded_count = bin.count;
+
+    // Runs of chunks from the same slab go back with a single CAS, and
+    // without the class lock: a slab this empties is queued on pending
+    while (rest != nullptr) {
+        Slab* slab = findSlabForPointer(rest);
+        Node* first = rest;
+        Node* last = rest;
+        std::size_t n = 1;
+        while (last->next != nullptr && findSlabForPointer(last->next) == slab) {
+            last = last->next;
+            ++n;
+        }
+        rest = last->next;
+        returnChain(slab, first, last, n);
+    }
+}
+
+void PoolAllocator::releaseThreadCache(void* ptr) {
+    auto* cache = static_cast<ThreadCache*>(ptr);
+    PoolAllocator* pool = cache->owner;
+
+    pool->trace_log_.releaseBuffer(cache->trace);
+    for (std::size_t cls = 0; cls < pool->size_map_.count(); ++cls) {
+        pool->flush(cache, cls, 0);
+
+        // Fold this thread's counts into the class before the cache goes
+        ThreadCache::Bin& bin = cache->bins[cls];
+        if (pool->collect_stats_) bin.foldStats();
+        SizeClass& size_class = pool->sizeClass(cache->node, cls);
+        if (!size_class.pending.empty()) {
+            // This thread may never refill again to reclaim what it emptied
+            std::lock_guard<std::mutex> guard(size_class.mutex);
+            pool->adoptPending(size_class);
+        }
+        size_class.allocs.addShared(bin.allocs.get());
+        size_class.frees.addShared(bin.frees.get());
+        size_class.requested_bytes.addShared(bin.requested_bytes.get());
+    }
+    pool->local_frees_.addShared(cache->local_frees.get());
+    pool->remote_frees_.addShared(cache->remote_frees.get());
+    {
+        std::lock_guard<std::mutex> guard(pool->caches_mutex_);
+        if (cache->prev != nullptr) cache->prev->next = cache->next;
+        else pool->caches_ = cache->next;
+        if (cache->next != nullptr) cache->next->prev = cache->prev;
+    }
+
+    // Later key destructors may still allocate from this pool; make them
+    // go back through pthread_getspecific and build a fresh cache.
+    if (tls_cache == cache) {
+        tls_cache_owner = 0;
+        tls_cache = nullptr;
+    }
+    cache->~ThreadCache();
+    pool->cache_meta_.deallocate(cache);
+}
+
+Slab* PoolAllocator::createSlab(unsigned node, std::size_t cls) {
+    SizeClass& size_class = sizeClass(node, cls);
+    // Mapped directly, not taken from malloc, so the pool can serve malloc
+    // itself. Page aligned, so no two slabs share a page map entry, and
+    // aligned to the class's own alignment so every chunk is. Arena spans
+    // are aligned to their size, which is at least both.
+    void* memory = use_arena_ ? nodes_[node]->arena.allocate(size_class.slab_bytes)
+                              : mapAligned(size_class.slab_bytes,
+                                           std::max(size_map_.classAlignment(cls), PageMap::kPageSize));
+    if (memory == nullptr) return nullptr;
+    void* header = slab_meta_.allocate();
+    if (header == nullptr) {
+        if (use_arena_) nodes_[node]->arena.deallocate(memory, size_class.slab_bytes);
+        else munmap(memory, size_class.slab_bytes);
+        return nullptr;
+    }
+    if (!use_arena_ && node_count_ > 1) preferNumaNode(memory, size_class.slab_bytes, node);
+    Slab* slab = new (header) Slab(size_class.chunk_size, memory, size_class.slab_bytes);
+    slab->set_node(node);
+    addMappedBytes(size_class.slab_bytes);
+    ++size_class.slabs_created;
+    page_map_.set(memory, size_class.slab_bytes, slab);
+    return slab;
+}
+
+void PoolAllocator::destroySlab(Slab* slab) {
+    bool class_slab = slab->chunk_size() <= size_map_.maxSize();   // not a large span
+    if (class_slab) {
+        ++sizeClassOf(slab).slabs_destroyed;
+    }
+    mapped_bytes_.fetch_sub(slab->bytes(), std::memory_order_relaxed);
+    page_map_.clear(slab->memory(), slab->bytes());
+    if (class_slab && use_arena_) nodes_[slab->node()]->arena.deallocate(slab->memory(), slab->bytes());
+    else munmap(slab->memory(), slab->bytes());
+    slab->~Slab();
+    slab_meta_.deallocate(slab);
+}
+
+void PoolAllocator::destroyAllSlabs() {
+    for (std::size_t index = 0; index < node_count_ * size_map_.count(); ++index) {
+        SizeClass& size_class = sizeClass(static_cast<unsigned>(index / size_map_.count()), index % size_map_.count());
+        size_class.pending.takeAll();
+        auto destroyAll = [&](SlabList& list) {
+            while (Slab* slab = list.pop_front()) destroySlab(slab);
+        };
+        size_class.forEachPartialList(destroyAll);
+        destroyAll(size_class.full);
+        destroyAll(size_class.empty);
+    }
+}
+
 } // namespace slab
@@ -1,44 +1,308 @@
 #pragma once
 
+#include "Arena.hpp"
+#include "HeapProfile.hpp"
+#include "MetaAllocator.hpp"
+#include "PageMap.hpp"
+#include "PoolStats.hpp"
+#include "SizeClasses.hpp"
 #include "Slab.hpp"
+#include "SlabList.hpp"
+#include "Trace.hpp"
+#include <pthread.h>
 #include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace slab {
 
+enum class SlabSelection {
+    kFirstFit,      // partly used slabs in the order they gained free chunks
+    kMostOccupied,  // the fullest partly used slab, so the emptiest ones drain and can be released
+};
+
+struct PoolOptions {
+    // Per-thread caches in front of the slabs, refilled and flushed in
+    // batches; chunks freed back to a slab from any thread go through its
+    // lock-free remote-free queue. Required if several threads share the pool.
+    bool thread_safe = false;
+
+    // Chunk sizes served from slabs; larger requests are large objects
+    SizeClassMap size_classes = SizeClassMap::geometric(32768);
+
+    // Large objects are whole mmap'd pages; freed spans up to this many
+    // bytes stay mapped and are reused for later requests of similar size.
+    std::size_t large_cache_bytes = std::size_t{32} << 20;
+
+    // Slabs are carved from regions of this many bytes (see Arena.hpp),
+    // so they sit together in memory and share TLB entries; 0 maps each
+    // slab on its own. Regions are address space: pages are committed as
+    // slabs touch them.
+    std::size_t arena_bytes = std::size_t{64} << 20;
+
+    // Page size backing the arena. Huge pages cut TLB misses on large
+    // working sets, but a small pool's first slab then commits 2MB.
+    HugePages huge_pages = HugePages::kNone;
+
+    // Slab lists and arenas per NUMA node: a thread allocates from its own
+    // node's slabs, whose memory the kernel is asked to place on that node.
+    // 0 uses every node the host has (just one on most machines); 1 turns
+    // this off. Larger counts than the host has are allowed, for testing.
+    unsigned numa_nodes = 0;
+
+    // Which partly used slab a class turns to once the one it allocates from
+    // fills up. kMostOccupied files them in occupancy buckets (as Hoard's
+    // fullness groups) so that frees left scattered over many slabs
+    // concentrate back into few, and the rest empty out.
+    SlabSelection slab_selection = SlabSelection::kMostOccupied;
+
+    // Empty slabs kept per class for reuse; beyond this they are returned to
+    // the OS as soon as they empty out (thread-safe pools: when the class
+    // next refills a thread cache, or the thread that emptied them exits,
+    // so frees stay lock-free). trim() ignores the cap and
+    // returns all of them, the slab each class allocates from included.
+    std::size_t max_empty_slabs_per_class = 2;
+
+    // If non-zero (thread-safe pools only), a background thread calls trim()
+    // at this interval so memory decays back after a burst.
+    unsigned trim_interval_ms = 0;
+
+    // Check every sized free against the pointer's owning class. This costs
+    // the page-map lookup the sized path otherwise skips; meant for tests
+    // and debug builds.
+    bool verify_sized_frees = false;
+
+    // Called when a check above fails; nullptr prints the message and
+    // aborts. If it returns, the pointer is freed as if no size was given.
+    void (*error_handler)(const char* message, const void* ptr) = nullptr;
+
+    // deallocate() hands pointers the pool does not own to this; nullptr
+    // means std::free. A pool that replaces malloc points it at the
+    // underlying allocator instead.
+    void (*foreign_free)(void* ptr) = nullptr;
+
+    // Per-class alloc/free/requested-byte counters for stats(). Slab,
+    // large-object and mapping counts are kept regardless.
+    bool collect_stats = true;
+
+    // If set, every allocation and free is appended to a binary log at this
+    // path (see Trace.hpp and the slab_replay tool). Each thread buffers
+    // its own events: they reach the file when its buffer fills, when the
+    // thread exits, on flush_trace() and when the pool is destroyed.
+    const char* trace_path = nullptr;
+
+    // If non-zero, one allocation in about every this many bytes has its
+    // stack captured and is tracked until freed (see heap_profile()). The
+    // sampling points are random, so every byte has the same chance of
+    // being sampled whatever the allocation pattern. While on, every free
+    // checks the page map for sampled chunks in its slab; allocations only
+    // count down a per-thread byte budget. 512KB gives a few thousand
+    // samples on a gigabyte heap.
+    std::size_t profile_sample_bytes = 0;
+};
+
 class PoolAllocator {
 public:
     PoolAllocator();
+    explicit PoolAllocator(const PoolOptions& options);
     ~PoolAllocator();
 
-    void* allocate(std::size_t size);     // Allocate memory of given size
-    void  deallocate(void* ptr);          // Deallocate memory
-    void  reset();                        // Reset all pools (free all memory)
+    void* allocate(std::size_t size);     // Allocate memory of given size; nullptr if no memory can be mapped
+    // alignment is a power of two; nullptr if it is not. Memory from here
+    // must be freed unsized or with the same size and alignment.
+    void* allocate(std::size_t size, std::size_t alignment);
+    void  deallocate(void* ptr);          // Deallocate memory; nullptr is a no-op
+    // Same pointer while new_size fits its chunk and uses at least half of
+    // it; otherwise the contents move to a new chunk, except that large
+    // objects are remapped rather than copied. nullptr if memory runs out
+    // (ptr stays valid) or ptr is not the pool's (reported like a bad sized
+    // free). nullptr ptr allocates; new_size 0 frees.
+    void* reallocate(void* ptr, std::size_t new_size);
+    // size passed to allocate(); skips the ownership lookup where it can
+    // (thread-safe pools on one node), so only there must ptr be the pool's
+    void  deallocate(void* ptr, std::size_t size);
+    void  deallocate(void* ptr, std::size_t size, std::size_t alignment); // for allocate(size, alignment)
+
+    // Batch forms: one class lookup per call and whole free-list segments
+    // per slab. allocate_bulk returns how many of the n pointers it filled
+    // (fewer only if a mapping fails). deallocate_bulk takes pointers
+    // of any sizes, skipping nulls; frees from the same slab are best kept
+    // adjacent.
+    std::size_t allocate_bulk(std::size_t size, std::size_t n, void** out);
+    void  deallocate_bulk(void** ptrs, std::size_t n);
+    void  deallocate_bulk(void** ptrs, std::size_t n, std::size_t size); // every ptr from allocate(size)
+    void  reset();                        // Reset all pools (free all memory); no other thread may be using the pool
+    bool  owns(const void* ptr) const;    // true if ptr came from this pool's slabs or large spans
+    std::size_t usable_size(const void* ptr) const; // bytes usable at ptr (its chunk or span size); 0 if not owned
+    void  trim();                         // return every empty slab, whatever the cap, and cached large span to the OS
+    // Snapshot; takes each class lock in turn, safe while other threads
+    // run. Their event counts lag by up to a thread cache's worth of calls.
+    PoolStats stats();
+    void  flush_trace();                  // write out the calling thread's buffered trace events
+    HeapProfile heap_profile() const;     // sampled sites so far; empty unless profile_sample_bytes was set
+    // Serve the calling thread from this node's slabs from now on (a
+    // single-threaded pool: every thread). The node is otherwise the one
+    // the thread was running on when it first used the pool.
+    void  set_numa_node(unsigned node);
+    // pthread_atfork handlers. prepare_fork() takes every lock in the pool
+    // in one fixed order, so fork() copies it while no other thread is
+    // half way through a call; after_fork() releases them and runs in the
+    // parent and the child alike. The child keeps the other threads'
+    // caches, and their chunks, unused.
+    void  prepare_fork();
+    void  after_fork();
 
     // Disable copying
     PoolAllocator(const PoolAllocator&) = delete;
     PoolAllocator& operator=(const PoolAllocator&) = delete;
 
 private:
-    static constexpr std::size_t kMaxPoolSize = 4096;  // Maximum size for pools
-    
-    std::vector<Slab*> slabs_8_;   // 8-byte slabs
-    std::vector<Slab*> slabs_16_;  // 16-byte slabs
-    std::vector<Slab*> slabs_32_;  // 32-byte slabs
-    std::vector<Slab*> slabs_64_;  // 64-byte slabs
-    std::vector<Slab*> slabs_128_; // 128-byte slabs
-    std::vector<Slab*> slabs_256_; // 256-byte slabs
-    std::vector<Slab*> slabs_512_; // 512-byte slabs
-    std::vector<Slab*> slabs_1024_; // 1024-byte slabs
-    
-    // Fast path caching
-    Slab* last_used_slab_8_ = nullptr;
-    Slab* last_used_slab_16_ = nullptr;
-    Slab* last_used_slab_32_ = nullptr;
-    Slab* last_used_slab_64_ = nullptr;
+    static constexpr std::size_t kOccupancyBuckets = 8;
+
+    // Per-class state; indexed by SizeClassMap::classIndex
+    struct alignas(64) SizeClass {
+        SlabList      partial;               // allocation always comes from partial.front()
+        // kMostOccupied: every other slab with free chunks, by live chunks;
+        // bucket b holds those with at least bucket_floor[b]
+        SlabList      by_occupancy[kOccupancyBuckets];
+        std::uint32_t bucket_floor[kOccupancyBuckets] = {};
+        SlabList      full;                  // no free chunks
+        SlabList      empty;                 // retained for reuse, at most max_empty_slabs_
+        PendingSlabs  pending;               // thread-safe mode: full slabs that received remote frees
+        std::size_t   chunk_size = 0;
+        std::size_t   slab_bytes = 0;
+        std::uint32_t batch = 0;             // chunks moved per thread-cache refill/flush
+        StatCounter   allocs;                // threads that have exited; single-threaded pools: chunks reset() dropped live
+        StatCounter   frees;
+        StatCounter   requested_bytes;
+        std::uint64_t slabs_created = 0;
+        std::uint64_t slabs_destroyed = 0;
+        std::mutex    mutex;                 // thread-safe mode: guards the fields above
+
+        template <typename Fn>
+        void forEachPartialList(Fn fn) {     // partial, then each occupancy bucket
+            fn(partial);
+            for (SlabList& bucket : by_occupancy) fn(bucket);
+        }
+    };
+
+    struct ThreadCache;
+
+    static constexpr unsigned kMaxNumaNodes = 8;
+
+    // Everything a node's slabs come from
+    struct NumaNode {
+        SizeClass classes[SizeClassMap::kMaxClasses];
+        Arena     arena;                     // class slabs, unless arena_bytes was 0
+
+        NumaNode(std::size_t arena_bytes, HugePages huge_pages, int node) : arena(arena_bytes, huge_pages, node) {}
+    };
+
+    SizeClassMap   size_map_;
+    const unsigned node_count_;
+    const bool     use_arena_;
+    NumaNode       first_node_;              // node 0, and the only one on most hosts
+    NumaNode*      nodes_[kMaxNumaNodes] = {}; // the rest are mapped at construction
+    unsigned       local_node_ = 0;          // single-threaded pools allocate from this node
+
+    PageMap page_map_; // page -> owning slab, for O(1) deallocate
+
+    // Large-object tier: a span is a one-chunk Slab over its own mapping
+    std::mutex         large_mutex_;        // thread-safe mode: guards the cache
+    SlabList           large_cache_;        // freed spans, oldest first
+    std::size_t        large_cached_bytes_ = 0;
+    const std::size_t  large_cache_limit_;
+
+    const std::size_t  max_empty_slabs_;
+    const bool         most_occupied_;      // slab_selection == kMostOccupied
+    const bool         verify_sized_frees_;
+    void             (*const error_handler_)(const char* message, const void* ptr);
+    void             (*const foreign_free_)(void* ptr);
+    const bool         collect_stats_;
+
+    TraceLog           trace_log_;
+    const bool         tracing_;            // trace_log_.enabled(), read on every call
+    TraceLog::Buffer*  local_trace_ = nullptr; // single-threaded pools; thread-safe ones buffer per ThreadCache
+
+    HeapProfiler       profiler_;
+    const bool         profiling_;          // profiler_.enabled(), read on every call
+    std::int64_t       sample_countdown_ = 0; // single-threaded pools: bytes until the next sample
+    std::uint64_t      sample_rng_ = 0;       //   and the generator drawing the intervals
+
+    // Counters that live outside any one class
+    StatCounter              large_allocs_;
+    StatCounter              large_frees_;
+    StatCounter              large_cache_hits_;
+    StatCounter              foreign_frees_;
+    StatCounter              local_frees_;  // NUMA pools only: freed on the slab's node
+    StatCounter              remote_frees_; //   and from another node
+    std::atomic<std::size_t> large_live_bytes_{0};
+    std::atomic<std::size_t> mapped_bytes_{0};
+    std::atomic<std::size_t> peak_mapped_bytes_{0};
+
+    MetaAllocator      slab_meta_;          // Slab headers, so the pool never calls malloc itself
+    MetaAllocator      cache_meta_;         // ThreadCaches
+
+    // Thread-safe mode only
+    const bool    thread_safe_;
+    std::uint64_t id_;                     // unique per instance, never reused
+    pthread_key_t cache_key_;              // this thread's ThreadCache
+    std::mutex    caches_mutex_;
+    ThreadCache*  caches_ = nullptr;       // every live thread cache, for teardown
+
+    // Background trim (thread-safe mode, trim_interval_ms > 0)
+    std::thread             trim_thread_;
+    std::mutex              trim_mutex_;
+    std::condition_variable trim_cv_;
+    bool                    trim_stop_ = false;
     
-    Slab* getOrCreateSlab(std::vector<Slab*>& slabs, std::size_t chunk_size);
-    Slab* findSlabForPointer(void* ptr);
+    inline SizeClass& sizeClass(unsigned node, std::size_t cls) { return nodes_[node]->classes[cls]; }
+    inline SizeClass& sizeClassOf(const Slab* slab) { return sizeClass(slab->node(), size_map_.classIndex(slab->chunk_size())); }
+
+    void* allocateFromSlabs(unsigned node, std::size_t cls); // central path; class lock held in thread-safe mode
+    std::size_t allocateFromSlabs(unsigned node, std::size_t cls, void** out, std::size_t n);
+    void  retireIfExhausted(SizeClass& size_class, Slab* slab); // park a slab with no free chunks on full
+    void  deallocateRun(Slab* slab, void** ptrs, std::size_t n); // chunks all owned by one small-object slab
+    std::size_t allocateBulk(std::size_t size, std::size_t n, void** out); // allocate_bulk, untraced
+    void  deallocateUnsized(void* ptr);        // deallocate(ptr), untraced
+    void  deallocateInClass(void* ptr, std::size_t size, std::size_t cls); // sized free; cls == count() for large objects
+    void  cacheChunks(std::size_t cls, Node* first, Node* last, std::size_t n); // thread-safe: push a chain onto this thread's bin
+    bool  freeIfRemote(Slab* slab, Node* first, Node* last, std::size_t n); // thread-safe NUMA pools: true if the chain was another node's and went straight back
+    void  returnChain(Slab* slab, Node* first, Node* last, std::size_t n); // thread-safe: push n chunks back onto their slab, lock-free
+    void  onChunksFreed(SizeClass& size_class, Slab* slab, std::size_t n); // list transitions after a local free
+    void  onLiveChunksDropped(SizeClass& size_class, Slab* slab); // re-bucket a listed, not full slab, or apply the cap if it emptied
+    bool  checkSizedFree(void* ptr, std::size_t cls) const;    // false (after reporting) if ptr is not in class cls (count() for large)
+    ThreadCache* threadCache();
+    ThreadCache* createThreadCache();
+    void  refill(ThreadCache* cache, std::size_t cls);
+    void  flush(ThreadCache* cache, std::size_t cls, std::size_t keep);
+    static void releaseThreadCache(void* cache); // pthread key destructor, runs at thread exit
+
+    void* allocateSmall(std::size_t cls, std::size_t size); // from this thread's cache or the slabs
+    void* allocateLarge(std::size_t size, std::size_t alignment = PageMap::kPageSize);
+    void  deallocateLarge(Slab* span, void* ptr);
+    void  releaseLargeCache(std::size_t limit); // unmap oldest cached spans until at most limit bytes remain
+    bool  remapLarge(Slab* span, std::size_t size); // resize a live span with mremap; false leaves it as it was
+
+    void  onSlabEmpty(SizeClass& size_class, Slab* slab); // apply the retention cap to a slab that just emptied
+    void  addPartial(SizeClass& size_class, Slab* slab);  // a slab that just gained free chunks
+    std::size_t occupancyBucket(const SizeClass& size_class, std::size_t live) const;
+    Slab* takeMostOccupied(SizeClass& size_class); // off the highest non-empty bucket; nullptr if all are empty
+    void  adoptPending(SizeClass& size_class); // take back queued slabs: full ones with remote frees, and emptied ones
+
+    Slab* getOrCreateSlab(unsigned node, std::size_t cls); // new partial.front(): pending, retained empty or fresh; nullptr if none can be mapped
+    Slab* createSlab(unsigned node, std::size_t cls);      // new slab, registered in page_map_; nullptr, mapping nothing, if memory runs out
+    void  destroySlab(Slab* slab);             // unregister, release and delete; an unlisted slab's pages go back to the OS
+    void  destroyAllSlabs();
+    void  addMappedBytes(std::size_t bytes);   // and raise the peak
+    void  traceEvent(TraceOp op, std::size_t size, const void* ptr, std::size_t alignment = 1);
+    void  countSample(void* ptr, std::size_t size);      // charge an allocation to this thread's sample countdown
+    void  sampleAllocation(void* ptr, std::size_t size); // the countdown ran out: record ptr and redraw it
+    void  forgetSample(const void* ptr);                 // before a free; cheap unless ptr's slab holds samples
+    inline Slab* findSlabForPointer(void* ptr) const { return page_map_.get(ptr); }
 };
 
 } // namespace slab
@@ -0,0 +1,21 @@
+#include "PoolResource.hpp"
+
+namespace slab {
+
+void* PoolMemoryResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    void* ptr = pool_->allocate(bytes, alignment);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void PoolMemoryResource::do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) {
+    pool_->deallocate(ptr, bytes, alignment);
+}
+
+bool PoolMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    if (this == &other) return true;
+    auto* resource = dynamic_cast<const PoolMemoryResource*>(&other);
+    return resource != nullptr && resource->pool_ == pool_;
+}
+
+} // namespace slab
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "PoolAllocator.hpp"
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+namespace slab {
+
+// std::pmr adapter: lets pmr containers (std::pmr::map, ...) draw from a
+// PoolAllocator. Frees pass the size back, so they take the sized path.
+// Thread-safe if the pool is. Allocation failure throws std::bad_alloc, as
+// memory_resource requires.
+class PoolMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit PoolMemoryResource(PoolAllocator& pool) : pool_(&pool) {}
+
+    inline PoolAllocator& pool() const { return *pool_; }
+
+private:
+    PoolAllocator* pool_;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void  do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+    bool  do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Standard Allocator over a PoolAllocator, for containers that take an
+// allocator type rather than a resource. Rebinds freely; copies compare
+// equal when they share a pool.
+template <typename T>
+class PoolStlAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    explicit PoolStlAllocator(PoolAllocator& pool) noexcept : pool_(&pool) {}
+    template <typename U>
+    PoolStlAllocator(const PoolStlAllocator<U>& other) noexcept : pool_(&other.pool()) {}
+
+    [[nodiscard]] T* allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) throw std::bad_array_new_length();
+        void* ptr = pool_->allocate(n * sizeof(T), alignof(T));
+        if (ptr == nullptr) throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        pool_->deallocate(ptr, n * sizeof(T), alignof(T));
+    }
+
+    inline PoolAllocator& pool() const noexcept { return *pool_; }
+
+    template <typename U>
+    bool operator==(const PoolStlAllocator<U>& other) const noexcept { return pool_ == &other.pool(); }
+
+private:
+    PoolAllocator* pool_;
+};
+
+} // namespace slab
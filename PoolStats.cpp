@@ -0,0 +1,84 @@
+#include "PoolStats.hpp"
+#include <iomanip>
+#include <ostream>
+
+namespace slab {
+
+std::uint64_t PoolStats::allocs() const {
+    std::uint64_t total = large_allocs;
+    for (std::size_t cls = 0; cls < class_count; ++cls) total += classes[cls].allocs;
+    return total;
+}
+
+std::uint64_t PoolStats::frees() const {
+    std::uint64_t total = large_frees;
+    for (std::size_t cls = 0; cls < class_count; ++cls) total += classes[cls].frees;
+    return total;
+}
+
+double PoolStats::internal_fragmentation() const {
+    std::uint64_t handed_out = 0, requested = 0;
+    for (std::size_t cls = 0; cls < class_count; ++cls) {
+        handed_out += classes[cls].allocs * classes[cls].chunk_size;
+        requested += classes[cls].requested_bytes;
+    }
+    return handed_out == 0 ? 0.0 : 1.0 - static_cast<double>(requested) / static_cast<double>(handed_out);
+}
+
+void PoolStats::write_text(std::ostream& out) const {
+    // The caller's stream: put its formatting back afterwards
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "pool: " << allocs() << " allocs, " << frees() << " frees, "
+        << mapped_bytes << " bytes mapped (peak " << peak_mapped_bytes << ", "
+        << arena_reserved_bytes << " reserved), "
+        << std::fixed << std::setprecision(1) << internal_fragmentation() * 100 << "% rounding waste\n";
+    out << "large: " << large_allocs << " allocs (" << large_cache_hits << " from cache), "
+        << large_frees << " frees, " << large_live_bytes << " bytes live, "
+        << large_cached_bytes << " bytes cached\n";
+    out << "foreign frees: " << foreign_frees << "\n";
+    if (numa_nodes > 1) {
+        out << "numa: " << numa_nodes << " nodes, " << local_frees << " local frees, "
+            << remote_frees << " remote frees\n";
+    }
+
+    out << std::setw(8) << "class" << std::setw(8) << "slabs" << std::setw(8) << "empty"
+        << std::setw(12) << "live" << std::setw(12) << "free"
+        << std::setw(14) << "allocs" << std::setw(14) << "frees" << "\n";
+    for (std::size_t cls = 0; cls < class_count; ++cls) {
+        const ClassStats& c = classes[cls];
+        if (c.allocs == 0 && c.slabs == 0) continue;
+        out << std::setw(8) << c.chunk_size << std::setw(8) << c.slabs << std::setw(8) << c.empty_slabs
+            << std::setw(12) << c.live_chunks << std::setw(12) << c.free_chunks
+            << std::setw(14) << c.allocs << std::setw(14) << c.frees << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void PoolStats::write_json(std::ostream& out) const {
+    out << "{\"allocs\":" << allocs() << ",\"frees\":" << frees()
+        << ",\"mapped_bytes\":" << mapped_bytes << ",\"peak_mapped_bytes\":" << peak_mapped_bytes
+        << ",\"arena_reserved_bytes\":" << arena_reserved_bytes
+        << ",\"internal_fragmentation\":" << internal_fragmentation()
+        << ",\"foreign_frees\":" << foreign_frees
+        << ",\"numa\":{\"nodes\":" << numa_nodes << ",\"local_frees\":" << local_frees
+        << ",\"remote_frees\":" << remote_frees << "}"
+        << ",\"large\":{\"allocs\":" << large_allocs << ",\"frees\":" << large_frees
+        << ",\"cache_hits\":" << large_cache_hits << ",\"live_bytes\":" << large_live_bytes
+        << ",\"cached_bytes\":" << large_cached_bytes << "}"
+        << ",\"classes\":[";
+    for (std::size_t cls = 0; cls < class_count; ++cls) {
+        const ClassStats& c = classes[cls];
+        if (cls > 0) out << ",";
+        out << "{\"chunk_size\":" << c.chunk_size << ",\"slab_bytes\":" << c.slab_bytes
+            << ",\"slabs\":" << c.slabs << ",\"empty_slabs\":" << c.empty_slabs
+            << ",\"live_chunks\":" << c.live_chunks << ",\"free_chunks\":" << c.free_chunks
+            << ",\"allocs\":" << c.allocs << ",\"frees\":" << c.frees
+            << ",\"requested_bytes\":" << c.requested_bytes
+            << ",\"slabs_created\":" << c.slabs_created << ",\"slabs_destroyed\":" << c.slabs_destroyed << "}";
+    }
+    out << "]}";
+}
+
+} // namespace slab
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "SizeClasses.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+namespace slab {
+
+// Event counter with one writer at a time (the owning thread, or whoever
+// holds the lock it lives under): bumped with a relaxed load and store
+// instead of a locked read-modify-write, readable from any thread.
+class StatCounter {
+public:
+    inline void add(std::uint64_t n = 1) { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    inline void addShared(std::uint64_t n) { value_.fetch_add(n, std::memory_order_relaxed); } // several writers
+    inline void reset() { value_.store(0, std::memory_order_relaxed); }
+    inline std::uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint64_t> value_{0};
+};
+
+struct ClassStats {
+    std::size_t   chunk_size = 0;
+    std::size_t   slab_bytes = 0;
+    std::size_t   slabs = 0;            // every slab the class holds, including retained empties
+    std::size_t   empty_slabs = 0;      // retained for reuse
+    std::size_t   live_chunks = 0;      // handed out of slabs; thread-safe pools include cached chunks and uncollected remote frees
+    std::size_t   free_chunks = 0;      // still in slabs
+    std::uint64_t allocs = 0;
+    std::uint64_t frees = 0;
+    std::uint64_t requested_bytes = 0;  // sum of sizes asked for; allocs * chunk_size were handed out
+    std::uint64_t slabs_created = 0;
+    std::uint64_t slabs_destroyed = 0;
+};
+
+// Snapshot returned by PoolAllocator::stats(). Counters are cumulative
+// since construction; the rest is the state at the time of the call.
+struct PoolStats {
+    ClassStats    classes[SizeClassMap::kMaxClasses];
+    std::size_t   class_count = 0;
+
+    std::uint64_t large_allocs = 0;
+    std::uint64_t large_frees = 0;
+    std::uint64_t large_cache_hits = 0;  // served from a cached span instead of a new mapping
+    std::size_t   large_live_bytes = 0;
+    std::size_t   large_cached_bytes = 0;
+
+    std::uint64_t foreign_frees = 0;     // pointers deallocate() passed on to foreign_free
+
+    // Pools over several NUMA nodes: small-object frees by a thread on the
+    // chunk's own node, and by a thread on another one. Zero otherwise.
+    unsigned      numa_nodes = 1;
+    std::uint64_t local_frees = 0;
+    std::uint64_t remote_frees = 0;
+    std::size_t   mapped_bytes = 0;      // slab and span memory currently mapped
+    std::size_t   peak_mapped_bytes = 0;
+    std::size_t   arena_reserved_bytes = 0; // address space reserved for slabs, committed or not
+
+    std::uint64_t allocs() const;        // small and large
+    std::uint64_t frees() const;
+    // Share of the bytes handed out by size classes that callers did not
+    // ask for (rounding up to the class size), over every allocation so far
+    double internal_fragmentation() const;
+
+    void write_text(std::ostream& out) const;
+    void write_json(std::ostream& out) const;
+};
+
+} // namespace slab
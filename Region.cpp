@@ -0,0 +1,84 @@
+#include "Region.hpp"
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstdint>
+
+namespace slab {
+
+Region::Region(PoolAllocator& pool, std::size_t block_bytes)
+    : pool_(&pool),
+      block_bytes_((std::max(block_bytes, PageMap::kPageSize) + PageMap::kPageSize - 1) & ~(PageMap::kPageSize - 1)) {}
+
+Region::~Region() {
+    reset();
+    release();
+}
+
+void* Region::allocateSlow(std::size_t size, std::size_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) return nullptr;
+    // What fits in a fresh block whatever its padding; no underflow, as
+    // blocks are at least a page
+    if (alignment > block_bytes_ / 4 || size > block_bytes_ - sizeof(Block) - alignment) {
+        return allocateLarge(size, alignment);
+    }
+
+    // The next retained block if there is one, else a new one after the current
+    Block* next = current_ != nullptr ? current_->next : head_;
+    if (next == nullptr) {
+        void* memory = mapAligned(block_bytes_, PageMap::kPageSize);
+        if (memory == nullptr) return nullptr;
+        next = static_cast<Block*>(memory);
+        next->next = nullptr;
+        if (current_ != nullptr) current_->next = next;
+        else head_ = next;
+    }
+    current_ = next;
+    bump_ = payload(next);
+    end_ = reinterpret_cast<char*>(next) + block_bytes_;
+    return allocate(size, alignment);
+}
+
+void* Region::allocateLarge(std::size_t size, std::size_t alignment) {
+    // The header sits in a page of its own in front, so the object keeps
+    // any alignment up to the mapping's
+    std::size_t front = std::max(alignment, PageMap::kPageSize);
+    if (size > SIZE_MAX - 2 * front) return nullptr;
+    std::size_t bytes = (front + size + PageMap::kPageSize - 1) & ~(PageMap::kPageSize - 1);
+    void* memory = mapAligned(bytes, front);
+    if (memory == nullptr) return nullptr;
+    Large* large = static_cast<Large*>(memory);
+    large->next = large_;
+    large->bytes = bytes;
+    large_ = large;
+    return static_cast<char*>(memory) + front;
+}
+
+void Region::rewind(const Mark& mark) {
+    while (large_ != mark.large) {
+        Large* next = large_->next;
+        munmap(large_, large_->bytes);
+        large_ = next;
+    }
+    current_ = mark.block;
+    bump_ = mark.bump;
+    end_ = mark.block != nullptr ? reinterpret_cast<char*>(mark.block) + block_bytes_ : nullptr;
+}
+
+void Region::release() {
+    Block* block = current_ != nullptr ? current_->next : head_;
+    if (current_ != nullptr) current_->next = nullptr;
+    else head_ = nullptr;
+    while (block != nullptr) {
+        Block* next = block->next;
+        munmap(block, block_bytes_);
+        block = next;
+    }
+}
+
+std::size_t Region::retained_bytes() const {
+    std::size_t bytes = 0;
+    for (Block* block = head_; block != nullptr; block = block->next) bytes += block_bytes_;
+    return bytes;
+}
+
+} // namespace slab
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "PoolAllocator.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace slab {
+
+// Monotonic bump allocator over slab-sized blocks, for per-request memory.
+// Nothing is freed one object at a time: a Mark records the position and
+// rewind() returns to it in O(1), keeping every block for the next
+// request. Objects that must outlive the request go to pool() instead.
+// Blocks come from mmap and go back to the OS in release() or when the
+// region is destroyed. No destructors are run. Not thread-safe.
+class Region {
+    struct Block;
+    struct Large;
+
+public:
+    struct Mark {
+        Block* block;   // nullptr: before the first block
+        char*  bump;
+        Large* large;   // newest oversized allocation at the time
+    };
+
+    // Rewinds the region to where it was at construction
+    class Scope {
+    public:
+        explicit Scope(Region& region) : region_(region), mark_(region.mark()) {}
+        ~Scope() { region_.rewind(mark_); }
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Region& region_;
+        Mark    mark_;
+    };
+
+    explicit Region(PoolAllocator& pool, std::size_t block_bytes = Slab::kSlabSize);
+    ~Region();
+
+    // alignment is a power of two; nullptr if it is not or mmap fails.
+    // Requests too big for a block get a mapping of their own, unmapped
+    // when the region rewinds past them.
+    inline void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+        std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(bump_) + alignment - 1) & ~(alignment - 1);
+        std::uintptr_t end = reinterpret_cast<std::uintptr_t>(end_);
+        bool power_of_two = alignment != 0 && (alignment & (alignment - 1)) == 0;   // folds for constants
+        if (__builtin_expect(power_of_two && bump_ != nullptr && aligned <= end && size <= end - aligned, 1)) {
+            bump_ = reinterpret_cast<char*>(aligned + size);
+            return reinterpret_cast<void*>(aligned);
+        }
+        return allocateSlow(size, alignment);
+    }
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {             // nullptr if allocation fails
+        static_assert(std::is_trivially_destructible_v<T>, "a region never runs destructors");
+        void* memory = allocate(sizeof(T), alignof(T));
+        return memory != nullptr ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    inline Mark mark() const { return {current_, bump_, large_}; }
+    void rewind(const Mark& mark);           // mark must come from this region, taken since the last release()
+    inline void reset() { rewind(Mark{nullptr, nullptr, nullptr}); }
+    void release();                          // unmap the blocks past the current one
+
+    inline PoolAllocator& pool() const { return *pool_; }
+    inline std::size_t block_bytes() const { return block_bytes_; }
+    std::size_t retained_bytes() const;      // blocks mapped, in use or not
+
+    Region(const Region&)            = delete;
+    Region& operator=(const Region&) = delete;
+
+private:
+    struct Block {
+        Block* next;
+    };
+    struct Large {
+        Large*      next;
+        std::size_t bytes;   // of the whole mapping
+    };
+
+    PoolAllocator*    pool_;
+    const std::size_t block_bytes_;
+    Block*            head_ = nullptr;     // every block, in the order they are used
+    Block*            current_ = nullptr;
+    char*             bump_ = nullptr;
+    char*             end_ = nullptr;
+    Large*            large_ = nullptr;    // newest first
+
+    void* allocateSlow(std::size_t size, std::size_t alignment);
+    void* allocateLarge(std::size_t size, std::size_t alignment);
+    inline char* payload(Block* block) const { return reinterpret_cast<char*>(block) + sizeof(Block); }
+};
+
+} // namespace slab
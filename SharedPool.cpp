@@ -0,0 +1,157 @@
+#include "SharedPool.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <bit>
+#include <new>
+
+namespace slab {
+
+namespace {
+
+// Free-list links hold offset / kMinChunk in 32 bits
+constexpr std::uint64_t kMaxRegionBytes = (std::uint64_t{1} << 32) * SharedPool::kMinChunk;
+
+inline std::size_t classOf(std::size_t size) {   // size in [1, kMaxSize]
+    constexpr int kMinShift = std::countr_zero(SharedPool::kMinChunk);
+    return size <= SharedPool::kMinChunk ? 0 : static_cast<std::size_t>(std::bit_width(size - 1)) - kMinShift;
+}
+
+inline std::uint64_t nextTag(std::uint64_t head) { return ((head >> 32) + 1) << 32; }
+
+} // namespace
+
+SharedPool::SharedPool(const char* name, std::size_t bytes) {
+    if (bytes == 0 || bytes > kMaxRegionBytes) return;
+    std::size_t slabs = (bytes + kSlabBytes - 1) / kSlabBytes;
+    std::size_t first_slab = (sizeof(Header) + slabs + kSlabBytes - 1) & ~(kSlabBytes - 1);
+    std::size_t total = first_slab + slabs * kSlabBytes;
+    if (total > kMaxRegionBytes) return;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return;
+    // ftruncate leaves the region zeroed: every free list empty, no slab carved
+    bool mapped = ftruncate(fd, static_cast<off_t>(total)) == 0 && map(fd, total);
+    close(fd);
+    if (!mapped) {
+        shm_unlink(name);
+        return;
+    }
+
+    header_ = new (base_) Header{};
+    header_->region_bytes = total;
+    header_->first_slab = first_slab;
+    header_->next_slab.store(first_slab, std::memory_order_relaxed);
+    header_->magic.store(kMagic, std::memory_order_release);
+}
+
+SharedPool::SharedPool(const char* name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return;
+    struct stat status;
+    bool mapped = fstat(fd, &status) == 0 && static_cast<std::size_t>(status.st_size) >= sizeof(Header) &&
+                  map(fd, static_cast<std::size_t>(status.st_size));
+    close(fd);
+    if (!mapped) return;
+
+    if (header_->magic.load(std::memory_order_acquire) != kMagic || header_->region_bytes != mapped_bytes_) {
+        munmap(base_, mapped_bytes_);
+        base_ = nullptr;
+        header_ = nullptr;
+        slab_classes_ = nullptr;
+    }
+}
+
+SharedPool::~SharedPool() {
+    if (base_ != nullptr) munmap(base_, mapped_bytes_);
+}
+
+bool SharedPool::unlink(const char* name) {
+    return shm_unlink(name) == 0;
+}
+
+bool SharedPool::map(int fd, std::size_t bytes) {
+    void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return false;
+    base_ = static_cast<char*>(base);
+    mapped_bytes_ = bytes;
+    header_ = reinterpret_cast<Header*>(base_);
+    slab_classes_ = reinterpret_cast<std::uint8_t*>(base_ + sizeof(Header));
+    return true;
+}
+
+SharedPool::Offset SharedPool::allocate(std::size_t size) {
+    if (size - 1 >= kMaxSize || base_ == nullptr) return kNull;   // size 0 wraps
+    std::size_t cls = classOf(size);
+    std::atomic<std::uint64_t>& head = header_->free_heads[cls];
+
+    std::uint64_t top = head.load(std::memory_order_acquire);
+    while (std::uint32_t first = static_cast<std::uint32_t>(top)) {
+        Offset chunk = Offset{first} * kMinChunk;
+        // If another process takes the chunk first, this reads whatever it
+        // wrote there, and the tag makes the exchange fail
+        std::uint64_t next = nextTag(top) | link(chunk).load(std::memory_order_relaxed);
+        if (head.compare_exchange_weak(top, next, std::memory_order_acquire, std::memory_order_acquire)) {
+            return chunk;
+        }
+    }
+    return carveSlab(cls);
+}
+
+bool SharedPool::deallocate(Offset offset) {
+    if (base_ == nullptr || offset < header_->first_slab || offset >= header_->region_bytes) return false;
+    Offset in_region = offset - header_->first_slab;
+    std::uint8_t entry = std::atomic_ref<std::uint8_t>(slab_classes_[in_region / kSlabBytes]).load(std::memory_order_acquire);
+    if (entry == 0) return false;                   // not carved yet
+    std::size_t cls = entry - 1;
+    if ((in_region & ((kMinChunk << cls) - 1)) != 0) return false;
+    push(cls, offset, offset);
+    return true;
+}
+
+std::size_t SharedPool::region_bytes() const {
+    return mapped_bytes_;
+}
+
+std::size_t SharedPool::used_bytes() const {
+    if (base_ == nullptr) return 0;
+    std::uint64_t next = header_->next_slab.load(std::memory_order_relaxed);
+    return static_cast<std::size_t>((next < header_->region_bytes ? next : header_->region_bytes) - header_->first_slab);
+}
+
+SharedPool::Offset SharedPool::carveSlab(std::size_t cls) {
+    // Once the region is used up the counter keeps climbing past its end;
+    // every later carve fails the same way
+    Offset slab = header_->next_slab.fetch_add(kSlabBytes, std::memory_order_relaxed);
+    if (slab + kSlabBytes > header_->region_bytes) return kNull;
+
+    std::uint8_t& entry = slab_classes_[(slab - header_->first_slab) / kSlabBytes];
+    std::atomic_ref<std::uint8_t>(entry).store(static_cast<std::uint8_t>(cls + 1), std::memory_order_release);
+
+    // Every class has at least four chunks per slab
+    std::size_t chunk_size = kMinChunk << cls;
+    Offset first = slab + chunk_size;
+    Offset last = slab + kSlabBytes - chunk_size;
+    for (Offset chunk = first; chunk < last; chunk += chunk_size) {
+        link(chunk).store(static_cast<std::uint32_t>((chunk + chunk_size) / kMinChunk), std::memory_order_relaxed);
+    }
+    push(cls, first, last);
+    return slab;
+}
+
+void SharedPool::push(std::size_t cls, Offset first, Offset last) {
+    std::atomic<std::uint64_t>& head = header_->free_heads[cls];
+    std::uint64_t top = head.load(std::memory_order_relaxed);
+    std::uint64_t next;
+    do {
+        link(last).store(static_cast<std::uint32_t>(top), std::memory_order_relaxed);
+        next = nextTag(top) | first / kMinChunk;
+    } while (!head.compare_exchange_weak(top, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+std::atomic_ref<std::uint32_t> SharedPool::link(Offset chunk) const {
+    return std::atomic_ref<std::uint32_t>(*reinterpret_cast<std::uint32_t*>(base_ + chunk));
+}
+
+} // namespace slab
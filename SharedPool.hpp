@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace slab {
+
+// Pool that lives entirely inside a named shared-memory region (shm_open +
+// mmap), so that every process mapping the region can allocate and free
+// in it. The region maps at a different address in each process, so
+// nothing inside it holds a pointer: objects are named by their Offset from
+// the region's start, free lists link chunks by offset, and the slab table
+// records each slab's class by index. at() turns an offset into this
+// process's address. Passing a message between processes then means
+// passing its 8-byte offset.
+//
+// Classes are powers of two from kMinChunk to kMaxSize. Slabs of
+// kSlabBytes are carved from the region with a shared bump offset and never
+// returned. Each class keeps one lock-free free list whose head carries a
+// tag against ABA. All shared state is lock-free atomics, which work
+// across processes; there are no locks, so a process that dies mid-call
+// leaks at most the chunks it was handling and blocks no one. Thread-safe
+// within a process as well.
+class SharedPool {
+public:
+    using Offset = std::uint64_t;
+
+    static constexpr Offset      kNull = 0;                         // offset 0 is the header, never a chunk
+    static constexpr std::size_t kSlabBytes = std::size_t{1} << 16;
+    static constexpr std::size_t kMinChunk = 16;
+    static constexpr std::size_t kMaxSize = std::size_t{1} << 14;
+    static constexpr std::size_t kClassCount = 11;                  // 16B ... 16KB
+
+    // Creates the region name ("/name", as for shm_open) with room for
+    // bytes of slabs. Fails if it exists already. The region outlives
+    // the pool until unlink().
+    SharedPool(const char* name, std::size_t bytes);
+    // Maps a region another SharedPool created; fails unless creation has
+    // completed
+    explicit SharedPool(const char* name);
+    ~SharedPool();                                  // unmaps; the region and its objects stay
+
+    static bool unlink(const char* name);           // as shm_unlink; mappings stay valid
+
+    inline bool valid() const { return base_ != nullptr; }  // false if creating or mapping failed
+
+    // kNull if size is 0 or above kMaxSize, the region has no slab left for
+    // the class, or the pool is not valid. Chunks are aligned to their
+    // size, up to a page.
+    Offset allocate(std::size_t size);
+    bool   deallocate(Offset offset);               // false, changing nothing, if offset is not a chunk's
+
+    inline void* at(Offset offset) const { return base_ + offset; }
+    template <typename T>
+    inline T* get(Offset offset) const { return reinterpret_cast<T*>(base_ + offset); }
+    inline Offset offset_of(const void* ptr) const { return static_cast<Offset>(static_cast<const char*>(ptr) - base_); }
+
+    std::size_t region_bytes() const;               // whole mapping, header included
+    std::size_t used_bytes() const;                 // slabs carved so far
+
+    SharedPool(const SharedPool&)            = delete;
+    SharedPool& operator=(const SharedPool&) = delete;
+
+private:
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                  "a lock-based atomic would keep its lock in this process, not in the region");
+
+    // At offset 0 of the region, followed by the slab table
+    struct Header {
+        std::atomic<std::uint64_t> magic;           // kMagic once the creator has laid out the region
+        std::uint64_t              region_bytes;
+        std::uint64_t              first_slab;      // offset of slab 0
+        std::atomic<std::uint64_t> next_slab;       // offset of the next slab to carve
+        // tag << 32 | offset / kMinChunk of the first free chunk
+        std::atomic<std::uint64_t> free_heads[kClassCount];
+    };
+
+    static constexpr std::uint64_t kMagic = 0x534C4142504F4F4Cull;  // "SLABPOOL"
+
+    char*         base_ = nullptr;
+    std::size_t   mapped_bytes_ = 0;
+    Header*       header_ = nullptr;
+    std::uint8_t* slab_classes_ = nullptr;          // class + 1 per slab; 0 until carved
+
+    bool   map(int fd, std::size_t bytes);
+    Offset carveSlab(std::size_t cls);              // links all but the first chunk into the class's list
+    void   push(std::size_t cls, Offset first, Offset last);
+    std::atomic_ref<std::uint32_t> link(Offset chunk) const;  // next free chunk, / kMinChunk
+};
+
+} // namespace slab
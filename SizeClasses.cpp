@@ -0,0 +1,59 @@
+#include "SizeClasses.hpp"
+#include "Slab.hpp"
+#include <algorithm>
+
+namespace slab {
+
+SizeClassMap::SizeClassMap(const std::vector<std::size_t>& sizes) {
+    std::vector<std::size_t> sorted;
+    for (std::size_t size : sizes) {
+        if (size == 0) continue;
+        size = (size + kAlignment - 1) & ~(kAlignment - 1);
+        sorted.push_back(std::min(size, kMaxSize));
+    }
+    if (sorted.empty()) sorted.push_back(kAlignment);
+
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    if (sorted.size() > kMaxClasses) sorted.resize(kMaxClasses);
+
+    count_ = sorted.size();
+    std::copy(sorted.begin(), sorted.end(), sizes_);
+
+    for (std::size_t cls = 0; cls < count_; ++cls) {
+        std::size_t bytes = Slab::kSlabSize;
+        while (bytes < sizes_[cls] * kMinChunksPerSlab) bytes <<= 1;
+        slab_bytes_[cls] = bytes;
+    }
+
+    // Each lookup slot covers a range of sizes; it maps to the smallest class
+    // that fits the largest size in that range.
+    std::size_t cls = 0;
+    for (std::size_t slot = 0; slot < kLookupLength; ++slot) {
+        std::size_t slot_max = slot <= (kSmallLimit >> 3) ? slot << 3 : (slot << 7) - (127 + (120 << 7)) + 127;
+        while (cls + 1 < count_ && sizes_[cls] < slot_max) ++cls;
+        lookup_[slot] = static_cast<std::uint8_t>(cls);
+    }
+}
+
+SizeClassMap SizeClassMap::geometric(std::size_t max_size, std::size_t classes_per_doubling) {
+    classes_per_doubling = std::max<std::size_t>(classes_per_doubling, 1);  // as the constructor skips zero sizes
+    std::vector<std::size_t> sizes = {8, 16};
+    std::size_t size = 16;
+    while (size < max_size && sizes.size() < kMaxClasses) {
+        std::size_t group = std::size_t{1} << (63 - __builtin_clzll(size));  // power of two at or below size
+        size += std::max<std::size_t>(16, group / classes_per_doubling);
+        sizes.push_back(std::min(size, max_size));
+    }
+    return SizeClassMap(sizes);
+}
+
+SizeClassMap SizeClassMap::powersOfTwo(std::size_t max_size) {
+    std::vector<std::size_t> sizes;
+    for (std::size_t size = 8; size <= max_size; size <<= 1) {
+        sizes.push_back(size);
+    }
+    return SizeClassMap(sizes);
+}
+
+} // namespace slab
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace slab {
+
+// Table of chunk sizes served by the pool, with an O(1) size -> class
+// lookup. Small sizes are looked up at 8-byte granularity and large ones at
+// 128-byte granularity (the tcmalloc scheme), so the table stays a few KB
+// and the mapping is two shifts, a select and one load.
+class SizeClassMap {
+public:
+    static constexpr std::size_t kMaxClasses = 64;
+    static constexpr std::size_t kMaxSize = std::size_t{1} << 18;  // 256KB
+    static constexpr std::size_t kAlignment = 8;                   // every class is a multiple of this
+    static constexpr std::size_t kMinChunksPerSlab = 8;            // big classes get bigger slabs
+
+    SizeClassMap() : SizeClassMap(geometric(32768)) {}
+    explicit SizeClassMap(const std::vector<std::size_t>& sizes); // rounded up to kAlignment, sorted, deduplicated
+
+    // jemalloc-style: 8, 16, then classes_per_doubling steps per power of
+    // two (never closer than 16 bytes) up to max_size; 0 steps means 1
+    static SizeClassMap geometric(std::size_t max_size, std::size_t classes_per_doubling = 4);
+    static SizeClassMap powersOfTwo(std::size_t max_size);      // 8, 16, 32, ... max_size
+
+    inline std::size_t classIndex(std::size_t size) const {    // requires size <= maxSize()
+        return lookup_[lookupSlot(size)];
+    }
+    // Smallest class of at least size whose chunks are all aligned to
+    // alignment (a power of two); count() if there is none
+    inline std::size_t alignedClassIndex(std::size_t size, std::size_t alignment) const {
+        if (size > maxSize()) return count_;
+        std::size_t cls = classIndex(size);
+        while (cls < count_ && classAlignment(cls) < alignment) ++cls;
+        return cls;
+    }
+    inline std::size_t classSize(std::size_t cls) const { return sizes_[cls]; }
+    // Every chunk of the class is aligned to the largest power of two
+    // dividing its size: slab bases are aligned at least that far
+    inline std::size_t classAlignment(std::size_t cls) const { return sizes_[cls] & (~sizes_[cls] + 1); }
+    inline std::size_t slabBytes(std::size_t cls) const { return slab_bytes_[cls]; }
+    inline std::size_t count() const { return count_; }
+    inline std::size_t maxSize() const { return sizes_[count_ - 1]; }
+
+private:
+    static constexpr std::size_t kSmallLimit = 1024;
+    static constexpr std::size_t kLookupLength = ((kMaxSize + 127 + (120 << 7)) >> 7) + 1;
+
+    static inline std::size_t lookupSlot(std::size_t size) {
+        return size <= kSmallLimit ? (size + 7) >> 3 : (size + 127 + (120 << 7)) >> 7;
+    }
+
+    std::size_t  sizes_[kMaxClasses];
+    std::size_t  slab_bytes_[kMaxClasses];   // Slab::kSlabSize, or the power of two holding kMinChunksPerSlab chunks
+    std::size_t  count_ = 0;
+    std::uint8_t lookup_[kLookupLength];
+};
+
+} // namespace slab
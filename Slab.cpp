@@ -2,33 +2,44 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <sys/mman.h>
 
 namespace slab {
 
-Slab::Slab(size_t chunkSize) : chunkSize_(chunkSize), memory_(nullptr), freeList_(nullptr) {
+Slab::Slab(size_t chunkSize)
+    : chunkSize_(chunkSize), bytes_(kSlabSize), memory_(nullptr), ownsMemory_(true),
+      freeList_(nullptr), bump_(nullptr), bumpEnd_(nullptr), liveChunks_(0), remoteFree_(nullptr) {
     // TODO: Initialize the slab
     // 1. Allocate memory_ using malloc or aligned_alloc
     // 2. Initialize freeList_ as a linked list of all chunks
     // 3. Each chunk should point to the next chunk
 
-    memory_ = malloc(kSlabSize);
-
-    for (size_t i = 0; i < kSlabSize; i += chunkSize_) {
-        void* chunk = ((char*)memory_) + i;
-        Node* node = (Node*)chunk;  
-        node->next = freeList_;
-        freeList_ = node;
-    }
+    memory_ = aligned_alloc(kSlabAlignment, kSlabSize);
+    format();
 
     // std::cout << "Slab initialized with " << kSlabSize << " bytes" << std::endl;
 }
 
+Slab::Slab(size_t chunkSize, void* memory, size_t bytes)
+    : chunkSize_(chunkSize), bytes_(bytes), memory_(memory), ownsMemory_(false),
+      freeList_(nullptr), bump_(nullptr), bumpEnd_(nullptr), liveChunks_(0), remoteFree_(nullptr) {
+    format();
+}
+
+void Slab::format() {
+    // Nothing is written to the slab here: chunks are carved off the front
+    // of the untouched tail as they are needed, so a fresh slab costs no
+    // page faults beyond the chunks it actually hands out.
+    bump_ = (char*)memory_;
+    bumpEnd_ = bump_ + (bytes_ / chunkSize_) * chunkSize_;
+}
+
 Slab::~Slab() {
     // TODO: Free the allocated memory
     // 1. Free memory_ using free()
     // 2. Reset pointers to nullptr
 
-    free(memory_);
+    if (ownsMemory_) free(memory_);
     freeList_ = nullptr;
 }
 
@@ -38,10 +49,20 @@ void* Slab::allocate() {
     // 2. Remove the first chunk from freeList_
     // 3. Return the chunk pointer
     // 4. Return nullptr if no chunks available
-    if (freeList_ == nullptr) return nullptr;
+    if (freeList_ == nullptr) {
+        collectRemote();
+        if (freeList_ == nullptr) {
+            if (bump_ == bumpEnd_) return nullptr;
+            void* chunk = bump_;
+            bump_ += chunkSize_;
+            ++liveChunks_;
+            return chunk;
+        }
+    }
 
     Node* node = freeList_;
     freeList_ = node->next;
+    ++liveChunks_;
     return (void*)node; 
 }
 
@@ -52,34 +73,109 @@ void Slab::deallocate(void* ptr) {
     // 3. Update freeList_ to point to this chunk
 
     auto* base = (char*)memory_;
-    auto* end_of_slab = ((char*)memory_ + kSlabSize);
+    auto* end_of_slab = ((char*)memory_ + bytes_);
     auto* p = (char*)ptr;
     if(p >= base && p < end_of_slab) {
         Node* node = (Node*)ptr; 
         node->next = freeList_;
         freeList_ = node;
+        --liveChunks_;
     }
 }
 
-bool Slab::empty() const {
-    // TODO: Check if all chunks are free
-    // 1. Count total chunks in the slab
-    // 2. Count chunks in freeList_
-    // 3. Return true if all chunks are in freeList_
-    
-    size_t totalChunks = kSlabSize / chunkSize_;
-    
-    size_t freeChunks = 0;
-    Node* current = freeList_;
-    while (current != nullptr) {
-        freeChunks++;
-        current = current->next;
+std::size_t Slab::allocateBatch(void** out, std::size_t n) {
+    std::size_t got = 0;
+    while (got < n) {
+        if (freeList_ == nullptr) {
+            collectRemote();
+            if (freeList_ == nullptr) break;
+        }
+        out[got++] = freeList_;
+        freeList_ = freeList_->next;
     }
-    
-    return freeChunks == totalChunks;
+    while (got < n && bump_ != bumpEnd_) {
+        out[got++] = bump_;
+        bump_ += chunkSize_;
+    }
+    liveChunks_ += got;
+    return got;
 }
 
+void Slab::deallocateBatch(Node* first, Node* last, std::size_t count) {
+    // The caller has already resolved every chunk to this slab
+    last->next = freeList_;
+    freeList_ = first;
+    liveChunks_ -= count;
+}
 
+void Slab::collectRemote() {
+    // Adopt everything other threads have pushed since the last drain. A
+    // parked slab is left alone: its notification is still outstanding.
+    Node* adopted = remoteFree_.load(std::memory_order_relaxed);
+    if (adopted == nullptr || isFullTag(adopted)) return;
+    adopted = remoteFree_.exchange(nullptr, std::memory_order_acquire);
+
+    Node* last = adopted;
+    std::size_t count = 1;
+    while (last->next != nullptr) {
+        last = last->next;
+        ++count;
+    }
+    last->next = freeList_;
+    freeList_ = adopted;
+    liveChunks_ -= count;
+}
+
+bool Slab::deallocateRemote(Node* first, Node* last, std::size_t n) {
+    // Many producers, one consumer: the owner takes the whole stack with a
+    // single exchange, so pushes never see a node being popped (no ABA).
+    // Replacing kFullTag clears it, so only one pusher observes it.
+    Node* head = remoteFree_.load(std::memory_order_relaxed);
+    do {
+        last->next = isFullTag(head) ? nullptr : head;
+    } while (!remoteFree_.compare_exchange_weak(head, first, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed));
+
+    // Counted back only after the push, so once the owner sees the state
+    // at zero no pusher touches the slab again
+    std::size_t state = remoteState_.load(std::memory_order_relaxed);
+    std::size_t next;
+    do {
+        next = state - 2 * n;
+        if (next == 0 || isFullTag(head)) next |= kQueued;
+    } while (!remoteState_.compare_exchange_weak(state, next, std::memory_order_acq_rel,
+                                                 std::memory_order_relaxed));
+    return (next & kQueued) != 0 && (state & kQueued) == 0;
+}
+
+bool Slab::markFull() {
+    Node* expected = nullptr;
+    return remoteFree_.compare_exchange_strong(expected, reinterpret_cast<Node*>(kFullTag),
+                                               std::memory_order_acq_rel);
+}
+
+void Slab::handOut(std::size_t n) {
+    remoteState_.fetch_add(2 * n, std::memory_order_relaxed);
+}
+
+void Slab::adopted() {
+    remoteState_.fetch_and(~kQueued, std::memory_order_acq_rel);
+}
+
+void* mapAligned(std::size_t bytes, std::size_t alignment, int flags) {
+    std::size_t reserve = alignment > Slab::kSlabAlignment ? bytes + alignment : bytes;
+    void* raw = mmap(nullptr, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+    if (reserve == bytes) return raw;
+
+    // Over-reserve, then give back the misaligned head and the tail
+    std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw);
+    std::uintptr_t aligned = (start + alignment - 1) & ~(alignment - 1);
+    if (aligned > start) munmap(raw, aligned - start);
+    std::uintptr_t end = start + reserve;
+    if (end > aligned + bytes) munmap(reinterpret_cast<void*>(aligned + bytes), end - aligned - bytes);
+    return reinterpret_cast<void*>(aligned);
+}
 
 bool Slab::contains(void* ptr) const {
     // TODO: Check if the pointer is within the slab's memory range
@@ -87,7 +183,7 @@ bool Slab::contains(void* ptr) const {
     // 2. Check if the pointer is within the slab's memory range
     // 3. Return true if the pointer is within the slab's memory range
     auto* base = (char*)memory_;
-    auto* end_of_slab = ((char*)memory_ + kSlabSize);
+    auto* end_of_slab = ((char*)memory_ + bytes_);
     auto* p = (char*)ptr;
     if(p >= base && p < end_of_slab) return true;
     return false;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 
 namespace slab {
 
@@ -8,27 +10,93 @@ struct Node {
     Node* next;     // Points to the next Node
 };
 
+class SlabList;
+class PendingSlabs;
+
 class Slab {
 public:
 
     static constexpr std::size_t kSlabSize = 1 << 14;  // 16KB instead of 1MB 
+    static constexpr std::size_t kSlabAlignment = 1 << 12; // page aligned so no two slabs share a page
 
     explicit Slab(std::size_t chunkSize); // chunk size (power-of-two preferred)
+    Slab(std::size_t chunkSize, void* memory, std::size_t bytes); // carve caller-owned memory; not freed by ~Slab
     ~Slab();
 
-    void* allocate();           // O(1) pop from free list; nullptr if exhausted
+    void* allocate();           // O(1): recycled chunk first, else carve from the tail; nullptr if exhausted
     void  deallocate(void* p);  // O(1) push onto free list
-    bool  empty() const;        // true if every chunk is currently free
-    inline bool has_free_chunks() const { return freeList_ != nullptr; } // true if slab has any free chunks
+    std::size_t allocateBatch(void** out, std::size_t n);          // up to n chunks into out; returns how many
+    void  deallocateBatch(Node* first, Node* last, std::size_t count); // splice a chain of this slab's chunks back
+    // Lock-free push of a chain of n chunks, callable from any thread.
+    // Returns true if the slab had been parked with markFull(), or if these
+    // were the last chunks handOut() counted: the caller must then hand it
+    // back to its owner. Only one pusher sees this until the owner calls
+    // adopted().
+    bool  deallocateRemote(Node* first, Node* last, std::size_t n);
+    bool  markFull();           // owner: out of chunks; false if remote frees arrived meanwhile
+    void  collectRemote();      // adopt chunks pushed by deallocateRemote into the free list
+    void  handOut(std::size_t n); // owner: n chunks given out that will come back through deallocateRemote
+    void  adopted();            // owner: took the slab back after deallocateRemote returned true
+    // Owner: no chunk is out and no pusher still holds the slab, so it can
+    // be reused or destroyed
+    inline bool settled() const { return remoteState_.load(std::memory_order_acquire) == 0; }
+    // true if every chunk is currently free; chunks freed by other threads count once adopted
+    inline bool empty() const { return liveChunks_ == 0; }
+    inline std::size_t live_chunks() const { return liveChunks_; }
+    inline bool has_free_chunks() const { // true if slab has any free chunks
+        return freeList_ != nullptr || bump_ != bumpEnd_ || reinterpret_cast<std::uintptr_t>(remoteFree_.load(std::memory_order_relaxed)) > kFullTag;
+    }
     bool  contains(void* ptr) const; // true if p is within the slab's memory range
+    inline void* memory() const { return memory_; } // base of the slab's memory range
+    inline std::size_t chunk_size() const { return chunkSize_; }
+    inline std::size_t bytes() const { return bytes_; } // length of the slab's memory range
+    inline SlabList* list() const { return list_; }      // list the owning pool keeps this slab on
+    inline unsigned node() const { return node_; }       // NUMA node the owning pool placed it on
+    inline void set_node(unsigned node) { node_ = node; }
+    // Live chunks the pool's heap profiler is tracking; any thread
+    inline std::uint32_t sampled() const { return sampled_.load(std::memory_order_relaxed); }
+    inline void add_sampled(int n) { sampled_.fetch_add(static_cast<std::uint32_t>(n), std::memory_order_relaxed); }
 
     Slab(const Slab&)            = delete;
     Slab& operator=(const Slab&) = delete;
 
 private:
+    friend class SlabList;
+    friend class PendingSlabs;
+
+    // Value of remoteFree_ while the slab is parked as full: no remote
+    // chunks, and the next pusher must notify the owner
+    static constexpr std::uintptr_t kFullTag = 1;
+    static inline bool isFullTag(const Node* head) { return reinterpret_cast<std::uintptr_t>(head) == kFullTag; }
+    // Bit of remoteState_ set while the owner has been asked to take the
+    // slab back; the chunks still out are counted above it
+    static constexpr std::size_t kQueued = 1;
+
     std::size_t chunkSize_; // bytes per chunk
+    std::size_t bytes_;     // slab memory length
     void*       memory_;    // raw slab memory returned by malloc/mmap
-    Node*       freeList_;  // singly-linked list of free chunks (intrusive)
+    bool        ownsMemory_;
+    Node*       freeList_;  // singly-linked list of recycled chunks (intrusive)
+    char*       bump_;      // next never-used chunk; chunks are carved lazily in address order
+    char*       bumpEnd_;   // end of the last whole chunk
+    std::size_t liveChunks_; // chunks handed out and not yet back on freeList_
+    std::atomic<Node*> remoteFree_; // MPSC stack of chunks freed by other threads; drained by allocate()
+    std::atomic<std::size_t> remoteState_{0}; // 2 * chunks handed out and not pushed back, | kQueued
+
+    // Owned by the pool's slab lists
+    Slab*       listPrev_ = nullptr;
+    Slab*       listNext_ = nullptr;
+    SlabList*   list_ = nullptr;
+    Slab*       pendingNext_ = nullptr;
+    unsigned    node_ = 0;
+    std::atomic<std::uint32_t> sampled_{0};
+
+    void format();          // reset the tail to cover every chunk; touches no slab memory
 };
 
+// bytes of fresh zeroed memory from mmap, aligned to alignment (a power of
+// two, at least a page); nullptr if the mapping fails. Release with munmap.
+// flags are added to MAP_PRIVATE | MAP_ANONYMOUS.
+void* mapAligned(std::size_t bytes, std::size_t alignment, int flags = 0);
+
 } // namespace slab
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Slab.hpp"
+#include <atomic>
+#include <cstddef>
+
+namespace slab {
+
+// Intrusive doubly-linked list of slabs. A slab is on at most one list at a
+// time; the links live in the Slab, so moving it between lists is O(1) and
+// never allocates.
+class SlabList {
+public:
+    inline Slab* front() const { return head_; }
+    inline bool  empty() const { return head_ == nullptr; }
+    inline std::size_t size() const { return size_; }
+    static inline Slab* next(const Slab* slab) { return slab->listNext_; }
+
+    inline void push_front(Slab* slab) {
+        slab->listPrev_ = nullptr;
+        slab->listNext_ = head_;
+        if (head_ != nullptr) head_->listPrev_ = slab;
+        else tail_ = slab;
+        head_ = slab;
+        slab->list_ = this;
+        ++size_;
+    }
+
+    inline void push_back(Slab* slab) {
+        slab->listNext_ = nullptr;
+        slab->listPrev_ = tail_;
+        if (tail_ != nullptr) tail_->listNext_ = slab;
+        else head_ = slab;
+        tail_ = slab;
+        slab->list_ = this;
+        ++size_;
+    }
+
+    inline void remove(Slab* slab) {
+        if (slab->listPrev_ != nullptr) slab->listPrev_->listNext_ = slab->listNext_;
+        else head_ = slab->listNext_;
+        if (slab->listNext_ != nullptr) slab->listNext_->listPrev_ = slab->listPrev_;
+        else tail_ = slab->listPrev_;
+        slab->listPrev_ = slab->listNext_ = nullptr;
+        slab->list_ = nullptr;
+        --size_;
+    }
+
+    inline Slab* pop_front() {
+        Slab* slab = head_;
+        if (slab != nullptr) remove(slab);
+        return slab;
+    }
+
+private:
+    Slab*       head_ = nullptr;
+    Slab*       tail_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Lock-free stack of slabs that need the owner's attention, pushed from any
+// thread and drained all at once under the class lock.
+class PendingSlabs {
+public:
+    inline void push(Slab* slab) {
+        Slab* head = head_.load(std::memory_order_relaxed);
+        do {
+            slab->pendingNext_ = head;
+        } while (!head_.compare_exchange_weak(head, slab, std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    inline Slab* takeAll() {
+        if (head_.load(std::memory_order_relaxed) == nullptr) return nullptr;
+        return head_.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    inline bool empty() const { return head_.load(std::memory_order_relaxed) == nullptr; }
+    static inline Slab* next(const Slab* slab) { return slab->pendingNext_; }
+
+private:
+    std::atomic<Slab*> head_{nullptr};
+};
+
+} // namespace slab
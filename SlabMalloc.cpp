@@ -0,0 +1,322 @@
+// malloc/free/new/delete replacement over a process-wide thread-safe
+// PoolAllocator, built as libslab_malloc.so and loaded with LD_PRELOAD:
+//
+//     LD_PRELOAD=./libslab_malloc.so ./some_service
+//
+// With SLAB_TRACE=path set, every process writes an allocation trace to
+// path.<pid> for slab_replay. Events buffered by threads still running at
+// exit() are lost. With SLAB_HEAP_PROFILE=path set, allocations are
+// sampled every 512KB on average and a pprof heap profile of what is still
+// live is written to path.<pid> at exit().
+//
+// Pointers the pool does not own (allocated by glibc before the library
+// was bound) go back to glibc.
+//
+// fork() from a threaded process is safe: the pool's locks are all held
+// across it, so the child never inherits one taken by a thread it does not
+// have.
+
+#include "PoolAllocator.hpp"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <new>
+
+#define SLAB_VISIBLE __attribute__((visibility("default")))
+#define SLAB_EXPORT extern "C" SLAB_VISIBLE
+
+extern "C" {
+void  __libc_free(void* ptr);
+void* __libc_realloc(void* ptr, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+}
+
+namespace {
+
+// Constructing the pool allocates (the default size-class table is built
+// in a std::vector), and so may anything else that calls malloc before the
+// pool is up. Those requests are served from this static buffer and never
+// freed.
+constexpr std::size_t kBootstrapBytes = std::size_t{64} << 10;
+constexpr std::size_t kBootstrapHeader = 16;   // size of the block, for realloc
+
+alignas(16) char bootstrap_heap[kBootstrapBytes];
+std::atomic<std::size_t> bootstrap_used{0};
+
+void* bootstrapAllocate(std::size_t size) {
+    std::size_t bytes = (size + kBootstrapHeader + 15) & ~std::size_t{15};
+    std::size_t offset = bootstrap_used.fetch_add(bytes, std::memory_order_relaxed);
+    if (offset + bytes > kBootstrapBytes) return nullptr;
+    char* block = bootstrap_heap + offset;
+    *reinterpret_cast<std::size_t*>(block) = size;
+    return block + kBootstrapHeader;
+}
+
+inline bool isBootstrap(const void* ptr) {
+    return ptr >= bootstrap_heap && ptr < bootstrap_heap + kBootstrapBytes;
+}
+
+inline std::size_t bootstrapSize(const void* ptr) {
+    return *reinterpret_cast<const std::size_t*>(static_cast<const char*>(ptr) - kBootstrapHeader);
+}
+
+// The pool lives in static storage and is never destroyed: memory may still
+// be freed from static destructors and atexit handlers
+enum PoolState : int { kUninitialized, kInitializing, kReady };
+
+alignas(slab::PoolAllocator) unsigned char pool_storage[sizeof(slab::PoolAllocator)];
+std::atomic<int> pool_state{kUninitialized};
+
+// SLAB_TRACE and SLAB_HEAP_PROFILE with ".<pid>" appended, built without
+// allocating
+constexpr std::size_t kPathBytes = 4096;
+char trace_path[kPathBytes];
+char profile_path[kPathBytes];
+
+const char* pidPath(const char* variable, char* path) {
+    const char* base = getenv(variable);
+    if (base == nullptr || *base == '\0') return nullptr;
+    std::size_t length = strnlen(base, kPathBytes - 24);
+    std::memcpy(path, base, length);
+
+    char digits[24];
+    std::size_t n = 0;
+    for (unsigned long pid = static_cast<unsigned long>(getpid()); pid != 0 || n == 0; pid /= 10) {
+        digits[n++] = static_cast<char>('0' + pid % 10);
+    }
+    path[length++] = '.';
+    while (n > 0) path[length++] = digits[--n];
+    path[length] = '\0';
+    return path;
+}
+
+void flushTrace() {
+    reinterpret_cast<slab::PoolAllocator*>(pool_storage)->flush_trace();
+}
+
+void prepareFork() {
+    reinterpret_cast<slab::PoolAllocator*>(pool_storage)->prepare_fork();
+}
+
+void afterFork() {
+    reinterpret_cast<slab::PoolAllocator*>(pool_storage)->after_fork();
+}
+
+void writeHeapProfile() {
+    std::ofstream out(profile_path);
+    reinterpret_cast<slab::PoolAllocator*>(pool_storage)->heap_profile().write_pprof(out);
+}
+
+slab::PoolAllocator* initPool() {
+    int state = kUninitialized;
+    if (!pool_state.compare_exchange_strong(state, kInitializing, std::memory_order_acquire)) {
+        // Re-entered from the constructor, or another thread is building
+        // it: the caller falls back to the bootstrap buffer
+        return state == kReady ? reinterpret_cast<slab::PoolAllocator*>(pool_storage) : nullptr;
+    }
+
+    slab::PoolOptions options;
+    options.thread_safe = true;
+    options.foreign_free = &__libc_free;
+    options.trace_path = pidPath("SLAB_TRACE", trace_path);
+    if (pidPath("SLAB_HEAP_PROFILE", profile_path) != nullptr) options.profile_sample_bytes = std::size_t{512} << 10;
+    auto* pool = new (pool_storage) slab::PoolAllocator(options);
+    pool_state.store(kReady, std::memory_order_release);
+    pthread_atfork(&prepareFork, &afterFork, &afterFork);
+    if (options.trace_path != nullptr) atexit(&flushTrace);   // the pool is never destroyed
+    if (options.profile_sample_bytes != 0) atexit(&writeHeapProfile);
+    return pool;
+}
+
+inline slab::PoolAllocator* pool() {
+    if (__builtin_expect(pool_state.load(std::memory_order_acquire) == kReady, 1)) {
+        return reinterpret_cast<slab::PoolAllocator*>(pool_storage);
+    }
+    return initPool();
+}
+
+void* allocate(std::size_t size) {
+    slab::PoolAllocator* p = pool();
+    void* ptr = p != nullptr ? p->allocate(size) : bootstrapAllocate(size);
+    if (ptr == nullptr) errno = ENOMEM;
+    return ptr;
+}
+
+void* allocateAligned(std::size_t alignment, std::size_t size) {
+    slab::PoolAllocator* p = pool();
+    void* ptr;
+    if (p != nullptr) {
+        ptr = p->allocate(size, alignment);
+    } else if (alignment <= 16) {
+        ptr = bootstrapAllocate(size);
+    } else {
+        ptr = __libc_memalign(alignment, size);   // freed through the foreign path
+    }
+    if (ptr == nullptr) errno = ENOMEM;
+    return ptr;
+}
+
+void deallocate(void* ptr) {
+    if (ptr == nullptr || isBootstrap(ptr)) return;
+    slab::PoolAllocator* p = pool();
+    if (p != nullptr) p->deallocate(ptr);   // foreign pointers reach __libc_free
+    else __libc_free(ptr);
+}
+
+std::size_t usableSize(void* ptr) {
+    if (ptr == nullptr) return 0;
+    if (isBootstrap(ptr)) return bootstrapSize(ptr);
+    slab::PoolAllocator* p = pool();
+    std::size_t size = p != nullptr ? p->usable_size(ptr) : 0;
+    if (size != 0) return size;
+
+    using UsableSizeFn = std::size_t (*)(void*);
+    static UsableSizeFn libc_usable_size =
+        reinterpret_cast<UsableSizeFn>(dlsym(RTLD_NEXT, "malloc_usable_size"));
+    return libc_usable_size != nullptr ? libc_usable_size(ptr) : 0;
+}
+
+void* newImpl(std::size_t size, std::size_t alignment = 0) {
+    for (;;) {
+        void* ptr = alignment == 0 ? allocate(size) : allocateAligned(alignment, size);
+        if (ptr != nullptr) return ptr;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+} // namespace
+
+SLAB_EXPORT void* malloc(std::size_t size) noexcept {
+    return allocate(size);
+}
+
+SLAB_EXPORT void free(void* ptr) noexcept {
+    deallocate(ptr);
+}
+
+SLAB_EXPORT void* calloc(std::size_t count, std::size_t size) noexcept {
+    std::size_t bytes;
+    if (__builtin_mul_overflow(count, size, &bytes)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    void* ptr = allocate(bytes);
+    if (ptr != nullptr) std::memset(ptr, 0, bytes);   // pooled chunks are recycled
+    return ptr;
+}
+
+SLAB_EXPORT void* realloc(void* ptr, std::size_t size) noexcept {
+    if (ptr == nullptr) return allocate(size);
+    if (size == 0) {
+        deallocate(ptr);
+        return nullptr;
+    }
+
+    if (!isBootstrap(ptr)) {
+        slab::PoolAllocator* p = pool();
+        if (p == nullptr || !p->owns(ptr)) return __libc_realloc(ptr, size);   // not ours
+        void* resized = p->reallocate(ptr, size);
+        if (resized == nullptr) errno = ENOMEM;
+        return resized;
+    }
+
+    std::size_t old_size = bootstrapSize(ptr);
+    void* fresh = allocate(size);
+    if (fresh == nullptr) return nullptr;
+    std::memcpy(fresh, ptr, old_size < size ? old_size : size);
+    return fresh;
+}
+
+SLAB_EXPORT int posix_memalign(void** out, std::size_t alignment, std::size_t size) noexcept {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) return EINVAL;
+    void* ptr = allocateAligned(alignment, size);
+    if (ptr == nullptr) return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+
+SLAB_EXPORT void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    return allocateAligned(alignment, size);
+}
+
+SLAB_EXPORT void* memalign(std::size_t alignment, std::size_t size) noexcept {
+    return aligned_alloc(alignment, size);
+}
+
+SLAB_EXPORT void* valloc(std::size_t size) noexcept {
+    return allocateAligned(slab::PageMap::kPageSize, size);
+}
+
+SLAB_EXPORT std::size_t malloc_usable_size(void* ptr) noexcept {
+    return usableSize(ptr);
+}
+
+// Global operator new/delete. Sized deletes ignore the size: a pointer can
+// legitimately reach delete with a different static type than it was
+// allocated with, and a wrong class would corrupt the pool silently.
+
+SLAB_VISIBLE void* operator new(std::size_t size) { return newImpl(size); }
+SLAB_VISIBLE void* operator new[](std::size_t size) { return newImpl(size); }
+SLAB_VISIBLE void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+SLAB_VISIBLE void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+SLAB_VISIBLE void* operator new(std::size_t size, std::align_val_t alignment) {
+    return newImpl(size, static_cast<std::size_t>(alignment));
+}
+SLAB_VISIBLE void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return newImpl(size, static_cast<std::size_t>(alignment));
+}
+SLAB_VISIBLE void* operator new(std::size_t size, std::align_val_t alignment,
+                                                          const std::nothrow_t&) noexcept {
+    return allocateAligned(static_cast<std::size_t>(alignment), size);
+}
+SLAB_VISIBLE void* operator new[](std::size_t size, std::align_val_t alignment,
+                                                            const std::nothrow_t&) noexcept {
+    return allocateAligned(static_cast<std::size_t>(alignment), size);
+}
+
+SLAB_VISIBLE void operator delete(void* ptr) noexcept { deallocate(ptr); }
+SLAB_VISIBLE void operator delete[](void* ptr) noexcept { deallocate(ptr); }
+SLAB_VISIBLE void operator delete(void* ptr, std::size_t) noexcept { deallocate(ptr); }
+SLAB_VISIBLE void operator delete[](void* ptr, std::size_t) noexcept { deallocate(ptr); }
+SLAB_VISIBLE void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    deallocate(ptr);
+}
+SLAB_VISIBLE void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    deallocate(ptr);
+}
+SLAB_VISIBLE void operator delete(void* ptr, std::align_val_t) noexcept {
+    deallocate(ptr);
+}
+SLAB_VISIBLE void operator delete[](void* ptr, std::align_val_t) noexcept {
+    deallocate(ptr);
+}
+SLAB_VISIBLE void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    deallocate(ptr);
+}
+SLAB_VISIBLE void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    deallocate(ptr);
+}
+SLAB_VISIBLE void operator delete(void* ptr, std::align_val_t,
+                                                            const std::nothrow_t&) noexcept {
+    deallocate(ptr);
+}
+SLAB_VISIBLE void operator delete[](void* ptr, std::align_val_t,
+                                                              const std::nothrow_t&) noexcept {
+    deallocate(ptr);
+}
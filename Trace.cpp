@@ -0,0 +1,125 @@
+#include "Trace.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+
+namespace slab {
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'L', 'A', 'B', 'T', 'R', 'C', '1'};
+
+struct TraceHeader {
+    char          magic[8];
+    std::uint32_t record_bytes;
+    std::uint32_t reserved;
+};
+
+inline std::uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000u + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+// write(2) until done; a trace with a hole in it is worse than none
+void writeAll(int fd, const void* data, std::size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = ::write(fd, p, bytes);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        p += n;
+        bytes -= static_cast<std::size_t>(n);
+    }
+}
+
+} // namespace
+
+struct TraceLog::Buffer {
+    static constexpr std::size_t kBytes = std::size_t{64} << 10;
+    static constexpr std::size_t kCapacity = (kBytes - 16) / sizeof(TraceRecord);
+
+    std::uint64_t thread;        // pre-shifted into the high 16 bits
+    std::size_t   count;
+    TraceRecord   records[kCapacity];
+};
+
+static_assert(sizeof(TraceLog::Buffer) <= TraceLog::Buffer::kBytes, "one mapping per buffer");
+
+TraceLog::TraceLog(const char* path) {
+    if (path == nullptr) return;
+    fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) return;
+
+    TraceHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.record_bytes = sizeof(TraceRecord);
+    header.reserved = 0;
+    writeAll(fd_, &header, sizeof(header));
+    pid_ = ::getpid();
+    start_ns_ = monotonicNs();
+}
+
+TraceLog::~TraceLog() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+TraceLog::Buffer* TraceLog::createBuffer() {
+    void* memory = mmap(nullptr, Buffer::kBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    auto* buffer = static_cast<Buffer*>(memory);
+    buffer->thread = static_cast<std::uint64_t>(next_thread_.fetch_add(1, std::memory_order_relaxed) & 0xFFFF) << 48;
+    buffer->count = 0;
+    return buffer;
+}
+
+void TraceLog::releaseBuffer(Buffer* buffer) {
+    if (buffer == nullptr) return;
+    flush(buffer);
+    munmap(buffer, Buffer::kBytes);
+}
+
+void TraceLog::flush(Buffer* buffer) {
+    if (buffer == nullptr || buffer->count == 0) return;
+    if (__builtin_expect(::getpid() == pid_, 1)) {
+        std::lock_guard<std::mutex> guard(write_mutex_);
+        writeAll(fd_, buffer->records, buffer->count * sizeof(TraceRecord));
+    }
+    buffer->count = 0;
+}
+
+void TraceLog::record(Buffer* buffer, TraceOp op, std::size_t size, const void* ptr, std::size_t alignment) {
+    if (buffer == nullptr) return;
+    TraceRecord& record = buffer->records[buffer->count];
+    record.time_thread = ((monotonicNs() - start_ns_) & TraceRecord::kLow48) | buffer->thread;
+    record.id = reinterpret_cast<std::uintptr_t>(ptr);
+    record.size_op = (static_cast<std::uint64_t>(size) & TraceRecord::kLow48) |
+                     static_cast<std::uint64_t>(op) << 48 |
+                     static_cast<std::uint64_t>(__builtin_ctzll(alignment)) << 56;
+    if (++buffer->count == Buffer::kCapacity) flush(buffer);
+}
+
+bool readTrace(const char* path, std::vector<TraceRecord>& records) {
+    std::ifstream in(path, std::ios::binary);
+    TraceHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.record_bytes != sizeof(TraceRecord)) {
+        return false;
+    }
+
+    records.clear();
+    TraceRecord record;
+    while (in.read(reinterpret_cast<char*>(&record), sizeof(record))) records.push_back(record);
+    std::stable_sort(records.begin(), records.end(),
+                     [](const TraceRecord& a, const TraceRecord& b) { return a.time_ns() < b.time_ns(); });
+    return true;
+}
+
+} // namespace slab
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace slab {
+
+enum class TraceOp : std::uint8_t {
+    kAllocate = 1,
+    kFree = 2,
+};
+
+// One event, 24 bytes on disk in host byte order. Fields are packed so a
+// busy service can be traced for hours without the log dominating I/O.
+struct TraceRecord {
+    std::uint64_t time_thread;   // ns since the log opened (low 48 bits) | thread (high 16)
+    std::uint64_t id;            // the pointer; a free names the allocation it releases
+    std::uint64_t size_op;       // size (low 48 bits) | op (8) | log2 of the alignment (8)
+
+    static constexpr std::uint64_t kLow48 = (std::uint64_t{1} << 48) - 1;
+
+    inline std::uint64_t time_ns() const { return time_thread & kLow48; }
+    inline std::uint32_t thread() const { return static_cast<std::uint32_t>(time_thread >> 48); }
+    inline std::size_t   size() const { return static_cast<std::size_t>(size_op & kLow48); }  // 0 for unsized frees
+    inline TraceOp       op() const { return static_cast<TraceOp>((size_op >> 48) & 0xFF); }
+    inline std::size_t   alignment() const { return std::size_t{1} << (size_op >> 56); }  // 1 if none was asked for
+};
+
+static_assert(sizeof(TraceRecord) == 24, "trace records are written as-is");
+
+// Append-only binary event log: a 16-byte header ("SLABTRC1", record size,
+// reserved) followed by records. Each thread fills its own buffer and
+// writes it out whole under the log's lock, so tracing costs a clock read
+// and a 24-byte store per event. Buffers come from mmap and records go out
+// with write(2), so a log can sit under a malloc replacement. Records from
+// different threads interleave out of order; readers sort by time. A child
+// forked from a traced process writes nothing: its buffers still hold the
+// parent's events, and the file is the parent's.
+class TraceLog {
+public:
+    struct Buffer;
+
+    explicit TraceLog(const char* path);   // nullptr: tracing off
+    ~TraceLog();
+
+    inline bool enabled() const { return fd_ >= 0; }
+
+    Buffer* createBuffer();                 // one per thread; nullptr if mmap fails
+    void    releaseBuffer(Buffer* buffer);  // writes out what it holds
+    void    flush(Buffer* buffer);
+    void    record(Buffer* buffer, TraceOp op, std::size_t size, const void* ptr, std::size_t alignment = 1);
+    inline void lock() { write_mutex_.lock(); }     // keeps fork() from copying a write in progress
+    inline void unlock() { write_mutex_.unlock(); }
+
+    TraceLog(const TraceLog&)            = delete;
+    TraceLog& operator=(const TraceLog&) = delete;
+
+private:
+    int                        fd_ = -1;
+    int                        pid_ = 0;          // the process that opened the log
+    std::uint64_t              start_ns_ = 0;
+    std::mutex                 write_mutex_;
+    std::atomic<std::uint32_t> next_thread_{0};
+};
+
+// Every record in a log written by TraceLog, sorted by time. False if the
+// file cannot be read or is not a trace.
+bool readTrace(const char* path, std::vector<TraceRecord>& records);
+
+} // namespace slab
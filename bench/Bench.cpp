@@ -0,0 +1,430 @@
+// Allocator benchmark suite. Every scenario runs against the pool, glibc
+// malloc and, when they can be loaded, a system jemalloc or tcmalloc:
+//
+//     ./bench                         all scenarios, 5 iterations after 1 warm-up
+//     ./bench --filter larson --iterations 10 --seed 7
+//
+// Single-threaded scenarios time every operation and report per-op
+// percentiles over all measured iterations. Multi-threaded scenarios report
+// throughput per iteration (median, min, max). Seeds are fixed, so two runs
+// replay the same operations.
+
+#include "PoolAllocator.hpp"
+#include <dlfcn.h>
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int           iterations = 5;
+    int           warmup = 1;
+    std::uint64_t seed = 42;
+    std::size_t   ops = 500000;     // per iteration; split across threads in threaded scenarios
+    int           threads = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+    std::string   filter;           // substring of scenario names
+    std::string   allocators;       // comma-separated names; empty runs all
+};
+
+// Allocators are called through plain function pointers so that the pool
+// and the dynamically loaded ones pay the same indirect call
+struct Allocator {
+    std::string name;
+    void* (*allocate)(std::size_t size);
+    void  (*deallocate)(void* ptr);
+    bool  thread_safe;
+};
+
+slab::PoolAllocator* shared_pool = nullptr;   // thread-safe: thread caches, remote frees
+slab::PoolAllocator* local_pool = nullptr;    // single-threaded
+
+std::vector<Allocator> loadAllocators(const Options& options) {
+    static slab::PoolAllocator local;
+    static slab::PoolAllocator shared([] {
+        slab::PoolOptions pool_options;
+        pool_options.thread_safe = true;
+        return pool_options;
+    }());
+    local_pool = &local;
+    shared_pool = &shared;
+
+    std::vector<Allocator> all = {
+        {"pool", [](std::size_t size) { return shared_pool->allocate(size); },
+                 [](void* ptr) { shared_pool->deallocate(ptr); }, true},
+        {"pool-st", [](std::size_t size) { return local_pool->allocate(size); },
+                    [](void* ptr) { local_pool->deallocate(ptr); }, false},
+        {"glibc", &std::malloc, &std::free, true},
+    };
+
+    // Loaded privately: the symbols resolve inside the library, so the rest
+    // of the process (and the harness's own containers) stays on glibc
+    struct External { const char* name; const char* libs[3]; const char* malloc_sym; const char* free_sym; };
+    static const External externals[] = {
+        {"jemalloc", {"libjemalloc.so.2", "libjemalloc.so", nullptr}, "malloc", "free"},
+        {"tcmalloc", {"libtcmalloc_minimal.so.4", "libtcmalloc.so.4", "libtcmalloc_minimal.so"}, "tc_malloc", "tc_free"},
+    };
+    for (const External& ext : externals) {
+        for (const char* lib : ext.libs) {
+            if (lib == nullptr) break;
+            void* handle = dlopen(lib, RTLD_NOW | RTLD_LOCAL);
+            if (handle == nullptr) continue;
+            void* alloc_fn = dlsym(handle, ext.malloc_sym);
+            void* free_fn = dlsym(handle, ext.free_sym);
+            if (alloc_fn != nullptr && free_fn != nullptr) {
+                all.push_back({ext.name, reinterpret_cast<void* (*)(std::size_t)>(alloc_fn),
+                               reinterpret_cast<void (*)(void*)>(free_fn), true});
+                break;
+            }
+            dlclose(handle);
+        }
+    }
+
+    if (options.allocators.empty()) return all;
+    std::vector<Allocator> chosen;
+    for (const Allocator& allocator : all) {
+        std::string list = "," + options.allocators + ",";
+        if (list.find("," + allocator.name + ",") != std::string::npos) chosen.push_back(allocator);
+    }
+    return chosen;
+}
+
+using Clock = std::chrono::steady_clock;
+
+inline std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// Cost of the two clock reads around each timed operation, subtracted from
+// every sample: the smallest of many back-to-back pairs
+std::int64_t clockOverheadNs() {
+    std::int64_t best = INT64_MAX;
+    for (int i = 0; i < 10000; ++i) {
+        std::int64_t start = nowNs();
+        best = std::min(best, nowNs() - start);
+    }
+    return best;
+}
+
+// Per-operation samples for one allocator in one scenario, preallocated so
+// recording never allocates while the clock runs
+class Samples {
+public:
+    explicit Samples(std::size_t capacity, std::int64_t overhead) : overhead_(overhead) { ns_.reserve(capacity); }
+
+    template <typename Op>
+    inline void time(Op op) {
+        std::int64_t start = nowNs();
+        op();
+        std::int64_t elapsed = nowNs() - start - overhead_;
+        if (recording_) ns_.push_back(static_cast<std::uint32_t>(std::max<std::int64_t>(elapsed, 0)));
+    }
+
+    void setRecording(bool recording) { recording_ = recording; }
+
+    void report(const std::string& name) {
+        if (ns_.empty()) return;
+        std::sort(ns_.begin(), ns_.end());
+        auto at = [&](double q) { return ns_[std::min(ns_.size() - 1, static_cast<std::size_t>(q * ns_.size()))]; };
+        double mean = 0;
+        for (std::uint32_t ns : ns_) mean += ns;
+        mean /= static_cast<double>(ns_.size());
+        std::cout << "  " << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << mean << std::setw(8) << at(0.5) << std::setw(8) << at(0.99)
+                  << std::setw(8) << at(0.999) << std::setw(10) << ns_.back() << std::endl;
+    }
+
+private:
+    std::vector<std::uint32_t> ns_;
+    std::int64_t overhead_;
+    bool recording_ = true;
+};
+
+// Sizes drawn log-uniformly from 8B to 4KB, with one in fifty from 4KB to
+// 64KB: most requests small, the tail long
+class SizeDistribution {
+public:
+    explicit SizeDistribution(std::uint64_t seed) : gen_(seed) {}
+
+    std::size_t operator()() {
+        std::size_t hi = pick_(gen_) < 0.02 ? 16 : 12;
+        std::size_t lo = hi == 16 ? 12 : 3;
+        double bits = std::uniform_real_distribution<double>(static_cast<double>(lo), static_cast<double>(hi))(gen_);
+        return static_cast<std::size_t>(std::exp2(bits));
+    }
+
+private:
+    std::mt19937_64 gen_;
+    std::uniform_real_distribution<double> pick_{0.0, 1.0};
+};
+
+inline void touch(void* ptr) { *static_cast<volatile char*>(ptr) = 1; }
+
+// --- Single-threaded latency scenarios ----------------------------------
+
+// Allocate 256 objects of one size, then free them, repeatedly
+void fixedSize(const Allocator& a, const Options& options, Samples& samples, std::uint64_t) {
+    constexpr std::size_t kBatch = 256;
+    void* ptrs[kBatch];
+    for (std::size_t done = 0; done < options.ops; done += 2 * kBatch) {
+        for (std::size_t i = 0; i < kBatch; ++i) samples.time([&] { ptrs[i] = a.allocate(64); touch(ptrs[i]); });
+        for (std::size_t i = 0; i < kBatch; ++i) samples.time([&] { a.deallocate(ptrs[i]); });
+    }
+}
+
+// A working set of 10000 objects of random sizes; every step frees a random
+// one and allocates a replacement
+void randomChurn(const Allocator& a, const Options& options, Samples& samples, std::uint64_t seed) {
+    constexpr std::size_t kLive = 10000;
+    SizeDistribution size(seed);
+    std::mt19937_64 gen(seed ^ 0x9E3779B97F4A7C15ull);
+    std::vector<void*> slots(kLive);
+    for (void*& slot : slots) {
+        slot = a.allocate(size());
+        touch(slot);
+    }
+
+    for (std::size_t done = 0; done < options.ops; done += 2) {
+        std::size_t k = gen() % kLive;
+        std::size_t bytes = size();
+        samples.time([&] { a.deallocate(slots[k]); });
+        samples.time([&] { slots[k] = a.allocate(bytes); touch(slots[k]); });
+    }
+    for (void* slot : slots) a.deallocate(slot);
+}
+
+// Nine in ten objects die within 64 steps; the rest live until the end of
+// the iteration, pinning the slabs around them
+void lifetimeMix(const Allocator& a, const Options& options, Samples& samples, std::uint64_t seed) {
+    constexpr std::size_t kShortLived = 64;
+    SizeDistribution size(seed);
+    std::mt19937_64 gen(seed ^ 0xC2B2AE3D27D4EB4Full);
+    void* ring[kShortLived] = {};
+    std::vector<void*> long_lived;
+    long_lived.reserve(options.ops / 8);
+
+    std::size_t step = 0;
+    for (std::size_t done = 0; done < options.ops; ++step) {
+        std::size_t bytes = size();
+        void* ptr = nullptr;
+        samples.time([&] { ptr = a.allocate(bytes); touch(ptr); });
+        ++done;
+        if (gen() % 10 == 0) {
+            long_lived.push_back(ptr);
+            continue;
+        }
+        void*& slot = ring[step % kShortLived];
+        if (slot != nullptr) {
+            samples.time([&] { a.deallocate(slot); });
+            ++done;
+        }
+        slot = ptr;
+    }
+    for (void* ptr : ring) if (ptr != nullptr) a.deallocate(ptr);
+    for (void* ptr : long_lived) samples.time([&] { a.deallocate(ptr); });
+}
+
+// --- Multi-threaded throughput scenarios --------------------------------
+
+// Larson: each thread replaces random objects in an array of 1000, then the
+// arrays rotate between threads, so most frees are of another thread's
+// allocations
+double larson(const Allocator& a, const Options& options, std::uint64_t seed) {
+    constexpr std::size_t kSlots = 1000;
+    constexpr int kRounds = 10;
+    const int threads = options.threads;
+    const std::size_t per_round = options.ops / (static_cast<std::size_t>(threads) * kRounds);
+
+    std::vector<std::vector<void*>> arrays(threads, std::vector<void*>(kSlots));
+    for (auto& array : arrays) {
+        for (void*& slot : array) slot = a.allocate(16);
+    }
+
+    std::barrier sync(threads);
+    auto worker = [&](int t) {
+        std::mt19937_64 gen(seed + t);
+        std::uniform_int_distribution<std::size_t> size(16, 1024);
+        for (int round = 0; round < kRounds; ++round) {
+            std::vector<void*>& array = arrays[(t + round) % threads];
+            for (std::size_t i = 0; i < per_round; ++i) {
+                void*& slot = array[gen() % kSlots];
+                a.deallocate(slot);
+                slot = a.allocate(size(gen));
+                touch(slot);
+            }
+            sync.arrive_and_wait();
+        }
+    };
+
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) pool.emplace_back(worker, t);
+    for (auto& thread : pool) thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (auto& array : arrays) {
+        for (void* slot : array) a.deallocate(slot);
+    }
+    return 2.0 * per_round * kRounds * threads / seconds;
+}
+
+// xmalloc: half the threads allocate batches and post them; the other half
+// free whatever arrives. Every free is remote.
+double xmalloc(const Allocator& a, const Options& options, std::uint64_t seed) {
+    constexpr std::size_t kBatch = 64;
+    const int producers = std::max(1, options.threads / 2);
+    const std::size_t batches = options.ops / (2 * kBatch * producers);
+
+    std::mutex mutex;
+    std::vector<std::vector<void*>> queue;
+    std::atomic<int> producing{producers};
+
+    auto produce = [&](int t) {
+        std::mt19937_64 gen(seed + t);
+        std::uniform_int_distribution<std::size_t> size(8, 512);
+        for (std::size_t b = 0; b < batches; ++b) {
+            std::vector<void*> batch(kBatch);
+            for (void*& ptr : batch) {
+                ptr = a.allocate(size(gen));
+                touch(ptr);
+            }
+            std::lock_guard<std::mutex> guard(mutex);
+            queue.push_back(std::move(batch));
+        }
+        producing.fetch_sub(1, std::memory_order_release);
+    };
+    auto consume = [&] {
+        std::vector<std::vector<void*>> taken;
+        for (;;) {
+            bool done = producing.load(std::memory_order_acquire) == 0;
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                taken.swap(queue);
+            }
+            for (auto& batch : taken) {
+                for (void* ptr : batch) a.deallocate(ptr);
+            }
+            if (taken.empty()) {
+                if (done) return;
+                std::this_thread::yield();
+            }
+            taken.clear();
+        }
+    };
+
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < producers; ++t) pool.emplace_back(produce, t);
+    for (int t = 0; t < std::max(1, options.threads - producers); ++t) pool.emplace_back(consume);
+    for (auto& thread : pool) thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return 2.0 * batches * kBatch * producers / seconds;
+}
+
+using LatencyScenario = void (*)(const Allocator&, const Options&, Samples&, std::uint64_t seed);
+using ThroughputScenario = double (*)(const Allocator&, const Options&, std::uint64_t seed);
+
+bool selected(const Options& options, const char* name) {
+    return options.filter.empty() || std::string(name).find(options.filter) != std::string::npos;
+}
+
+void runLatency(const char* name, const char* description, LatencyScenario scenario,
+                const std::vector<Allocator>& allocators, const Options& options, std::int64_t overhead) {
+    if (!selected(options, name)) return;
+    std::cout << "=== " << name << ": " << description << " ===" << std::endl;
+    std::cout << "  " << std::left << std::setw(10) << "ns/op" << std::right << std::setw(10) << "mean"
+              << std::setw(8) << "p50" << std::setw(8) << "p99" << std::setw(8) << "p99.9" << std::setw(10)
+              << "max" << std::endl;
+
+    for (const Allocator& allocator : allocators) {
+        // Generous: the lifetime mix records each object's free too
+        Samples samples(2 * options.ops * options.iterations + 4096, overhead);
+        for (int i = 0; i < options.warmup + options.iterations; ++i) {
+            samples.setRecording(i >= options.warmup);
+            scenario(allocator, options, samples, options.seed + i);
+        }
+        samples.report(allocator.name);
+    }
+    std::cout << std::endl;
+}
+
+void runThroughput(const char* name, const char* description, ThroughputScenario scenario,
+                   const std::vector<Allocator>& allocators, const Options& options) {
+    if (!selected(options, name)) return;
+    std::cout << "=== " << name << ": " << description << ", " << options.threads << " threads ===" << std::endl;
+    std::cout << "  " << std::left << std::setw(10) << "Mops/s" << std::right << std::setw(10) << "median"
+              << std::setw(10) << "min" << std::setw(10) << "max" << std::endl;
+
+    for (const Allocator& allocator : allocators) {
+        if (!allocator.thread_safe) continue;
+        std::vector<double> runs;
+        for (int i = 0; i < options.warmup + options.iterations; ++i) {
+            double ops = scenario(allocator, options, options.seed + i);
+            if (i >= options.warmup) runs.push_back(ops / 1e6);
+        }
+        std::sort(runs.begin(), runs.end());
+        std::cout << "  " << std::left << std::setw(10) << allocator.name << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(10) << runs[runs.size() / 2] << std::setw(10)
+                  << runs.front() << std::setw(10) << runs.back() << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void usage() {
+    std::cerr << "usage: bench [--iterations N] [--warmup N] [--seed N] [--ops N] [--threads N]\n"
+                 "             [--filter SUBSTRING] [--allocators pool,pool-st,glibc,jemalloc,tcmalloc]\n";
+}
+
+bool parse(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+        if (arg == "--iterations") options.iterations = std::max(1, std::atoi(value));
+        else if (arg == "--warmup") options.warmup = std::max(0, std::atoi(value));
+        else if (arg == "--seed") options.seed = std::strtoull(value, nullptr, 10);
+        else if (arg == "--ops") options.ops = std::max<std::size_t>(1024, std::strtoull(value, nullptr, 10));
+        else if (arg == "--threads") options.threads = std::max(1, std::atoi(value));
+        else if (arg == "--filter") options.filter = value;
+        else if (arg == "--allocators") options.allocators = value;
+        else return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<Allocator> allocators = loadAllocators(options);
+    std::int64_t overhead = clockOverheadNs();
+    std::cout << "allocators:";
+    for (const Allocator& allocator : allocators) std::cout << ' ' << allocator.name;
+    std::cout << "\niterations " << options.iterations << " (+" << options.warmup << " warm-up), seed "
+              << options.seed << ", " << options.ops << " ops per iteration, clock overhead " << overhead
+              << " ns subtracted\n" << std::endl;
+
+    runLatency("fixed-64", "batches of 256 x 64B, allocate then free", &fixedSize, allocators, options, overhead);
+    runLatency("random-churn", "10000 live objects, 8B-64KB, random replacement", &randomChurn, allocators,
+               options, overhead);
+    runLatency("lifetime-mix", "90% short-lived, 10% held to the end", &lifetimeMix, allocators, options, overhead);
+    runThroughput("larson", "1000-slot arrays rotating between threads, 16-1024B", &larson, allocators, options);
+    runThroughput("xmalloc", "producers allocate, consumers free, 8-512B", &xmalloc, allocators, options);
+    return 0;
+}
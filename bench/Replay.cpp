@@ -0,0 +1,296 @@
+// Replays a trace written by PoolOptions::trace_path (or by the malloc
+// shim under SLAB_TRACE) against the pool and against malloc, to evaluate
+// a class table or slab size against recorded traffic:
+//
+//     slab_replay app.trace
+//     slab_replay app.trace --classes 4 --max-size 65536    (geometric, 4 per doubling)
+//     slab_replay app.trace --classes pow2
+//     slab_replay app.trace --classes 24,48,96,200,512
+//
+// Slab::kSlabSize is a compile-time constant: rebuild to compare slab sizes.
+// Events from all threads are replayed in time order on one thread.
+// Each allocator runs in its own forked child so its peak RSS is its own.
+
+#include "PoolAllocator.hpp"
+#include "Trace.hpp"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// A trace event with its pointer id resolved to a dense slot index, so the
+// replay loop indexes an array instead of hashing
+struct Op {
+    std::uint32_t slot;
+    bool          allocate;
+    std::size_t   size;
+    std::size_t   alignment;
+};
+
+struct Workload {
+    std::vector<Op> ops;
+    std::size_t     slots = 0;
+    std::size_t     allocations = 0;
+    std::size_t     unmatched_frees = 0;   // freed before tracing began, or never ours
+    std::size_t     peak_live_bytes = 0;   // requested bytes
+};
+
+Workload prepare(const std::vector<slab::TraceRecord>& records) {
+    Workload work;
+    std::unordered_map<std::uint64_t, std::uint32_t> live;   // id -> slot
+    std::vector<std::size_t> slot_size;
+    std::vector<std::uint32_t> free_slots;
+    std::size_t live_bytes = 0;
+
+    for (const slab::TraceRecord& record : records) {
+        if (record.op() == slab::TraceOp::kAllocate) {
+            if (record.id == 0) continue;   // failed allocation
+            std::uint32_t slot;
+            if (!free_slots.empty()) {
+                slot = free_slots.back();
+                free_slots.pop_back();
+            } else {
+                slot = static_cast<std::uint32_t>(slot_size.size());
+                slot_size.push_back(0);
+            }
+            auto [it, inserted] = live.emplace(record.id, slot);
+            if (!inserted) {
+                // The address came back without a free we saw: the old
+                // object is leaked in the replay, as it was in the trace
+                it->second = slot;
+            }
+            slot_size[slot] = record.size();
+            live_bytes += record.size();
+            work.peak_live_bytes = std::max(work.peak_live_bytes, live_bytes);
+            work.ops.push_back({slot, true, record.size(), record.alignment()});
+            ++work.allocations;
+        } else {
+            auto it = live.find(record.id);
+            if (it == live.end()) {
+                ++work.unmatched_frees;
+                continue;
+            }
+            std::uint32_t slot = it->second;
+            live.erase(it);
+            live_bytes -= slot_size[slot];
+            free_slots.push_back(slot);
+            work.ops.push_back({slot, false, 0, 1});
+        }
+    }
+    work.slots = slot_size.size();
+    return work;
+}
+
+// Write one byte per page, as the traced program would have used the memory
+inline void touchPages(void* ptr, std::size_t size) {
+    char* p = static_cast<char*>(ptr);
+    for (std::size_t offset = 0; offset < size; offset += 4096) p[offset] = 1;
+    if (size > 0) p[size - 1] = 1;
+}
+
+template <typename Alloc, typename Free>
+double replaySeconds(const Workload& work, std::vector<void*>& slots, Alloc alloc, Free dealloc) {
+    auto start = std::chrono::steady_clock::now();
+    for (const Op& op : work.ops) {
+        if (op.allocate) {
+            void* ptr = alloc(op.size, op.alignment);
+            touchPages(ptr, op.size);
+            slots[op.slot] = ptr;
+        } else {
+            dealloc(slots[op.slot]);
+            slots[op.slot] = nullptr;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (void*& ptr : slots) {
+        if (ptr != nullptr) dealloc(ptr);
+        ptr = nullptr;
+    }
+    return seconds;
+}
+
+std::size_t residentBytes() {
+    long pages = 0, resident = 0;
+    if (FILE* f = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(f);
+    }
+    return static_cast<std::size_t>(resident) * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+struct Result {
+    double      ops_per_sec;
+    std::size_t peak_rss_growth;
+    std::size_t peak_mapped = 0;       // pool only
+    double      rounding = 0;          // pool only: internal_fragmentation()
+};
+
+void printResult(const char* name, const Workload& work, const Result& result) {
+    double overhead = work.peak_live_bytes > 0
+                          ? static_cast<double>(result.peak_rss_growth) / static_cast<double>(work.peak_live_bytes) - 1.0
+                          : 0.0;
+    std::cout << "  " << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << result.ops_per_sec / 1e6 << std::setw(14) << result.peak_rss_growth / 1024
+              << std::setw(11) << std::setprecision(1) << 100.0 * overhead << "%";
+    if (result.peak_mapped != 0) {
+        std::cout << "   (mapped peak " << result.peak_mapped / 1024 << " KB, rounding " << 100.0 * result.rounding
+                  << "%)";
+    }
+    std::cout << std::endl;
+}
+
+// Runs body in a child process and prints its result: each allocator's
+// heap starts empty and its peak RSS is not inherited from the others
+template <typename Body>
+void inChild(const char* name, const Workload& work, Body body) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        Result result = body();
+        printResult(name, work, result);
+        std::cout.flush();
+        std::_Exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) std::cout << "  " << name << ": replay failed" << std::endl;
+}
+
+template <typename Alloc, typename Free>
+Result measure(const Workload& work, int iterations, Alloc alloc, Free dealloc) {
+    std::vector<void*> slots(work.slots, nullptr);
+    std::size_t before = residentBytes();
+    std::vector<double> runs;
+    runs.push_back(replaySeconds(work, slots, alloc, dealloc));
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::size_t peak = static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+
+    for (int i = 1; i < iterations; ++i) runs.push_back(replaySeconds(work, slots, alloc, dealloc));
+    std::sort(runs.begin(), runs.end());
+    return {static_cast<double>(work.ops.size()) / runs[runs.size() / 2], peak > before ? peak - before : 0};
+}
+
+slab::SizeClassMap parseClasses(const std::string& spec, std::size_t max_size) {
+    if (spec == "pow2") return slab::SizeClassMap::powersOfTwo(max_size);
+    if (spec.find(',') == std::string::npos) {
+        return slab::SizeClassMap::geometric(max_size, std::max<std::size_t>(1, std::strtoull(spec.c_str(), nullptr, 10)));
+    }
+    std::vector<std::size_t> sizes;
+    for (std::size_t pos = 0; pos < spec.size();) {
+        std::size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        sizes.push_back(std::strtoull(spec.substr(pos, comma - pos).c_str(), nullptr, 10));
+        pos = comma + 1;
+    }
+    return slab::SizeClassMap(sizes);
+}
+
+void usage() {
+    std::cerr << "usage: slab_replay TRACE [--classes N|pow2|S1,S2,...] [--max-size BYTES] [--iterations N]\n"
+                 "  --classes N      geometric table, N classes per doubling (default 4)\n"
+                 "  --max-size       largest class for geometric/pow2 tables (default 32768)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    const char* path = argv[1];
+    std::string classes = "4";
+    std::size_t max_size = 32768;
+    int iterations = 5;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--classes") classes = value;
+        else if (arg == "--max-size") max_size = std::strtoull(value, nullptr, 10);
+        else if (arg == "--iterations") iterations = std::max(1, std::atoi(value));
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    std::vector<slab::TraceRecord> records;
+    if (!slab::readTrace(path, records)) {
+        std::cerr << "slab_replay: " << path << " is not a readable trace" << std::endl;
+        return 1;
+    }
+    Workload work = prepare(records);
+    records.clear();
+    records.shrink_to_fit();
+
+    slab::PoolOptions options;
+    options.size_classes = parseClasses(classes, max_size);
+
+    std::cout << path << ": " << work.ops.size() << " events, " << work.allocations << " allocations, "
+              << work.unmatched_frees << " unmatched frees, peak live " << work.peak_live_bytes / 1024 << " KB\n"
+              << "classes: " << options.size_classes.count() << " up to " << options.size_classes.maxSize()
+              << " bytes, slabs of " << slab::Slab::kSlabSize << " bytes, median of " << iterations
+              << " replays\n\n"
+              << "  " << std::left << std::setw(8) << "" << std::right << std::setw(10) << "Mops/s" << std::setw(14)
+              << "peak RSS KB" << std::setw(12) << "over live" << std::endl;
+
+    inChild("pool", work, [&] {
+        Result result{};
+        std::vector<double> runs;
+        slab::PoolStats stats;
+        // A fresh pool per replay, so every run starts from an empty heap
+        std::unique_ptr<slab::PoolAllocator> pool;
+        auto alloc = [&](std::size_t size, std::size_t alignment) { return pool->allocate(size, alignment); };
+        auto dealloc = [&](void* ptr) { pool->deallocate(ptr); };
+        std::vector<void*> slots(work.slots, nullptr);
+
+        std::size_t before = residentBytes();
+        for (int i = 0; i < iterations; ++i) {
+            pool = std::make_unique<slab::PoolAllocator>(options);
+            runs.push_back(replaySeconds(work, slots, alloc, dealloc));
+            if (i == 0) {
+                rusage usage;
+                getrusage(RUSAGE_SELF, &usage);
+                std::size_t peak = static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+                result.peak_rss_growth = peak > before ? peak - before : 0;
+                stats = pool->stats();
+            }
+            pool.reset();
+        }
+        std::sort(runs.begin(), runs.end());
+        result.ops_per_sec = static_cast<double>(work.ops.size()) / runs[runs.size() / 2];
+        result.peak_mapped = stats.peak_mapped_bytes;
+        result.rounding = stats.internal_fragmentation();
+        return result;
+    });
+
+    inChild("malloc", work, [&] {
+        return measure(work, iterations,
+            [](std::size_t size, std::size_t alignment) {
+                if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+                void* ptr = nullptr;
+                return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
+            },
+            [](void* ptr) { std::free(ptr); });
+    });
+    return 0;
+}
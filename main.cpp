@@ -2,8 +2,35 @@
 #include <vector>
 #include <chrono>
 #include <random>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <map>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Slab.hpp"
 #include "PoolAllocator.hpp"
+#include "PoolResource.hpp"
+#include "ObjectPool.hpp"
+#include "BitmapSlab.hpp"
+#include "HandlePool.hpp"
+#include "Region.hpp"
+#include "SharedPool.hpp"
 
 void testSlab() {
     std::cout << "=== Testing Slab Allocator ===" << std::endl;
@@ -63,251 +90,1143 @@ void testPoolAllocator() {
     std::cout << std::endl;
 }
 
-void testSlabDirect() {
-    std::cout << "=== Testing Slab Direct ===" << std::endl;
-    
-    // Test 1: Single slab performance
-    slab::Slab slab(64);
-    std::vector<void*> ptrs;
-    
-    auto start = std::chrono::high_resolution_clock::now();
-    
-    for (int i = 0; i < 10000; ++i) {
-        void* ptr = slab.allocate();
-        if (ptr) ptrs.push_back(ptr);
+void freeLatencyScaling() {
+    std::cout << "=== Free Latency vs Slab Count ===" << std::endl;
+
+    // 64-byte chunks: Slab::kSlabSize / 64 objects fill one slab
+    constexpr std::size_t kChunk = 64;
+    constexpr std::size_t kPerSlab = slab::Slab::kSlabSize / kChunk;
+    constexpr std::size_t kSamples = 10000;
+
+    std::mt19937 gen(42);
+
+    for (std::size_t slab_count : {1u, 10u, 100u, 1000u, 10000u, 100000u}) {
+        slab::PoolAllocator allocator;
+        std::vector<void*> ptrs;
+        ptrs.reserve(slab_count * kPerSlab);
+
+        // Written once, like a real object, so page faults are not part of the timing
+        for (std::size_t i = 0; i < slab_count * kPerSlab; ++i) {
+            ptrs.push_back(allocator.allocate(kChunk));
+            *static_cast<char*>(ptrs.back()) = 1;
+        }
+
+        // Free a random sample so lookups hit slabs all over the pool
+        std::shuffle(ptrs.begin(), ptrs.end(), gen);
+        std::size_t samples = std::min(kSamples, ptrs.size());
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < samples; ++i) {
+            allocator.deallocate(ptrs[i]);
+        }
+        auto end = std::chrono::steady_clock::now();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+        std::cout << "  " << slab_count << " slabs: " << samples << " frees, "
+                  << static_cast<double>(ns) / samples << " ns/free" << std::endl;
     }
-    
-    for (void* ptr : ptrs) {
-        slab.deallocate(ptr);
+    std::cout << std::endl;
+}
+
+// Each thread allocates batches and hands them to the next thread, which
+// frees them: every free is of a chunk allocated on another thread.
+template <typename Alloc, typename Free>
+double producerConsumerOpsPerSec(int threads, Alloc alloc, Free dealloc) {
+    constexpr int kRounds = 2000;
+    constexpr int kBatch = 64;
+
+    struct Mailbox {
+        std::mutex mutex;
+        std::vector<std::vector<void*>> batches;
+    };
+    std::vector<Mailbox> mailboxes(threads);
+
+    auto worker = [&](int t) {
+        Mailbox& inbox = mailboxes[t];
+        Mailbox& outbox = mailboxes[(t + 1) % threads];
+        std::vector<std::vector<void*>> received;
+
+        for (int round = 0; round < kRounds; ++round) {
+            std::vector<void*> batch;
+            batch.reserve(kBatch);
+            for (int i = 0; i < kBatch; ++i) {
+                std::size_t size = 16 + (i % 8) * 16;
+                void* ptr = alloc(size);
+                *static_cast<char*>(ptr) = static_cast<char>(i);
+                batch.push_back(ptr);
+            }
+            {
+                std::lock_guard<std::mutex> guard(outbox.mutex);
+                outbox.batches.push_back(std::move(batch));
+            }
+            {
+                std::lock_guard<std::mutex> guard(inbox.mutex);
+                received.swap(inbox.batches);
+            }
+            for (auto& b : received) {
+                for (void* ptr : b) dealloc(ptr);
+            }
+            received.clear();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) pool.emplace_back(worker, t);
+    for (auto& th : pool) th.join();
+    auto end = std::chrono::steady_clock::now();
+
+    // Whatever was still in flight when the workers stopped
+    for (auto& box : mailboxes) {
+        for (auto& b : box.batches) {
+            for (void* ptr : b) dealloc(ptr);
+        }
     }
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
-    std::cout << "Single Slab: " << 10000 << " allocations/deallocations in " 
-              << duration.count() << " microseconds" << std::endl;
-    
-    // Test 2: Multiple slabs for different sizes
-    std::cout << "\nTest 2: Multiple slabs for different sizes..." << std::endl;
-    
-    slab::Slab slab8(8);
-    slab::Slab slab16(16);
-    slab::Slab slab32(32);
-    slab::Slab slab64(64);
-    
-    std::vector<void*> ptrs8, ptrs16, ptrs32, ptrs64;
-    
-    start = std::chrono::high_resolution_clock::now();
-    
-    for (int i = 0; i < 2500; ++i) {
-        void* ptr8 = slab8.allocate();
-        void* ptr16 = slab16.allocate();
-        void* ptr32 = slab32.allocate();
-        void* ptr64 = slab64.allocate();
-        
-        if (ptr8) ptrs8.push_back(ptr8);
-        if (ptr16) ptrs16.push_back(ptr16);
-        if (ptr32) ptrs32.push_back(ptr32);
-        if (ptr64) ptrs64.push_back(ptr64);
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return 2.0 * threads * kRounds * kBatch / seconds;
+}
+
+void concurrentScaling() {
+    std::cout << "=== Multi-threaded Producer/Consumer (Mops/s) ===" << std::endl;
+
+    int max_threads = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        slab::PoolOptions options;
+        options.thread_safe = true;
+        slab::PoolAllocator cached(options);
+        double cached_ops = producerConsumerOpsPerSec(threads,
+            [&](std::size_t size) { return cached.allocate(size); },
+            [&](void* ptr) { cached.deallocate(ptr); });
+
+        slab::PoolAllocator plain;
+        std::mutex plain_mutex;
+        double locked_ops = producerConsumerOpsPerSec(threads,
+            [&](std::size_t size) { std::lock_guard<std::mutex> g(plain_mutex); return plain.allocate(size); },
+            [&](void* ptr) { std::lock_guard<std::mutex> g(plain_mutex); plain.deallocate(ptr); });
+
+        double malloc_ops = producerConsumerOpsPerSec(threads,
+            [](std::size_t size) { return malloc(size); },
+            [](void* ptr) { free(ptr); });
+
+        std::cout << "  " << threads << " threads: thread-cached pool " << cached_ops / 1e6
+                  << ", mutex-wrapped pool " << locked_ops / 1e6
+                  << ", malloc " << malloc_ops / 1e6 << std::endl;
     }
-    
-    for (void* ptr : ptrs8) slab8.deallocate(ptr);
-    for (void* ptr : ptrs16) slab16.deallocate(ptr);
-    for (void* ptr : ptrs32) slab32.deallocate(ptr);
-    for (void* ptr : ptrs64) slab64.deallocate(ptr);
-    
-    end = std::chrono::high_resolution_clock::now();
-    duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
-    std::cout << "Multiple Slabs: " << 10000 << " allocations/deallocations in " 
-              << duration.count() << " microseconds" << std::endl;
-    
-    // Test 3: Compare with malloc for same pattern
-    std::cout << "\nTest 3: Malloc comparison..." << std::endl;
-    
-    std::vector<void*> malloc_ptrs;
-    start = std::chrono::high_resolution_clock::now();
-    
-    for (int i = 0; i < 10000; ++i) {
-        std::size_t size = 8 + (i % 4) * 8;  // 8, 16, 24, 32 bytes
-        void* ptr = malloc(size);
-        malloc_ptrs.push_back(ptr);
+    std::cout << std::endl;
+}
+
+// Memory held per live requested byte for a given class table. A pool that
+// only ever allocates fills its slabs in order, so the footprint of each
+// class is its slab count times its slab size.
+double slabBytesPerLiveByte(const slab::SizeClassMap& map, const std::vector<std::size_t>& sizes,
+                            double& rounding_overhead) {
+    std::vector<std::size_t> per_class(map.count(), 0);
+    std::size_t requested = 0;
+    std::size_t rounded = 0;
+    for (std::size_t size : sizes) {
+        std::size_t cls = map.classIndex(size);
+        ++per_class[cls];
+        requested += size;
+        rounded += map.classSize(cls);
     }
-    
-    for (void* ptr : malloc_ptrs) {
-        free(ptr);
+
+    std::size_t footprint = 0;
+    for (std::size_t cls = 0; cls < map.count(); ++cls) {
+        std::size_t per_slab = map.slabBytes(cls) / map.classSize(cls);
+        footprint += (per_class[cls] + per_slab - 1) / per_slab * map.slabBytes(cls);
     }
-    
-    end = std::chrono::high_resolution_clock::now();
-    duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
-    std::cout << "Malloc: " << 10000 << " allocations/deallocations in " 
-              << duration.count() << " microseconds" << std::endl;
-    
 
+    rounding_overhead = static_cast<double>(rounded - requested) / rounded;
+    return static_cast<double>(footprint) / requested;
 }
 
-void performanceTest() {
-    std::cout << "=== Performance Test ===" << std::endl;
-    
-    slab::PoolAllocator slab_allocator;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    
-    const int num_allocations = 10000;
-    std::vector<void*> ptrs;
-    ptrs.reserve(num_allocations);
-    
-    // Test 1: Many small allocations of same size (slab allocator's strength)
-    std::cout << "Test 1: Many small allocations (8-64 bytes)..." << std::endl;
-    
-    auto start = std::chrono::high_resolution_clock::now();
-    
-    for (int i = 0; i < num_allocations; ++i) {
-        std::size_t size = 8 + (i % 4) * 8;  
-        void* ptr = slab_allocator.allocate(size);
-        ptrs.push_back(ptr);
+void fragmentationReport() {
+    std::cout << "=== Size-Class Fragmentation (200k live objects, log-normal sizes) ===" << std::endl;
+
+    // Median ~55 bytes with a long tail, clipped to the pooled range
+    std::mt19937 gen(42);
+    std::lognormal_distribution<double> dist(4.0, 0.9);
+    std::vector<std::size_t> sizes;
+    for (int i = 0; i < 200000; ++i) {
+        sizes.push_back(std::clamp<std::size_t>(static_cast<std::size_t>(dist(gen)), 1, 1024));
     }
-    
-    for (void* ptr : ptrs) {
-        slab_allocator.deallocate(ptr);
+
+    struct Table { const char* name; slab::SizeClassMap map; };
+    for (const Table& table : {Table{"powers of two", slab::SizeClassMap::powersOfTwo(1024)},
+                               Table{"4 per doubling", slab::SizeClassMap::geometric(1024)}}) {
+        // The pool itself, to confirm every size is served from the table
+        slab::PoolOptions options;
+        options.size_classes = table.map;
+        slab::PoolAllocator allocator(options);
+        std::vector<void*> ptrs;
+        for (std::size_t size : sizes) ptrs.push_back(allocator.allocate(size));
+        for (void* ptr : ptrs) allocator.deallocate(ptr);
+
+        double rounding = 0;
+        double per_byte = slabBytesPerLiveByte(table.map, sizes, rounding);
+        std::cout << "  " << table.name << " (" << table.map.count() << " classes): "
+                  << per_byte << " slab bytes per live byte, "
+                  << rounding * 100 << "% of each chunk lost to rounding" << std::endl;
     }
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
-    std::cout << "Slab allocator: " << num_allocations << " small allocations in " 
-              << duration.count() << " microseconds" << std::endl;
-    
-    // Test malloc with same pattern
-    ptrs.clear();
-    start = std::chrono::high_resolution_clock::now();
-    
-    for (int i = 0; i < num_allocations; ++i) {
-        std::size_t size = 8 + (i % 4) * 8;
-        void* ptr = malloc(size);
-        ptrs.push_back(ptr);
+    std::cout << std::endl;
+}
+
+std::size_t residentBytes() {
+    long pages = 0, resident = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(statm);
     }
-    
-    for (void* ptr : ptrs) {
-        free(ptr);
+    return static_cast<std::size_t>(resident) * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// A long-running process in miniature: the live set repeatedly grows to a
+// peak, is cut back to a quarter at random, and churns there. Reported
+// after each churn phase: slabs held, resident memory the pool added, and
+// the share of slab bytes holding live data.
+void slabSelectionChurn() {
+    std::cout << "=== Slab Selection under Churn (400k peak, 100k trough, mixed sizes) ===" << std::endl;
+
+    constexpr std::size_t kPeak = 400000;
+    constexpr std::size_t kTrough = 100000;
+    constexpr std::size_t kChurnOps = 1000000;
+    constexpr std::size_t kSizes[] = {24, 48, 64, 96, 128, 200, 256};
+
+    struct Object { void* ptr; std::size_t size; };
+    std::vector<Object> live(kPeak);   // touched up front, so resident growth is the pool's
+    struct Policy { const char* name; slab::SlabSelection selection; };
+    for (const Policy& policy : {Policy{"first fit    ", slab::SlabSelection::kFirstFit},
+                                 Policy{"most occupied", slab::SlabSelection::kMostOccupied}}) {
+        std::size_t baseline = residentBytes();
+        slab::PoolOptions options;
+        options.slab_selection = policy.selection;
+        auto* allocator = new slab::PoolAllocator(options);
+        std::mt19937 gen(5);
+        std::uniform_int_distribution<std::size_t> pick_size(0, std::size(kSizes) - 1);
+        live.clear();
+        std::size_t live_bytes = 0;
+        auto add = [&] {
+            std::size_t size = kSizes[pick_size(gen)];
+            live.push_back({allocator->allocate(size), size});
+            live_bytes += size;
+        };
+        auto removeRandom = [&] {
+            std::size_t i = std::uniform_int_distribution<std::size_t>(0, live.size() - 1)(gen);
+            allocator->deallocate(live[i].ptr, live[i].size);
+            live_bytes -= live[i].size;
+            live[i] = live.back();
+            live.pop_back();
+        };
+
+        std::cout << "  " << policy.name << ":";
+        auto start = std::chrono::steady_clock::now();
+        for (int cycle = 0; cycle < 4; ++cycle) {
+            while (live.size() < kPeak) add();
+            while (live.size() > kTrough) removeRandom();
+            for (std::size_t op = 0; op < kChurnOps; ++op) {
+                removeRandom();
+                add();
+            }
+
+            slab::PoolStats stats = allocator->stats();
+            std::size_t slabs = 0, slab_bytes = 0;
+            for (std::size_t cls = 0; cls < stats.class_count; ++cls) {
+                slabs += stats.classes[cls].slabs;
+                slab_bytes += stats.classes[cls].slabs * stats.classes[cls].slab_bytes;
+            }
+            std::cout << (cycle == 0 ? " " : " | ") << slabs << " slabs, "
+                      << (residentBytes() - baseline) / 1000000.0 << "MB, "
+                      << 100.0 * static_cast<double>(live_bytes) / static_cast<double>(slab_bytes) << "% used";
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << " (" << seconds << " s)" << std::endl;
+        for (const Object& object : live) allocator->deallocate(object.ptr);
+        delete allocator;
     }
-    
-    end = std::chrono::high_resolution_clock::now();
-    duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
-    std::cout << "Standard malloc/free: " << num_allocations << " small allocations in " 
-              << duration.count() << " microseconds" << std::endl;
-    
-    // Test 2: Frequent allocate/deallocate cycles (memory reuse)
-    std::cout << "\nTest 2: Frequent allocate/deallocate cycles..." << std::endl;
-    
-    ptrs.clear();
-    start = std::chrono::high_resolution_clock::now();
-    
-    for (int cycle = 0; cycle < 100; ++cycle) {
-        // Allocate a batch
-        for (int i = 0; i < 100; ++i) {
-            std::size_t size = 16 + (i % 3) * 16;  // 16, 32, 48 bytes
-            void* ptr = slab_allocator.allocate(size);
-            ptrs.push_back(ptr);
+    std::cout << std::endl;
+}
+
+void steadyStateAllocLatency() {
+    std::cout << "=== Steady-State Alloc Latency vs Slab Count ===" << std::endl;
+
+    constexpr std::size_t kChunk = 64;
+    constexpr std::size_t kPerSlab = slab::Slab::kSlabSize / kChunk;
+    constexpr std::size_t kOps = 200000;
+
+    for (std::size_t slab_count : {10u, 100u, 1000u, 10000u}) {
+        slab::PoolAllocator allocator;
+        std::vector<void*> live;
+        live.reserve(slab_count * kPerSlab);
+        for (std::size_t i = 0; i < slab_count * kPerSlab; ++i) {
+            live.push_back(allocator.allocate(kChunk));
+            *static_cast<char*>(live.back()) = 1;
         }
-        
-        // Deallocate the batch
-        for (void* ptr : ptrs) {
-            slab_allocator.deallocate(ptr);
+
+        // Replace random objects: every free punches a hole in some slab
+        // and the next allocation has to find a slab with room
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<std::size_t> pick(0, live.size() - 1);
+        std::vector<std::size_t> victims(kOps);
+        for (auto& v : victims) v = pick(gen);
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t v : victims) {
+            allocator.deallocate(live[v]);
+            live[v] = allocator.allocate(kChunk);
         }
-        ptrs.clear();
+        auto end = std::chrono::steady_clock::now();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+        std::cout << "  " << slab_count << " slabs: "
+                  << static_cast<double>(ns) / kOps << " ns per free+alloc" << std::endl;
+
+        for (void* ptr : live) allocator.deallocate(ptr);
     }
-    
-    end = std::chrono::high_resolution_clock::now();
-    duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
-    std::cout << "Slab allocator: " << 10000 << " allocate/deallocate cycles in " 
-              << duration.count() << " microseconds" << std::endl;
-    
-    // Test malloc with same pattern
-    ptrs.clear();
-    start = std::chrono::high_resolution_clock::now();
-    
-    for (int cycle = 0; cycle < 100; ++cycle) {
-        // Allocate a batch
-        for (int i = 0; i < 100; ++i) {
-            std::size_t size = 16 + (i % 3) * 16;
-            void* ptr = malloc(size);
-            ptrs.push_back(ptr);
+    std::cout << std::endl;
+}
+
+void slabCreationCost() {
+    std::cout << "=== Slab Creation Cost (one object per slab) ===" << std::endl;
+
+    // A lightly used class: every slab is created and serves a single
+    // object, so the cost is whatever the constructor does up front
+    constexpr std::size_t kSlabs = 2000;
+
+    for (std::size_t chunk : {8u, 64u, 512u}) {
+        std::vector<slab::Slab*> slabs;
+        slabs.reserve(kSlabs);
+
+        rusage before{}, after{};
+        getrusage(RUSAGE_SELF, &before);
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < kSlabs; ++i) {
+            slab::Slab* s = new slab::Slab(chunk);
+            *static_cast<char*>(s->allocate()) = 1;
+            slabs.push_back(s);
         }
-        
-        // Deallocate the batch
-        for (void* ptr : ptrs) {
-            free(ptr);
+        auto end = std::chrono::steady_clock::now();
+        getrusage(RUSAGE_SELF, &after);
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+        std::cout << "  " << chunk << "-byte chunks: "
+                  << static_cast<double>(ns) / kSlabs << " ns per slab, "
+                  << static_cast<double>(after.ru_minflt - before.ru_minflt) / kSlabs
+                  << " page faults per slab" << std::endl;
+
+        for (slab::Slab* s : slabs) delete s;
+    }
+    std::cout << std::endl;
+}
+
+template <typename Body>
+double nsPerObject(std::size_t objects, Body body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) / objects;
+}
+
+void bulkVsLoop() {
+    std::cout << "=== Bulk vs Per-Object Allocate/Free (batches of 256 x 64B) ===" << std::endl;
+
+    constexpr std::size_t kBatch = 256;
+    constexpr std::size_t kRounds = 4000;
+    constexpr std::size_t kObjects = kBatch * kRounds;
+
+    for (bool thread_safe : {false, true}) {
+        slab::PoolOptions options;
+        options.thread_safe = thread_safe;
+        slab::PoolAllocator allocator(options);
+        void* ptrs[kBatch];
+
+        double loop = nsPerObject(kObjects, [&] {
+            for (std::size_t r = 0; r < kRounds; ++r) {
+                for (std::size_t i = 0; i < kBatch; ++i) ptrs[i] = allocator.allocate(64);
+                for (std::size_t i = 0; i < kBatch; ++i) allocator.deallocate(ptrs[i]);
+            }
+        });
+        double bulk = nsPerObject(kObjects, [&] {
+            for (std::size_t r = 0; r < kRounds; ++r) {
+                allocator.allocate_bulk(64, kBatch, ptrs);
+                allocator.deallocate_bulk(ptrs, kBatch);
+            }
+        });
+        double sized = nsPerObject(kObjects, [&] {
+            for (std::size_t r = 0; r < kRounds; ++r) {
+                allocator.allocate_bulk(64, kBatch, ptrs);
+                allocator.deallocate_bulk(ptrs, kBatch, 64);
+            }
+        });
+
+        std::cout << "  " << (thread_safe ? "thread-safe: " : "single-threaded: ")
+                  << loop << " ns loop, " << bulk << " ns bulk, "
+                  << sized << " ns sized bulk (per object)" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void sizedVsUnsizedFree() {
+    std::cout << "=== Sized vs Unsized Free (1M x 64B) ===" << std::endl;
+
+    constexpr std::size_t kObjects = 1000000;
+    std::vector<void*> ptrs(kObjects);
+
+    for (bool thread_safe : {false, true}) {
+        for (bool shuffled : {false, true}) {
+            double ns[2];
+            for (bool sized : {false, true}) {
+                slab::PoolOptions options;
+                options.thread_safe = thread_safe;
+                slab::PoolAllocator allocator(options);
+                for (auto& ptr : ptrs) ptr = allocator.allocate(64);
+                if (shuffled) {
+                    std::mt19937 gen(42);
+                    std::shuffle(ptrs.begin(), ptrs.end(), gen);
+                }
+                ns[sized] = nsPerObject(kObjects, [&] {
+                    if (sized) {
+                        for (void* ptr : ptrs) allocator.deallocate(ptr, 64);
+                    } else {
+                        for (void* ptr : ptrs) allocator.deallocate(ptr);
+                    }
+                });
+            }
+
+            std::cout << "  " << (thread_safe ? "thread-safe" : "single-threaded")
+                      << (shuffled ? ", shuffled: " : ", in order: ")
+                      << ns[0] << " ns unsized, " << ns[1] << " ns sized (per free)" << std::endl;
         }
-        ptrs.clear();
     }
-    
-    end = std::chrono::high_resolution_clock::now();
-    duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
-    std::cout << "Standard malloc/free: " << 10000 << " allocate/deallocate cycles in " 
-              << duration.count() << " microseconds" << std::endl;
-    
-    // Test 3: Mixed sizes but optimized for slab strengths
-    std::cout << "\nTest 3: Mixed sizes (slab-optimized)..." << std::endl;
-    
-    ptrs.clear();
-    start = std::chrono::high_resolution_clock::now();
-    
-    for (int i = 0; i < num_allocations; ++i) {
-        std::size_t size;
-        if (i % 10 < 7) {
-            size = 8 + (i % 8) * 8; 
-        } else if (i % 10 < 9) {
-            size = 128 + (i % 4) * 128;  
-        } else {
-            size = 1024 + (i % 4) * 1024;  
+    std::cout << std::endl;
+}
+
+void statsOverhead() {
+    std::cout << "=== Statistics Overhead (alloc/free pairs, 64B, batches of 256) ===" << std::endl;
+
+    constexpr std::size_t kBatch = 256;
+    constexpr std::size_t kRounds = 1000;
+    constexpr std::size_t kObjects = kBatch * kRounds;
+
+    for (bool thread_safe : {false, true}) {
+        std::unique_ptr<slab::PoolAllocator> pools[2];
+        for (bool collect : {false, true}) {
+            slab::PoolOptions options;
+            options.thread_safe = thread_safe;
+            options.collect_stats = collect;
+            pools[collect] = std::make_unique<slab::PoolAllocator>(options);
         }
-        
-        void* ptr = slab_allocator.allocate(size);
-        ptrs.push_back(ptr);
+
+        // Best of many runs, alternating between the two pools, to keep
+        // scheduler and frequency noise out of a small difference
+        double ns[2] = {1e9, 1e9};
+        void* ptrs[kBatch];
+        for (int run = 0; run < 50; ++run) {
+            for (bool collect : {false, true}) {
+                slab::PoolAllocator& allocator = *pools[collect];
+                ns[collect] = std::min(ns[collect], nsPerObject(kObjects, [&] {
+                    for (std::size_t r = 0; r < kRounds; ++r) {
+                        for (std::size_t i = 0; i < kBatch; ++i) ptrs[i] = allocator.allocate(64);
+                        for (std::size_t i = 0; i < kBatch; ++i) allocator.deallocate(ptrs[i]);
+                    }
+                }));
+            }
+        }
+        if (!thread_safe) pools[1]->stats().write_text(std::cout);
+
+        std::cout << "  " << (thread_safe ? "thread-safe: " : "single-threaded: ")
+                  << ns[0] << " ns without, " << ns[1] << " ns with stats ("
+                  << 100.0 * (ns[1] - ns[0]) / ns[0] << "%)" << std::endl;
     }
-    
-    for (void* ptr : ptrs) {
-        slab_allocator.deallocate(ptr);
+    std::cout << std::endl;
+}
+
+void profilingOverhead() {
+    std::cout << "=== Heap Profiling Overhead (alloc/free pairs, 64B, batches of 256) ===" << std::endl;
+
+    constexpr std::size_t kBatch = 256;
+    constexpr std::size_t kRounds = 4000;
+    constexpr std::size_t kObjects = kBatch * kRounds;
+
+    for (bool thread_safe : {false, true}) {
+        std::cout << "  " << (thread_safe ? "thread-safe:" : "single-threaded:");
+        for (std::size_t sample_bytes : {std::size_t{0}, std::size_t{512} << 10, std::size_t{16} << 10}) {
+            slab::PoolOptions options;
+            options.thread_safe = thread_safe;
+            options.profile_sample_bytes = sample_bytes;
+            slab::PoolAllocator allocator(options);
+            void* ptrs[kBatch];
+
+            double ns = 1e9;
+            for (int run = 0; run < 3; ++run) {
+                ns = std::min(ns, nsPerObject(kObjects, [&] {
+                    for (std::size_t r = 0; r < kRounds; ++r) {
+                        for (std::size_t i = 0; i < kBatch; ++i) ptrs[i] = allocator.allocate(64);
+                        for (std::size_t i = 0; i < kBatch; ++i) allocator.deallocate(ptrs[i]);
+                    }
+                }));
+            }
+            if (sample_bytes == 0) std::cout << " " << ns << " ns off";
+            else std::cout << ", " << ns << " ns sampling every " << (sample_bytes >> 10) << "KB";
+        }
+        std::cout << std::endl;
     }
-    
-    end = std::chrono::high_resolution_clock::now();
-    duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
-    std::cout << "Slab allocator: " << num_allocations << " mixed allocations in " 
-              << duration.count() << " microseconds" << std::endl;
-    
-    // Test malloc with same pattern
-    ptrs.clear();
-    start = std::chrono::high_resolution_clock::now();
-    
-    for (int i = 0; i < num_allocations; ++i) {
-        std::size_t size;
-        if (i % 10 < 7) {
-            size = 8 + (i % 8) * 8;
-        } else if (i % 10 < 9) {
-            size = 128 + (i % 4) * 128;
-        } else {
-            size = 1024 + (i % 4) * 1024;
+    std::cout << std::endl;
+}
+
+// One size: fill and drain a runtime Slab and a FixedSlab of the same
+// bytes, then a PoolAllocator class and a FixedPool, a slab's worth at a
+// time so neither pool maps or unmaps inside the loop
+template <std::size_t ChunkSize>
+void fixedVsRuntime() {
+    using Fixed = slab::FixedSlab<ChunkSize>;
+    constexpr std::size_t kRounds = 200;
+    constexpr std::size_t kBatch = Fixed::kChunks;
+    constexpr std::size_t kPoolRounds = 512000 / kBatch;
+
+    void* memory = slab::mapAligned(slab::Slab::kSlabSize, slab::Slab::kSlabSize);
+    slab::Slab runtime(ChunkSize, memory, slab::Slab::kSlabSize);
+    std::size_t runtime_chunks = slab::Slab::kSlabSize / ChunkSize;
+    std::vector<void*> ptrs(runtime_chunks);
+    double slab_ns = nsPerObject(2 * kRounds * runtime_chunks, [&] {
+        for (std::size_t r = 0; r < kRounds; ++r) {
+            for (void*& ptr : ptrs) {
+                ptr = runtime.allocate();
+                *static_cast<char*>(ptr) = 1;
+            }
+            for (void* ptr : ptrs) runtime.deallocate(ptr);
         }
-        
-        void* ptr = malloc(size);
-        ptrs.push_back(ptr);
+    });
+    munmap(memory, slab::Slab::kSlabSize);
+
+    Fixed* fixed = Fixed::create();
+    ptrs.resize(Fixed::kChunks);
+    double fixed_ns = nsPerObject(2 * kRounds * Fixed::kChunks, [&] {
+        for (std::size_t r = 0; r < kRounds; ++r) {
+            for (void*& ptr : ptrs) {
+                ptr = fixed->allocate();
+                *static_cast<char*>(ptr) = 1;
+            }
+            for (void* ptr : ptrs) fixed->deallocate(ptr);
+        }
+    });
+    Fixed::destroy(fixed);
+
+    void* batch[kBatch];
+    slab::PoolAllocator pool;
+    double pool_ns = nsPerObject(2 * kPoolRounds * kBatch, [&] {
+        for (std::size_t r = 0; r < kPoolRounds; ++r) {
+            for (void*& ptr : batch) {
+                ptr = pool.allocate(ChunkSize);
+                *static_cast<char*>(ptr) = 1;
+            }
+            for (void* ptr : batch) pool.deallocate(ptr);
+        }
+    });
+
+    slab::FixedPool<ChunkSize> fixed_pool;
+    double fixed_pool_ns = nsPerObject(2 * kPoolRounds * kBatch, [&] {
+        for (std::size_t r = 0; r < kPoolRounds; ++r) {
+            for (void*& ptr : batch) {
+                ptr = fixed_pool.allocate();
+                *static_cast<char*>(ptr) = 1;
+            }
+            for (void* ptr : batch) fixed_pool.deallocate(ptr);
+        }
+    });
+
+    std::cout << "  " << ChunkSize << "B: Slab " << slab_ns << " ns, FixedSlab " << fixed_ns
+              << " ns; PoolAllocator " << pool_ns << " ns, FixedPool " << fixed_pool_ns << " ns" << std::endl;
+}
+
+void fixedSlabBenchmarks() {
+    std::cout << "=== Runtime vs Compile-time Slabs (ns per alloc or free) ===" << std::endl;
+    (fixedVsRuntime<16>(), fixedVsRuntime<32>(), fixedVsRuntime<48>(), fixedVsRuntime<64>(),
+     fixedVsRuntime<96>(), fixedVsRuntime<128>(), fixedVsRuntime<256>(), fixedVsRuntime<512>(),
+     fixedVsRuntime<1024>(), fixedVsRuntime<2048>());
+    std::cout << std::endl;
+}
+
+// Fill, free in random order, refill: the refill is where the two differ,
+// the free list popping the most recently freed chunk and the bitmap
+// searching for the lowest one
+template <std::size_t ChunkSize>
+void bitmapVsFreeList() {
+    constexpr std::size_t kBytes = std::size_t{1} << 16;
+    constexpr std::size_t kChunks = kBytes / ChunkSize;
+    constexpr std::size_t kRounds = 100;
+    std::vector<std::size_t> order(kChunks);
+    for (std::size_t i = 0; i < kChunks; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(7));
+    std::vector<void*> ptrs(kChunks);
+
+    auto churn = [&](auto allocate, auto deallocate) {
+        for (void*& ptr : ptrs) ptr = allocate();
+        return nsPerObject(2 * kRounds * kChunks, [&] {
+            for (std::size_t r = 0; r < kRounds; ++r) {
+                for (std::size_t i : order) deallocate(ptrs[i]);
+                for (void*& ptr : ptrs) {
+                    ptr = allocate();
+                    *static_cast<char*>(ptr) = 1;
+                }
+            }
+        });
+    };
+
+    void* memory = slab::mapAligned(kBytes, kBytes);
+    slab::Slab list(ChunkSize, memory, kBytes);
+    double list_ns = churn([&] { return list.allocate(); }, [&](void* ptr) { list.deallocate(ptr); });
+    munmap(memory, kBytes);
+
+    slab::BitmapSlab bitmap(ChunkSize, kBytes);
+    double bitmap_ns = churn([&] { return bitmap.allocate(); }, [&](void* ptr) { bitmap.deallocate(ptr); });
+
+    std::cout << "  " << ChunkSize << "B: free list " << list_ns << " ns, bitmap " << bitmap_ns << " ns" << std::endl;
+}
+
+void bitmapSlabBenchmarks() {
+    std::cout << "=== Free List vs Bitmap Slab, random-order frees (ns per alloc or free) ===" << std::endl;
+    bitmapVsFreeList<8>();
+    bitmapVsFreeList<16>();
+    bitmapVsFreeList<64>();
+    bitmapVsFreeList<256>();
+    std::cout << std::endl;
+}
+
+// A million 32-byte objects left by churn (twice as many created, a random
+// half destroyed), reached through 8-byte pointers into a PoolAllocator or
+// 4-byte handles into a HandlePool: lookups in random order, then a pass
+// over every live object
+void handleBenchmarks() {
+    std::cout << "=== Pointers vs Handles (1M live 32B objects, ns per object) ===" << std::endl;
+
+    struct Particle {
+        float position[4];
+        float velocity[4];
+    };
+    constexpr std::size_t kLive = 1000000;
+    std::mt19937 gen(11);
+    std::vector<std::size_t> order(kLive);
+    for (std::size_t i = 0; i < kLive; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), gen);
+    std::vector<bool> keep(2 * kLive, false);
+    for (std::size_t i = 0; i < kLive; ++i) keep[i] = true;
+    std::shuffle(keep.begin(), keep.end(), gen);
+
+    float sum = 0;
+    slab::PoolAllocator allocator;
+    std::vector<Particle*> pointers;
+    std::vector<Particle*> dropped;
+    for (std::size_t i = 0; i < 2 * kLive; ++i) {
+        auto* particle = new (allocator.allocate(sizeof(Particle))) Particle{{1, 0, 0, 0}, {0, 0, 0, 0}};
+        (keep[i] ? pointers : dropped).push_back(particle);
     }
-    
-    for (void* ptr : ptrs) {
-        free(ptr);
+    for (Particle* particle : dropped) allocator.deallocate(particle, sizeof(Particle));
+    double pointer_lookup = nsPerObject(kLive, [&] {
+        for (std::size_t i : order) sum += pointers[i]->position[0];
+    });
+    double pointer_scan = nsPerObject(kLive, [&] {
+        for (Particle* particle : pointers) sum += particle->position[0];
+    });
+
+    using Handles = slab::HandlePool<Particle>;
+    Handles pool;
+    std::vector<Handles::Handle> handles;
+    std::vector<Handles::Handle> destroyed;
+    for (std::size_t i = 0; i < 2 * kLive; ++i) {
+        Handles::Handle handle = pool.create(Particle{{1, 0, 0, 0}, {0, 0, 0, 0}});
+        (keep[i] ? handles : destroyed).push_back(handle);
     }
-    
-    end = std::chrono::high_resolution_clock::now();
-    duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
-    std::cout << "Standard malloc/free: " << num_allocations << " mixed allocations in " 
-              << duration.count() << " microseconds" << std::endl;
+    for (Handles::Handle handle : destroyed) pool.destroy(handle);
+    double handle_lookup = nsPerObject(kLive, [&] {
+        for (std::size_t i : order) sum += pool.get(handles[i])->position[0];
+    });
+    double handle_scan = nsPerObject(kLive, [&] {
+        for (const Particle& particle : pool) sum += particle.position[0];
+    });
+    if (sum == 42) std::cout << "";  // keep the loads
+
+    std::cout << "  pointers: " << pointer_lookup << " ns random lookup, " << pointer_scan << " ns scan, "
+              << pointers.size() * sizeof(Particle*) / 1000000 << "MB of references" << std::endl;
+    std::cout << "  handles:  " << handle_lookup << " ns random lookup, " << handle_scan << " ns scan, "
+              << handles.size() * sizeof(Handles::Handle) / 1000000 << "MB of references" << std::endl;
+    std::cout << std::endl;
+}
+
+// Random insert/erase over a fixed key space, so the container hovers
+// around half full and every operation allocates or frees one node
+template <typename Map>
+double containerChurn(Map& map) {
+    constexpr std::size_t kOps = 1000000;
+    constexpr int kKeys = 200000;
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> key(0, kKeys - 1);
+
+    return nsPerObject(kOps, [&] {
+        for (std::size_t i = 0; i < kOps; ++i) {
+            int k = key(gen);
+            auto it = map.find(k);
+            if (it == map.end()) map.emplace(k, k);
+            else map.erase(it);
+        }
+    });
+}
+
+void containerBenchmarks() {
+    std::cout << "=== Container Churn (1M random insert/erase, ns per op) ===" << std::endl;
+
+    using Node = std::pair<const int, int>;
+    {
+        std::map<int, int> standard;
+        slab::PoolAllocator pool;
+        std::map<int, int, std::less<int>, slab::PoolStlAllocator<Node>> pooled{slab::PoolStlAllocator<Node>(pool)};
+        slab::PoolAllocator pmr_pool;
+        slab::PoolMemoryResource resource(pmr_pool);
+        std::pmr::map<int, int> pmr(&resource);
+
+        std::cout << "  std::map: " << containerChurn(standard) << " default, "
+                  << containerChurn(pooled) << " PoolStlAllocator, "
+                  << containerChurn(pmr) << " PoolMemoryResource" << std::endl;
+    }
+    {
+        std::unordered_map<int, int> standard;
+        slab::PoolAllocator pool;
+        std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, slab::PoolStlAllocator<Node>> pooled(
+            0, std::hash<int>{}, std::equal_to<int>{}, slab::PoolStlAllocator<Node>(pool));
+        slab::PoolAllocator pmr_pool;
+        slab::PoolMemoryResource resource(pmr_pool);
+        std::pmr::unordered_map<int, int> pmr(&resource);
+
+        std::cout << "  std::unordered_map: " << containerChurn(standard) << " default, "
+                  << containerChurn(pooled) << " PoolStlAllocator, "
+                  << containerChurn(pmr) << " PoolMemoryResource" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+double readObjects(const std::vector<void*>& objects, std::size_t bytes) {
+    constexpr int kPasses = 3;
+    std::uint64_t sum = 0;
+    double ns = nsPerObject(objects.size() * kPasses, [&] {
+        for (int pass = 0; pass < kPasses; ++pass) {
+            for (void* ptr : objects) {
+                std::uint64_t words[8];
+                std::memcpy(words, ptr, bytes);
+                for (std::uint64_t w : words) sum += w;
+            }
+        }
+    });
+    if (sum == 42) std::cout << "";  // keep the loads
+    return ns;
+}
+
+void alignmentBenchmarks() {
+    std::cout << "=== Alignment: 64-byte objects ===" << std::endl;
+
+    // Split loads: the same 64-byte reads, visited in random order, from
+    // cache-line aligned chunks and from a 72-byte class where 7 of every 8
+    // objects straddle two lines (what 8/16-byte aligned placement gives)
+    constexpr std::size_t kObjects = std::size_t{1} << 20;  // 64MB: every visit misses cache
+    std::mt19937 gen(42);
+    {
+        slab::PoolAllocator aligned_pool;
+        slab::PoolOptions options;
+        options.size_classes = slab::SizeClassMap({72});
+        slab::PoolAllocator packed_pool(options);
+
+        std::vector<void*> aligned, packed;
+        for (std::size_t i = 0; i < kObjects; ++i) {
+            aligned.push_back(aligned_pool.allocate(64, 64));
+            packed.push_back(packed_pool.allocate(64));
+            std::memset(aligned.back(), 1, 64);
+            std::memset(packed.back(), 1, 64);
+        }
+        std::shuffle(aligned.begin(), aligned.end(), gen);
+        std::shuffle(packed.begin(), packed.end(), gen);
+
+        std::cout << "  random 64B reads: " << readObjects(aligned, 64) << " ns aligned, "
+                  << readObjects(packed, 64) << " ns line-straddling (per object)" << std::endl;
+
+        for (void* ptr : aligned) aligned_pool.deallocate(ptr, 64, 64);
+        for (void* ptr : packed) packed_pool.deallocate(ptr);
+    }
+
+    // False sharing: two threads bump counters in neighbouring 32-byte
+    // objects, either packed into one line or each on its own line
+    {
+        static constexpr std::size_t kIncrements = 20000000;
+        slab::PoolOptions options;
+        options.thread_safe = true;
+        slab::PoolAllocator allocator(options);
+
+        auto run = [&](void* a, void* b) {
+            auto* x = static_cast<std::atomic<std::uint64_t>*>(a);
+            auto* y = static_cast<std::atomic<std::uint64_t>*>(b);
+            return nsPerObject(kIncrements, [&] {
+                auto bump = [](std::atomic<std::uint64_t>* counter) {
+                    for (std::size_t i = 0; i < kIncrements; ++i) counter->fetch_add(1, std::memory_order_relaxed);
+                };
+                std::thread t1(bump, x);
+                std::thread t2(bump, y);
+                t1.join();
+                t2.join();
+            });
+        };
+
+        void* shared_line = allocator.allocate(64, 64);
+        void* own_a = allocator.allocate(32, 64);
+        void* own_b = allocator.allocate(32, 64);
+        double packed = run(shared_line, static_cast<char*>(shared_line) + 32);
+        double separate = run(own_a, own_b);
+        std::cout << "  2 threads, neighbouring counters: " << packed << " ns same line, "
+                  << separate << " ns separate lines (per increment pair, "
+                  << std::thread::hardware_concurrency() << " cpus)" << std::endl;
+
+        allocator.deallocate(shared_line);
+        allocator.deallocate(own_a);
+        allocator.deallocate(own_b);
+    }
+    std::cout << std::endl;
+}
+
+void growingBuffers() {
+    std::cout << "=== Growing buffers: appends of 1-64 bytes up to a final size ===" << std::endl;
+
+    // A builder appending small pieces, resizing to the exact length it
+    // needs each time; the last variant asks usable_size() for its capacity
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<std::size_t> piece_dist(1, 64);
+    std::vector<std::size_t> pieces(1 << 16);
+    for (std::size_t& piece : pieces) piece = piece_dist(gen);
+    char source[64];
+    std::memset(source, 'x', sizeof(source));
+
+    slab::PoolAllocator pool;
+    for (std::size_t final_size : {std::size_t{1} << 10, std::size_t{64} << 10, std::size_t{4} << 20}) {
+        std::size_t appends = 0;
+        auto build = [&](auto resize) {
+            char* buffer = nullptr;
+            std::size_t length = 0, capacity = 0;
+            for (std::size_t i = 0; length < final_size; ++i) {
+                std::size_t piece = pieces[i % pieces.size()];
+                if (length + piece > capacity) buffer = static_cast<char*>(resize(buffer, length, length + piece, capacity));
+                std::memcpy(buffer + length, source, piece);
+                length += piece;
+                ++appends;
+            }
+            return buffer;
+        };
+
+        const std::size_t rounds = (std::size_t{16} << 20) / final_size;
+        auto run = [&](auto resize, auto release) {
+            appends = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t r = 0; r < rounds; ++r) release(build(resize));
+            auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            return elapsed / static_cast<double>(appends);
+        };
+        auto pool_free = [&](char* buffer) { pool.deallocate(buffer); };
+
+        double copied = run([&](void* old, std::size_t length, std::size_t size, std::size_t& capacity) {
+            void* fresh = pool.allocate(size);
+            if (old != nullptr) std::memcpy(fresh, old, length);
+            pool.deallocate(old);
+            capacity = size;
+            return fresh;
+        }, pool_free);
+        double exact = run([&](void* old, std::size_t, std::size_t size, std::size_t& capacity) {
+            capacity = size;
+            return pool.reallocate(old, size);
+        }, pool_free);
+        double slack = run([&](void* old, std::size_t, std::size_t size, std::size_t& capacity) {
+            void* resized = pool.reallocate(old, size);
+            capacity = pool.usable_size(resized);
+            return resized;
+        }, pool_free);
+        double glibc = run([&](void* old, std::size_t, std::size_t size, std::size_t& capacity) {
+            capacity = size;
+            return std::realloc(old, size);
+        }, [](char* buffer) { std::free(buffer); });
+
+        std::cout << "  to " << final_size / 1024 << "KB: " << copied << " ns allocate+copy+free, " << exact
+                  << " ns reallocate, " << slack << " ns reallocate + usable_size, " << glibc
+                  << " ns glibc realloc (per append)" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void regionBenchmarks() {
+    std::cout << "=== Per-request memory: Region vs reset() vs individual frees ===" << std::endl;
+
+    // Each request makes 200 allocations of 16-256 bytes, writes to them
+    // and then lets everything go at once
+    constexpr std::size_t kPerRequest = 200;
+    constexpr std::size_t kRequests = 20000;
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<std::size_t> size_dist(16, 256);
+    std::vector<std::size_t> sizes(kPerRequest);
+    for (std::size_t& size : sizes) size = size_dist(gen);
+
+    slab::PoolAllocator pool;
+    std::vector<void*> ptrs(kPerRequest);
+    auto fill = [&](auto allocate) {
+        for (std::size_t i = 0; i < kPerRequest; ++i) {
+            ptrs[i] = allocate(sizes[i]);
+            std::memset(ptrs[i], 0, 16);
+        }
+    };
+
+    double freed = nsPerObject(kRequests * kPerRequest, [&] {
+        for (std::size_t r = 0; r < kRequests; ++r) {
+            fill([&](std::size_t size) { return pool.allocate(size); });
+            for (std::size_t i = 0; i < kPerRequest; ++i) pool.deallocate(ptrs[i], sizes[i]);
+        }
+    });
+    double reset = nsPerObject(kRequests * kPerRequest, [&] {
+        for (std::size_t r = 0; r < kRequests; ++r) {
+            fill([&](std::size_t size) { return pool.allocate(size); });
+            pool.reset();
+        }
+    });
+    slab::Region region(pool);
+    double scoped = nsPerObject(kRequests * kPerRequest, [&] {
+        for (std::size_t r = 0; r < kRequests; ++r) {
+            slab::Region::Scope scope(region);
+            fill([&](std::size_t size) { return region.allocate(size); });
+        }
+    });
+
+    std::cout << "  " << kPerRequest << " objects per request: " << freed << " ns freed one by one, "
+              << reset << " ns with reset(), " << scoped << " ns in a Region scope (per object, release included)"
+              << std::endl << std::endl;
+}
+
+// dTLB load misses of this thread, user space only; unavailable (and
+// reported as such) where perf_event_paranoid or a sandbox forbids it
+class DtlbMisses {
+public:
+    DtlbMisses() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~DtlbMisses() {
+        if (fd_ >= 0) close(fd_);
+    }
+    bool available() const { return fd_ >= 0; }
+    void start() {
+        if (fd_ < 0) return;
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    std::uint64_t stop() {
+        std::uint64_t count = 0;
+        if (fd_ < 0) return 0;
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd_, &count, sizeof(count)) != sizeof(count)) count = 0;
+        return count;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+void arenaBenchmarks() {
+    std::cout << "=== Slab Arena: random access over a large working set ===" << std::endl;
+
+    // Four interleaved classes, about 180MB live: far more pages than the
+    // TLB covers. Objects are visited in random order, then a quarter of
+    // them are freed and reallocated, and visited again.
+    constexpr std::size_t kObjects = std::size_t{1} << 20;
+    constexpr std::size_t kVisits = std::size_t{4} << 20;
+    constexpr std::size_t kSizes[] = {48, 96, 192, 384};
+
+    struct Config {
+        const char*     name;
+        std::size_t     arena_bytes;
+        slab::HugePages huge_pages;
+    };
+    const Config configs[] = {
+        {"mmap per slab", 0, slab::HugePages::kNone},
+        {"arena, 4KB pages", std::size_t{64} << 20, slab::HugePages::kNone},
+        {"arena, transparent huge", std::size_t{64} << 20, slab::HugePages::kTransparent},
+        {"arena, explicit huge", std::size_t{64} << 20, slab::HugePages::kExplicit},   // transparent if none reserved
+    };
+
+    DtlbMisses counter;
+    if (!counter.available()) std::cout << "  (dTLB counters unavailable here: wall-clock only)" << std::endl;
+
+    for (const Config& config : configs) {
+        slab::PoolOptions options;
+        options.arena_bytes = config.arena_bytes;
+        options.huge_pages = config.huge_pages;
+        slab::PoolAllocator allocator(options);
+
+        std::vector<void*> objects(kObjects);
+        double fill_ns = nsPerObject(kObjects, [&] {
+            for (std::size_t i = 0; i < kObjects; ++i) {
+                objects[i] = allocator.allocate(kSizes[i % 4]);
+                std::memset(objects[i], 1, 16);
+            }
+        });
+
+        std::mt19937_64 gen(42);
+        std::vector<std::uint32_t> order(kVisits);
+        for (std::uint32_t& index : order) index = static_cast<std::uint32_t>(gen() % kObjects);
+
+        std::uint64_t sum = 0;
+        auto visit = [&] {
+            for (std::uint32_t index : order) {
+                auto* words = static_cast<std::uint64_t*>(objects[index]);
+                sum += words[0];
+                words[1] = sum;
+            }
+        };
+        counter.start();
+        double visit_ns = nsPerObject(kVisits, visit);
+        std::uint64_t misses = counter.stop();
+
+        for (std::size_t i = 0; i < kObjects; i += 4) {
+            std::size_t victim = gen() % kObjects;
+            allocator.deallocate(objects[victim]);
+            objects[victim] = allocator.allocate(kSizes[victim % 4]);
+            std::memset(objects[victim], 1, 16);
+        }
+        double churned_ns = nsPerObject(kVisits, visit);
+        if (sum == 42) std::cout << "";  // keep the loads
+
+        std::cout << "  " << config.name << ": fill " << fill_ns << " ns/object, visit " << visit_ns
+                  << " ns, after churn " << churned_ns << " ns";
+        if (counter.available()) std::cout << ", " << static_cast<double>(misses) / kVisits << " dTLB misses/visit";
+        std::cout << std::endl;
+
+        for (void* ptr : objects) allocator.deallocate(ptr);
+    }
+    std::cout << std::endl;
+}
+
+// One process produces messages and another reads each of them. Through a
+// pipe every byte is copied into the kernel and out again; through a
+// SharedPool only the message's 8-byte offset crosses, and the reader
+// frees the message where the writer left it.
+void sharedMemoryMessaging() {
+    std::cout << "=== Messages between Processes: Pipe Copy vs SharedPool Offset (ns per message) ===" << std::endl;
+
+    auto writeAll = [](int fd, const void* data, std::size_t bytes) {
+        const char* cursor = static_cast<const char*>(data);
+        while (bytes != 0) {
+            ssize_t written = write(fd, cursor, bytes);
+            if (written <= 0) _exit(1);
+            cursor += written;
+            bytes -= static_cast<std::size_t>(written);
+        }
+    };
+    // Forks a writer that runs produce(fd) twice. The reader's consume(fd)
+    // takes one round at a time and is timed on the second, once both
+    // processes have faulted in their pages. pipe_bytes != 0 resizes the pipe.
+    auto run = [](int pipe_bytes, auto produce, auto consume) {
+        int fds[2];
+        if (pipe(fds) != 0) throw std::runtime_error("pipe failed");
+        if (pipe_bytes != 0) fcntl(fds[1], F_SETPIPE_SZ, pipe_bytes);
+        pid_t child = fork();
+        if (child < 0) throw std::runtime_error("fork failed");
+        if (child == 0) {
+            close(fds[0]);
+            produce(fds[1]);
+            produce(fds[1]);
+            _exit(0);
+        }
+        close(fds[1]);
+        consume(fds[0]);
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t checksum = consume(fds[0]);
+        auto end = std::chrono::steady_clock::now();
+        close(fds[0]);
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) throw std::runtime_error("writer process failed");
+        return std::pair(std::chrono::duration<double, std::nano>(end - start).count(), checksum);
+    };
+
+    std::string name = "/slab_demo_" + std::to_string(getpid());
+    slab::SharedPool::unlink(name.c_str());
+    slab::SharedPool pool(name.c_str(), std::size_t{256} << 20);   // room for a full pipe of the largest messages
+    if (!pool.valid()) throw std::runtime_error("shm_open failed");
+
+    for (std::size_t size : {64, 1024, 16384}) {
+        std::size_t messages = std::min<std::size_t>(200000, (std::size_t{512} << 20) / size);
+
+        auto [pipe_ns, pipe_sum] = run(0,
+            [&](int fd) {
+                std::vector<unsigned char> message(size);
+                for (std::size_t i = 0; i < messages; ++i) {
+                    std::memset(message.data(), static_cast<int>(i), size);
+                    writeAll(fd, message.data(), size);
+                }
+            },
+            [&](int fd) {
+                std::vector<unsigned char> buffer(64 << 10);
+                std::uint64_t sum = 0;
+                for (std::size_t remaining = messages * size; remaining != 0;) {
+                    ssize_t got = read(fd, buffer.data(), std::min(buffer.size(), remaining));
+                    if (got <= 0) throw std::runtime_error("pipe closed early");
+                    for (ssize_t i = 0; i < got; ++i) sum += buffer[i];
+                    remaining -= static_cast<std::size_t>(got);
+                }
+                return sum;
+            });
+
+        // A one-page pipe holds 512 offsets: without that bound the writer
+        // runs a default pipe's 8192 messages ahead, and the reader finds
+        // them evicted from cache
+        auto [offset_ns, offset_sum] = run(4096,
+            [&](int fd) {
+                // A mapping of its own, as an unrelated process would have
+                slab::SharedPool writer(name.c_str());
+                if (!writer.valid()) _exit(1);
+                for (std::size_t i = 0; i < messages; ++i) {
+                    slab::SharedPool::Offset offset;
+                    while ((offset = writer.allocate(size)) == slab::SharedPool::kNull) sched_yield();
+                    std::memset(writer.at(offset), static_cast<int>(i), size);
+                    writeAll(fd, &offset, sizeof(offset));
+                }
+            },
+            [&](int fd) {
+                slab::SharedPool::Offset offsets[512];
+                std::uint64_t sum = 0;
+                std::size_t partial = 0;   // bytes of an offset cut off by the last read
+                for (std::size_t remaining = messages; remaining != 0;) {
+                    std::size_t want = std::min(sizeof(offsets), remaining * sizeof(slab::SharedPool::Offset)) - partial;
+                    ssize_t got = read(fd, reinterpret_cast<char*>(offsets) + partial, want);
+                    if (got <= 0) throw std::runtime_error("pipe closed early");
+                    std::size_t bytes = partial + static_cast<std::size_t>(got);
+                    std::size_t count = bytes / sizeof(slab::SharedPool::Offset);
+                    for (std::size_t m = 0; m < count; ++m) {
+                        const auto* message = static_cast<const unsigned char*>(pool.at(offsets[m]));
+                        for (std::size_t i = 0; i < size; ++i) sum += message[i];
+                        pool.deallocate(offsets[m]);
+                    }
+                    partial = bytes - count * sizeof(slab::SharedPool::Offset);
+                    std::memmove(offsets, offsets + count, partial);
+                    remaining -= count;
+                }
+                return sum;
+            });
+
+        if (pipe_sum != offset_sum) throw std::runtime_error("messages arrived corrupted");
+        double pipe_per = pipe_ns / static_cast<double>(messages);
+        double offset_per = offset_ns / static_cast<double>(messages);
+        std::cout << "  " << size << "B x " << messages << ": pipe copy " << pipe_per << ", offset " << offset_per
+                  << " (" << pipe_per / offset_per << "x)" << std::endl;
+    }
+    slab::SharedPool::unlink(name.c_str());
     std::cout << std::endl;
 }
 
@@ -318,8 +1237,25 @@ int main() {
     try {
         testSlab();
         testPoolAllocator();
-        testSlabDirect();
-        performanceTest();
+        slabCreationCost();
+        freeLatencyScaling();
+        steadyStateAllocLatency();
+        bulkVsLoop();
+        sizedVsUnsizedFree();
+        statsOverhead();
+        profilingOverhead();
+        containerBenchmarks();
+        alignmentBenchmarks();
+        fixedSlabBenchmarks();
+        bitmapSlabBenchmarks();
+        handleBenchmarks();
+        growingBuffers();
+        regionBenchmarks();
+        arenaBenchmarks();
+        concurrentScaling();
+        fragmentationReport();
+        slabSelectionChurn();
+        sharedMemoryMessaging();
         
         std::cout << "All tests completed successfully!" << std::endl;
     } catch (const std::exception& e) {
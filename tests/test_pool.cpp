@@ -2,9 +2,40 @@
 #include <catch2/catch_approx.hpp>
 
 #include "Slab.hpp"
+#include "PageMap.hpp"
+#include "SizeClasses.hpp"
 #include "PoolAllocator.hpp"
+#include "PoolResource.hpp"
+#include "ObjectPool.hpp"
+#include "BitmapSlab.hpp"
+#include "HandlePool.hpp"
+#include "Arena.hpp"
+#include "Numa.hpp"
+#include "Region.hpp"
+#include "SharedPool.hpp"
 #include <vector>
 #include <random>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <map>
+#include <utility>
+#include <unordered_map>
+#include <string>
+#include <sstream>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <bit>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 TEST_CASE("Single-slab basic allocate/free", "[slab]") {
     constexpr std::size_t kChunk = 64;
@@ -133,4 +164,1781 @@ TEST_CASE("PoolAllocator reset functionality", "[pool_allocator]") {
 
     allocator.deallocate(p3);
     allocator.deallocate(p4);
-} 
\ No newline at end of file
+} 
+TEST_CASE("PageMap resolves every page of a registered range", "[page_map]") {
+    slab::PageMap map;
+    slab::Slab slab{64};
+
+    REQUIRE(map.get(slab.memory()) == nullptr);
+
+    map.set(slab.memory(), slab::Slab::kSlabSize, &slab);
+    char* base = static_cast<char*>(slab.memory());
+    REQUIRE(map.get(base) == &slab);
+    REQUIRE(map.get(base + slab::Slab::kSlabSize / 2) == &slab);
+    REQUIRE(map.get(base + slab::Slab::kSlabSize - 1) == &slab);
+    REQUIRE(map.get(base + slab::Slab::kSlabSize) == nullptr);
+
+    map.clear(slab.memory(), slab::Slab::kSlabSize);
+    REQUIRE(map.get(base) == nullptr);
+}
+
+TEST_CASE("PoolAllocator frees across many slabs", "[pool_allocator]") {
+    slab::PoolAllocator allocator;
+    std::vector<void*> ptrs;
+
+    // Enough 64-byte objects to span dozens of slabs
+    for (int i = 0; i < 20000; ++i) {
+        void* ptr = allocator.allocate(64);
+        REQUIRE(ptr != nullptr);
+        ptrs.push_back(ptr);
+    }
+
+    for (void* ptr : ptrs) {
+        allocator.deallocate(ptr);
+    }
+
+    // Freed chunks are back in their slabs, so the same addresses are reused
+    void* again = allocator.allocate(64);
+    REQUIRE(std::find(ptrs.begin(), ptrs.end(), again) != ptrs.end());
+    allocator.deallocate(again);
+}
+
+TEST_CASE("Thread-safe PoolAllocator with cross-thread frees", "[pool_allocator][threads]") {
+    slab::PoolOptions options;
+    options.thread_safe = true;
+    slab::PoolAllocator allocator(options);
+
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 20000;
+    std::vector<std::vector<void*>> produced(kThreads);
+
+    // Each thread allocates and stamps its objects...
+    std::vector<std::thread> workers;
+    for (int t = 0; t < kThreads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < kPerThread; ++i) {
+                std::size_t size = 8 + (i % 128) * 8;
+                auto* p = static_cast<unsigned char*>(allocator.allocate(size));
+                std::memset(p, t, size);
+                produced[t].push_back(p);
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    workers.clear();
+
+    // ...and its neighbour frees them, exercising the remote-free path
+    for (int t = 0; t < kThreads; ++t) {
+        workers.emplace_back([&, t] {
+            for (void* p : produced[(t + 1) % kThreads]) {
+                allocator.deallocate(p);
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    // Everything flushed back at thread exit is reusable
+    std::vector<void*> again;
+    for (int i = 0; i < 1000; ++i) {
+        void* p = allocator.allocate(64);
+        REQUIRE(p != nullptr);
+        again.push_back(p);
+    }
+    std::sort(again.begin(), again.end());
+    REQUIRE(std::adjacent_find(again.begin(), again.end()) == again.end());
+    for (void* p : again) allocator.deallocate(p);
+}
+
+TEST_CASE("SizeClassMap geometric table matches jemalloc spacing", "[size_classes]") {
+    slab::SizeClassMap map = slab::SizeClassMap::geometric(1024);
+    std::vector<std::size_t> expected = {8, 16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224,
+                                         256, 320, 384, 448, 512, 640, 768, 896, 1024};
+
+    REQUIRE(map.count() == expected.size());
+    for (std::size_t cls = 0; cls < map.count(); ++cls) {
+        REQUIRE(map.classSize(cls) == expected[cls]);
+    }
+}
+
+TEST_CASE("SizeClassMap geometric table with zero steps per doubling uses one", "[size_classes]") {
+    slab::SizeClassMap map = slab::SizeClassMap::geometric(1024, 0);
+    std::vector<std::size_t> expected = {8, 16, 32, 64, 128, 256, 512, 1024};
+
+    REQUIRE(map.count() == expected.size());
+    for (std::size_t cls = 0; cls < map.count(); ++cls) {
+        REQUIRE(map.classSize(cls) == expected[cls]);
+    }
+}
+
+TEST_CASE("SizeClassMap maps every size to the smallest fitting class", "[size_classes]") {
+    std::vector<slab::SizeClassMap> maps = {
+        slab::SizeClassMap::geometric(1024),
+        slab::SizeClassMap::geometric(32768),
+        slab::SizeClassMap::powersOfTwo(4096),
+        slab::SizeClassMap({24, 72, 200, 1500, 3000}),
+    };
+
+    for (const auto& map : maps) {
+        for (std::size_t size = 1; size <= map.maxSize(); ++size) {
+            std::size_t cls = map.classIndex(size);
+            REQUIRE(map.classSize(cls) >= size);
+            // Exact for the 8-byte granular range; large sizes may round up one slot
+            if (size <= 1024 && cls > 0) {
+                REQUIRE(map.classSize(cls - 1) < size);
+            }
+        }
+    }
+}
+
+TEST_CASE("PoolAllocator with a user-supplied class table", "[pool_allocator][size_classes]") {
+    slab::PoolOptions options;
+    options.size_classes = slab::SizeClassMap({24, 72, 200});
+    slab::PoolAllocator allocator(options);
+
+    std::vector<void*> ptrs;
+    for (std::size_t size : {1, 24, 25, 72, 150, 200, 201}) {
+        void* ptr = allocator.allocate(size);
+        REQUIRE(ptr != nullptr);
+        std::memset(ptr, 0xab, size);
+        ptrs.push_back(ptr);
+    }
+    for (void* ptr : ptrs) allocator.deallocate(ptr);
+}
+
+TEST_CASE("PoolAllocator pools the 1025-32768 byte range", "[pool_allocator][size_classes]") {
+    slab::PoolAllocator allocator;
+    std::vector<void*> ptrs;
+
+    for (std::size_t size = 1025; size <= 32768; size += 509) {
+        void* ptr = allocator.allocate(size);
+        REQUIRE(ptr != nullptr);
+        REQUIRE(allocator.owns(ptr));
+        std::memset(ptr, 0x5a, size);
+        ptrs.push_back(ptr);
+    }
+    for (void* ptr : ptrs) allocator.deallocate(ptr);
+
+    void* foreign = malloc(64);
+    REQUIRE_FALSE(allocator.owns(foreign));
+    allocator.deallocate(foreign);  // not ours: handed back to free()
+}
+
+TEST_CASE("Large objects reuse cached spans", "[pool_allocator][large]") {
+    slab::PoolAllocator allocator;
+
+    void* big = allocator.allocate(1 << 20);
+    REQUIRE(big != nullptr);
+    REQUIRE(allocator.owns(big));
+    std::memset(big, 1, 1 << 20);
+    allocator.deallocate(big);
+
+    // A slightly smaller request fits the cached span
+    void* again = allocator.allocate((1 << 20) - 5000);
+    REQUIRE(again == big);
+    allocator.deallocate(again);
+
+    // Far smaller requests get their own span rather than wasting this one
+    void* small = allocator.allocate(100000);
+    REQUIRE(small != big);
+    allocator.deallocate(small);
+}
+
+TEST_CASE("Large span cache respects its byte limit", "[pool_allocator][large]") {
+    slab::PoolOptions options;
+    options.large_cache_bytes = 0;
+    slab::PoolAllocator allocator(options);
+
+    void* big = allocator.allocate(1 << 20);
+    allocator.deallocate(big);
+    REQUIRE_FALSE(allocator.owns(big));  // unmapped straight away
+}
+
+TEST_CASE("Small allocations return nullptr once no slab can be mapped", "[pool_allocator][oom]") {
+    for (bool thread_safe : {false, true}) {
+        // The address-space limit would outlive the test, so it runs in a child
+        pid_t child = fork();
+        REQUIRE(child >= 0);
+        if (child == 0) {
+            slab::PoolOptions options;
+            options.thread_safe = thread_safe;
+            slab::PoolAllocator allocator(options);
+            std::vector<void*> ptrs;
+            ptrs.reserve(std::size_t{1} << 20);
+
+            std::ifstream statm("/proc/self/statm");
+            std::size_t pages = 0;
+            statm >> pages;
+            rlimit limit;
+            limit.rlim_cur = limit.rlim_max = pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE)) + (16 << 20);
+            if (setrlimit(RLIMIT_AS, &limit) != 0) _exit(2);
+
+            void* ptr = nullptr;
+            while (ptrs.size() < ptrs.capacity() && (ptr = allocator.allocate(64)) != nullptr) ptrs.push_back(ptr);
+            if (ptr != nullptr) _exit(3);                 // the limit never bit
+            void* batch[64];
+            if (allocator.allocate_bulk(64, 64, batch) == 64) _exit(4);
+            slab::PoolStats stats = allocator.stats();
+            if (stats.allocs() != ptrs.size()) _exit(5);   // failed calls are not counted
+            for (void* p : ptrs) allocator.deallocate(p);
+            _exit(0);
+        }
+        int status = 0;
+        REQUIRE(waitpid(child, &status, 0) == child);
+        REQUIRE(WIFEXITED(status));
+        CHECK(WEXITSTATUS(status) == 0);
+    }
+}
+
+namespace {
+
+std::size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    std::size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// 64MB of 256-byte objects
+std::vector<void*> allocateBurst(slab::PoolAllocator& allocator) {
+    std::vector<void*> ptrs;
+    for (std::size_t i = 0; i < (std::size_t{64} << 20) / 256; ++i) {
+        void* ptr = allocator.allocate(256);
+        std::memset(ptr, 1, 256);
+        ptrs.push_back(ptr);
+    }
+    return ptrs;
+}
+
+} // namespace
+
+TEST_CASE("Slab tracks live chunks in O(1)", "[slab]") {
+    slab::Slab slab{128};
+    void* p1 = slab.allocate();
+    void* p2 = slab.allocate();
+    REQUIRE(slab.live_chunks() == 2);
+    REQUIRE_FALSE(slab.empty());
+
+    slab.deallocate(p1);
+    slab.deallocate(p2);
+    REQUIRE(slab.live_chunks() == 0);
+    REQUIRE(slab.empty());
+}
+
+TEST_CASE("Slab carves fresh chunks in ascending address order", "[slab]") {
+    constexpr std::size_t kChunk = 48;   // does not divide the slab
+    slab::Slab slab{kChunk};
+
+    std::vector<char*> ptrs;
+    while (void* ptr = slab.allocate()) ptrs.push_back(static_cast<char*>(ptr));
+    REQUIRE(ptrs.size() == slab.bytes() / kChunk);
+    for (std::size_t i = 0; i < ptrs.size(); ++i) {
+        REQUIRE(ptrs[i] == static_cast<char*>(slab.memory()) + i * kChunk);
+    }
+    REQUIRE_FALSE(slab.has_free_chunks());
+
+    // Recycled chunks are handed out before the slab reports exhaustion again
+    slab.deallocate(ptrs[3]);
+    REQUIRE(slab.has_free_chunks());
+    REQUIRE(slab.allocate() == ptrs[3]);
+    REQUIRE(slab.allocate() == nullptr);
+}
+
+TEST_CASE("Empty slabs beyond the retention cap go back to the OS", "[pool_allocator][trim]") {
+    slab::PoolAllocator allocator;  // default cap: a couple of empty slabs per class
+    std::vector<void*> ptrs = allocateBurst(allocator);
+    std::size_t peak = residentBytes();
+
+    for (void* ptr : ptrs) allocator.deallocate(ptr);
+    REQUIRE(residentBytes() < peak - (std::size_t{32} << 20));
+}
+
+TEST_CASE("Thread-safe pools apply the retention cap without trim()", "[pool_allocator][trim][threads]") {
+    slab::PoolOptions options;
+    options.thread_safe = true;
+    options.max_empty_slabs_per_class = 0;
+    slab::PoolAllocator allocator(options);
+
+    // Freed by the allocating thread, and by another thread that exits
+    std::vector<void*> ptrs = allocateBurst(allocator);
+    std::size_t peak = residentBytes();
+    std::size_t half = ptrs.size() / 2;
+    for (std::size_t i = 0; i < half; ++i) allocator.deallocate(ptrs[i]);
+    std::thread([&] {
+        for (std::size_t i = half; i < ptrs.size(); ++i) allocator.deallocate(ptrs[i]);
+    }).join();
+
+    slab::PoolStats stats = allocator.stats();
+    std::uint64_t destroyed = 0;
+    for (std::size_t cls = 0; cls < stats.class_count; ++cls) destroyed += stats.classes[cls].slabs_destroyed;
+    REQUIRE(destroyed > 0);
+    REQUIRE(stats.mapped_bytes < (std::size_t{1} << 20));   // what this thread's cache still holds
+    REQUIRE(residentBytes() < peak - (std::size_t{32} << 20));
+}
+
+TEST_CASE("Thread-safe pools apply the retention cap on the next refill", "[pool_allocator][trim][threads]") {
+    slab::PoolOptions options;
+    options.thread_safe = true;
+    options.max_empty_slabs_per_class = 0;
+    slab::PoolAllocator allocator(options);
+
+    // Freed by a thread that stays alive, so only a refill can reclaim
+    std::vector<void*> ptrs = allocateBurst(allocator);
+    std::size_t peak = residentBytes();
+    std::atomic<bool> freed{false}, done{false};
+    std::thread freer([&] {
+        for (void* ptr : ptrs) allocator.deallocate(ptr);
+        freed.store(true);
+        while (!done.load()) std::this_thread::yield();
+    });
+    while (!freed.load()) std::this_thread::yield();
+
+    auto destroyed = [&] {
+        slab::PoolStats stats = allocator.stats();
+        std::uint64_t total = 0;
+        for (std::size_t cls = 0; cls < stats.class_count; ++cls) total += stats.classes[cls].slabs_destroyed;
+        return total;
+    };
+    REQUIRE(destroyed() == 0);
+
+    std::vector<void*> more;
+    for (int i = 0; i < 1024; ++i) more.push_back(allocator.allocate(256));
+    CHECK(destroyed() > 0);
+    CHECK(residentBytes() < peak - (std::size_t{32} << 20));
+
+    done.store(true);
+    freer.join();
+    for (void* ptr : more) allocator.deallocate(ptr);
+}
+
+TEST_CASE("trim() releases retained empty slabs", "[pool_allocator][trim]") {
+    slab::PoolOptions options;
+    options.max_empty_slabs_per_class = SIZE_MAX;  // retain everything until trim()
+    slab::PoolAllocator allocator(options);
+    std::vector<void*> ptrs = allocateBurst(allocator);
+
+    for (void* ptr : ptrs) allocator.deallocate(ptr);
+    std::size_t retained = residentBytes();
+
+    allocator.trim();
+    REQUIRE(residentBytes() < retained - (std::size_t{32} << 20));
+
+    // The pool keeps working after giving its memory back
+    void* ptr = allocator.allocate(256);
+    REQUIRE(ptr != nullptr);
+    allocator.deallocate(ptr);
+}
+
+TEST_CASE("A child forked while other threads allocate can use the pool", "[pool_allocator][fork][threads]") {
+    slab::PoolOptions options;
+    options.thread_safe = true;
+    options.max_empty_slabs_per_class = 0;   // frees reach the slabs and the arena as well
+    slab::PoolAllocator allocator(options);
+
+    // Small objects through every class lock, large ones through the span
+    // cache, and std::vector through malloc, which is this pool's kind
+    // under the preload
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&, t] {
+            std::vector<void*> live;
+            for (std::size_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+                std::size_t size = i % 64 == 0 ? 64 << 10 : 8 + (i * 40 + t * 8) % 2048;
+                live.push_back(allocator.allocate(size));
+                if (live.size() == 256) {
+                    for (void* p : live) allocator.deallocate(p);
+                    live.clear();
+                    live.shrink_to_fit();
+                }
+            }
+            for (void* p : live) allocator.deallocate(p);
+        });
+    }
+
+    int hung_or_failed = 0;
+    for (int round = 0; round < 50; ++round) {
+        allocator.prepare_fork();
+        pid_t child = fork();
+        allocator.after_fork();
+        REQUIRE(child >= 0);
+        if (child == 0) {
+            alarm(10);   // a lock copied in its taken state would hang here
+            std::vector<void*> ptrs;
+            for (std::size_t size = 8; size <= (256 << 10); size += size / 4 + 8) ptrs.push_back(allocator.allocate(size));
+            bool ok = std::find(ptrs.begin(), ptrs.end(), nullptr) == ptrs.end();
+            for (void* p : ptrs) allocator.deallocate(p);
+            allocator.trim();
+            _exit(ok ? 0 : 1);
+        }
+        int status = 0;
+        REQUIRE(waitpid(child, &status, 0) == child);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ++hung_or_failed;
+    }
+    stop = true;
+    for (auto& w : workers) w.join();
+    REQUIRE(hung_or_failed == 0);
+}
+
+TEST_CASE("Background trim decays memory after a burst", "[pool_allocator][trim][threads]") {
+    slab::PoolOptions options;
+    options.thread_safe = true;
+    options.max_empty_slabs_per_class = SIZE_MAX;
+    options.trim_interval_ms = 10;
+    slab::PoolAllocator allocator(options);
+
+    // Burst on another thread so its cache is flushed back when it exits
+    std::size_t peak = 0;
+    std::thread([&] {
+        std::vector<void*> ptrs = allocateBurst(allocator);
+        peak = residentBytes();
+        for (void* ptr : ptrs) allocator.deallocate(ptr);
+    }).join();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (residentBytes() > peak - (std::size_t{32} << 20) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(residentBytes() < peak - (std::size_t{32} << 20));
+}
+
+TEST_CASE("Allocation reuses partially free slabs before creating new ones", "[pool_allocator][slab_lists]") {
+    slab::PoolAllocator allocator;
+    std::vector<void*> ptrs;
+
+    // Ten full slabs of 64-byte chunks
+    for (std::size_t i = 0; i < 10 * slab::Slab::kSlabSize / 64; ++i) {
+        ptrs.push_back(allocator.allocate(64));
+    }
+
+    // A hole in the middle of the pool is the next chunk handed out
+    void* hole = ptrs[3 * slab::Slab::kSlabSize / 64 + 17];
+    allocator.deallocate(hole);
+    REQUIRE(allocator.allocate(64) == hole);
+
+    for (void* ptr : ptrs) allocator.deallocate(ptr);
+}
+
+TEST_CASE("Full slabs come back after remote frees", "[pool_allocator][slab_lists][threads]") {
+    slab::PoolOptions options;
+    options.thread_safe = true;
+    slab::PoolAllocator allocator(options);
+
+    constexpr std::size_t kCount = 20 * slab::Slab::kSlabSize / 64;
+    std::vector<void*> first;
+    for (std::size_t i = 0; i < kCount; ++i) first.push_back(allocator.allocate(64));
+
+    // Freed on another thread: the full slabs get queued back to this class
+    std::thread([&] {
+        for (void* ptr : first) allocator.deallocate(ptr);
+    }).join();
+
+    std::vector<void*> second;
+    for (std::size_t i = 0; i < kCount; ++i) second.push_back(allocator.allocate(64));
+
+    std::sort(first.begin(), first.end());
+    for (void* ptr : second) {
+        REQUIRE(std::binary_search(first.begin(), first.end(), ptr));
+    }
+    for (void* ptr : second) allocator.deallocate(ptr);
+}
+
+namespace {
+
+void bulkRoundTrip(bool thread_safe, bool sized) {
+    slab::PoolOptions options;
+    options.thread_safe = thread_safe;
+    options.max_empty_slabs_per_class = SIZE_MAX;  // keep every slab so reuse is observable
+    slab::PoolAllocator allocator(options);
+
+    constexpr std::size_t kCount = 4 * slab::Slab::kSlabSize / 64;  // fills several slabs exactly
+    std::vector<void*> ptrs(kCount);
+    REQUIRE(allocator.allocate_bulk(64, kCount, ptrs.data()) == kCount);
+
+    std::vector<void*> sorted = ptrs;
+    std::sort(sorted.begin(), sorted.end());
+    REQUIRE(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+    for (void* ptr : ptrs) {
+        REQUIRE(allocator.owns(ptr));
+        std::memset(ptr, 0xAB, 64);
+    }
+
+    if (sized) allocator.deallocate_bulk(ptrs.data(), kCount, 64);
+    else allocator.deallocate_bulk(ptrs.data(), kCount);
+
+    // Everything came back: the same chunks serve the next batch
+    std::vector<void*> again(kCount);
+    REQUIRE(allocator.allocate_bulk(64, kCount, again.data()) == kCount);
+    for (void* ptr : again) {
+        REQUIRE(std::binary_search(sorted.begin(), sorted.end(), ptr));
+    }
+    allocator.deallocate_bulk(again.data(), kCount);
+}
+
+} // namespace
+
+TEST_CASE("Bulk allocate and free round-trip", "[pool_allocator][bulk]") {
+    SECTION("single-threaded, unsized free") { bulkRoundTrip(false, false); }
+    SECTION("single-threaded, sized free")   { bulkRoundTrip(false, true); }
+    SECTION("thread-safe, unsized free")     { bulkRoundTrip(true, false); }
+    SECTION("thread-safe, sized free")       { bulkRoundTrip(true, true); }
+}
+
+TEST_CASE("Bulk free handles mixed sizes, large objects and foreign pointers", "[pool_allocator][bulk]") {
+    slab::PoolAllocator allocator;
+
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 100; ++i) {
+        ptrs.push_back(allocator.allocate(16 + (i % 5) * 48));
+    }
+    ptrs.push_back(allocator.allocate(100000));
+    ptrs.push_back(std::malloc(32));  // not from the pool: handed to free()
+
+    std::mt19937 gen(7);
+    std::shuffle(ptrs.begin(), ptrs.end(), gen);
+    allocator.deallocate_bulk(ptrs.data(), ptrs.size());
+
+    allocator.trim();
+    for (void* ptr : ptrs) {
+        REQUIRE_FALSE(allocator.owns(ptr));
+    }
+}
+
+TEST_CASE("Sized bulk free skips null entries", "[pool_allocator][bulk]") {
+    for (bool thread_safe : {false, true}) {
+        slab::PoolOptions options;
+        options.thread_safe = thread_safe;
+        options.verify_sized_frees = true;  // a null entry must not be reported either
+        slab::PoolAllocator allocator(options);
+
+        void* ptrs[] = {allocator.allocate(64), nullptr, allocator.allocate(64), nullptr};
+        allocator.deallocate_bulk(ptrs, 4, 64);
+        void* nulls[] = {nullptr, nullptr};
+        allocator.deallocate_bulk(nulls, 2, 64);
+
+        // Both chunks came back and are handed out again
+        void* again[] = {allocator.allocate(64), allocator.allocate(64)};
+        std::sort(std::begin(again), std::end(again));
+        void* freed[] = {ptrs[0], ptrs[2]};
+        std::sort(std::begin(freed), std::end(freed));
+        REQUIRE(std::equal(std::begin(again), std::end(again), std::begin(freed)));
+        allocator.deallocate_bulk(again, 2, 64);
+    }
+}
+
+TEST_CASE("Sized deallocate returns chunks to their class", "[pool_allocator][sized]") {
+    for (bool thread_safe : {false, true}) {
+        slab::PoolOptions options;
+        options.thread_safe = thread_safe;
+        options.verify_sized_frees = true;  // default handler aborts on any mismatch
+        slab::PoolAllocator allocator(options);
+
+        std::vector<std::pair<void*, std::size_t>> ptrs;
+        std::mt19937 gen(11);
+        std::uniform_int_distribution<std::size_t> size(1, 40000);
+        for (int i = 0; i < 2000; ++i) {
+            std::size_t bytes = size(gen);
+            ptrs.emplace_back(allocator.allocate(bytes), bytes);
+        }
+        for (auto [ptr, bytes] : ptrs) allocator.deallocate(ptr, bytes);
+
+        allocator.deallocate(nullptr, 64);
+        if (!thread_safe) {   // thread-safe pools hold freed chunks in the thread cache
+            allocator.trim();
+            for (auto [ptr, bytes] : ptrs) REQUIRE_FALSE(allocator.owns(ptr));
+        }
+    }
+}
+
+namespace {
+
+std::vector<std::string> misuse_reports;
+
+void recordMisuse(const char* message, const void*) {
+    misuse_reports.emplace_back(message);
+}
+
+} // namespace
+
+TEST_CASE("Sized free verification reports mismatched sizes", "[pool_allocator][sized]") {
+    slab::PoolOptions options;
+    options.verify_sized_frees = true;
+    options.error_handler = &recordMisuse;
+    slab::PoolAllocator allocator(options);
+    misuse_reports.clear();
+
+    void* small = allocator.allocate(64);
+    allocator.deallocate(small, 64);
+    REQUIRE(misuse_reports.empty());
+
+    small = allocator.allocate(64);
+    allocator.deallocate(small, 512);     // wrong class
+    void* large = allocator.allocate(100000);
+    allocator.deallocate(large, 64);      // large object freed with a small size
+    void* foreign = std::malloc(64);
+    allocator.deallocate(foreign, 64);    // not from this pool
+    REQUIRE(misuse_reports.size() == 3);
+
+    // The handler returned, so each pointer was still freed correctly
+    allocator.trim();
+    REQUIRE_FALSE(allocator.owns(small));
+    REQUIRE_FALSE(allocator.owns(large));
+}
+
+TEST_CASE("Sized free of a foreign pointer takes the foreign path", "[pool_allocator][sized]") {
+    // Single-threaded pools and NUMA pools look the slab up anyway; without
+    // verification a foreign pointer must still not reach a slab
+    struct Config { bool thread_safe; unsigned numa_nodes; };
+    for (Config config : {Config{false, 1}, Config{false, 2}, Config{true, 2}}) {
+        slab::PoolOptions options;
+        options.thread_safe = config.thread_safe;
+        options.numa_nodes = config.numa_nodes;
+        slab::PoolAllocator allocator(options);
+
+        void* foreign = std::malloc(64);
+        allocator.deallocate(foreign, 64);    // handed on to std::free
+        REQUIRE(allocator.stats().foreign_frees == 1);
+
+        void* ptr = allocator.allocate(64);   // the pool itself is intact
+        REQUIRE(ptr != nullptr);
+        allocator.deallocate(ptr, 64);
+    }
+}
+
+TEST_CASE("pmr containers draw from the pool", "[pool_allocator][stl]") {
+    slab::PoolAllocator allocator;
+    slab::PoolMemoryResource resource(allocator);
+
+    std::pmr::map<int, std::pmr::string> map(&resource);
+    for (int i = 0; i < 1000; ++i) {
+        map.emplace(i, std::pmr::string(40, static_cast<char>('a' + i % 26)));  // past the SSO buffer
+    }
+    for (auto& [key, value] : map) {
+        REQUIRE(allocator.owns(&value));
+        REQUIRE(allocator.owns(value.data()));
+        REQUIRE(value[0] == 'a' + key % 26);
+    }
+
+    slab::PoolMemoryResource same_pool(allocator);
+    REQUIRE(resource.is_equal(same_pool));
+    REQUIRE_FALSE(resource.is_equal(*std::pmr::new_delete_resource()));
+
+    // Over-aligned requests are served by the pool too
+    void* aligned = resource.allocate(256, 64);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(aligned) % 64 == 0);
+    REQUIRE(allocator.owns(aligned));
+    resource.deallocate(aligned, 256, 64);
+}
+
+TEST_CASE("PoolStlAllocator works with node and hash containers", "[pool_allocator][stl]") {
+    slab::PoolOptions options;
+    options.verify_sized_frees = true;  // every container free is sized
+    slab::PoolAllocator allocator(options);
+
+    using Alloc = slab::PoolStlAllocator<std::pair<const int, int>>;
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, Alloc> map(0, std::hash<int>{},
+                                                                                std::equal_to<int>{},
+                                                                                Alloc(allocator));
+    std::list<int, slab::PoolStlAllocator<int>> list{slab::PoolStlAllocator<int>(allocator)};
+
+    for (int i = 0; i < 5000; ++i) {
+        map[i] = i * 2;
+        list.push_back(i);
+    }
+    for (int i = 0; i < 5000; i += 2) map.erase(i);
+    REQUIRE(map.size() == 2500);
+    REQUIRE(map.at(4999) == 9998);
+    REQUIRE(allocator.owns(&list.front()));
+
+    // Rebound copies share the pool
+    slab::PoolStlAllocator<double> rebound(map.get_allocator());
+    REQUIRE(rebound == map.get_allocator());
+
+    struct alignas(64) Wide { char bytes[64]; };
+    slab::PoolStlAllocator<Wide> wide(allocator);
+    Wide* w = wide.allocate(3);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(w) % 64 == 0);
+    REQUIRE(allocator.owns(w));
+    wide.deallocate(w, 3);
+}
+
+TEST_CASE("Every class is naturally aligned", "[pool_allocator][alignment]") {
+    for (const slab::SizeClassMap& map : {slab::SizeClassMap::geometric(32768),
+                                          slab::SizeClassMap::powersOfTwo(slab::SizeClassMap::kMaxSize)}) {
+        slab::PoolOptions options;
+        options.size_classes = map;
+        slab::PoolAllocator allocator(options);
+
+        for (std::size_t cls = 0; cls < map.count(); ++cls) {
+            std::size_t size = map.classSize(cls);
+            std::size_t alignment = map.classAlignment(cls);
+            REQUIRE(alignment >= slab::SizeClassMap::kAlignment);
+            REQUIRE(size % alignment == 0);
+
+            // Two slabs' worth, so the check covers more than one slab base
+            std::size_t count = 2 * map.slabBytes(cls) / size;
+            std::vector<void*> ptrs;
+            for (std::size_t i = 0; i < count; ++i) {
+                void* ptr = allocator.allocate(size);
+                REQUIRE(reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0);
+                ptrs.push_back(ptr);
+            }
+            for (void* ptr : ptrs) allocator.deallocate(ptr);
+        }
+    }
+}
+
+TEST_CASE("allocate(size, alignment) honours any power of two", "[pool_allocator][alignment]") {
+    for (bool thread_safe : {false, true}) {
+        slab::PoolOptions options;
+        options.thread_safe = thread_safe;
+        options.verify_sized_frees = true;
+        slab::PoolAllocator allocator(options);
+
+        for (std::size_t alignment : {1u, 8u, 16u, 32u, 64u, 128u, 4096u, 8192u, 65536u, 1u << 20}) {
+            for (std::size_t size : {1u, 24u, 64u, 100u, 1000u, 5000u, 40000u, 300000u}) {
+                void* ptr = allocator.allocate(size, alignment);
+                REQUIRE(ptr != nullptr);
+                REQUIRE(reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0);
+                REQUIRE(allocator.usable_size(ptr) >= size);
+                std::memset(ptr, 0x5A, size);
+                allocator.deallocate(ptr, size, alignment);
+            }
+        }
+        REQUIRE(allocator.allocate(64, 48) == nullptr);   // not a power of two
+    }
+}
+
+namespace {
+
+// The entry stats() reports for the class serving size
+const slab::ClassStats& classFor(const slab::PoolStats& stats, std::size_t size) {
+    std::size_t cls = 0;
+    while (stats.classes[cls].chunk_size < size) ++cls;
+    return stats.classes[cls];
+}
+
+} // namespace
+
+TEST_CASE("stats() counts allocations and frees per class", "[pool_allocator][stats]") {
+    for (bool thread_safe : {false, true}) {
+        slab::PoolOptions options;
+        options.thread_safe = thread_safe;
+        slab::PoolAllocator allocator(options);
+        slab::SizeClassMap map;
+
+        std::vector<void*> ptrs;
+        for (int i = 0; i < 500; ++i) ptrs.push_back(allocator.allocate(100));
+        for (int i = 0; i < 200; ++i) allocator.deallocate(ptrs[i]);
+
+        slab::PoolStats stats = allocator.stats();
+        const slab::ClassStats& cs = classFor(stats, 100);
+        REQUIRE(stats.class_count == map.count());
+        REQUIRE(cs.chunk_size == map.classSize(map.classIndex(100)));
+        REQUIRE(cs.allocs == 500);
+        REQUIRE(cs.frees == 200);
+        REQUIRE(cs.requested_bytes == 500 * 100);
+        REQUIRE(cs.slabs >= 1);
+        REQUIRE(cs.slabs_created == cs.slabs);
+        REQUIRE(cs.live_chunks + cs.free_chunks == cs.slabs * (cs.slab_bytes / cs.chunk_size));
+        if (!thread_safe) {   // thread-safe pools count cached chunks as live
+            REQUIRE(cs.live_chunks == 300);
+        }
+        REQUIRE(stats.allocs() == 500);
+        double expected = 1.0 - 100.0 / static_cast<double>(cs.chunk_size);
+        REQUIRE(std::abs(stats.internal_fragmentation() - expected) < 1e-9);
+        REQUIRE(stats.mapped_bytes == cs.slabs * cs.slab_bytes);
+
+        for (int i = 200; i < 500; ++i) allocator.deallocate(ptrs[i]);
+        REQUIRE(classFor(allocator.stats(), 100).frees == 500);
+
+        // Allocations that reset() drops without a free still count
+        for (int i = 0; i < 50; ++i) allocator.allocate(100);
+        allocator.reset();
+        REQUIRE(classFor(allocator.stats(), 100).allocs == 550);
+        REQUIRE(classFor(allocator.stats(), 100).frees == 500);
+    }
+}
+
+TEST_CASE("stats() keeps counts from threads that have exited", "[pool_allocator][stats][threads]") {
+    slab::PoolOptions options;
+    options.thread_safe = true;
+    slab::PoolAllocator allocator(options);
+
+    std::thread worker([&] {
+        for (int i = 0; i < 1000; ++i) allocator.deallocate(allocator.allocate(64));
+    });
+    worker.join();
+
+    slab::PoolStats stats = allocator.stats();
+    const slab::ClassStats& cs = classFor(stats, 64);
+    REQUIRE(cs.allocs == 1000);
+    REQUIRE(cs.frees == 1000);
+}
+
+TEST_CASE("stats() reports large objects, foreign frees and mappings", "[pool_allocator][stats][large]") {
+    slab::PoolAllocator allocator;
+
+    void* large = allocator.allocate(300000);
+    slab::PoolStats stats = allocator.stats();
+    REQUIRE(stats.large_allocs == 1);
+    REQUIRE(stats.large_live_bytes >= 300000);
+    REQUIRE(stats.mapped_bytes == stats.large_live_bytes);
+
+    allocator.deallocate(large);
+    allocator.deallocate(allocator.allocate(300000));   // served from the span cache
+    allocator.deallocate(std::malloc(32));
+    allocator.deallocate(nullptr);                       // neither foreign nor counted
+    void* none[2] = {nullptr, nullptr};
+    allocator.deallocate_bulk(none, 2);
+
+    stats = allocator.stats();
+    REQUIRE(stats.large_allocs == 2);
+    REQUIRE(stats.large_frees == 2);
+    REQUIRE(stats.large_cache_hits == 1);
+    REQUIRE(stats.large_live_bytes == 0);
+    REQUIRE(stats.large_cached_bytes == stats.mapped_bytes);
+    REQUIRE(stats.foreign_frees == 1);
+
+    allocator.trim();
+    stats = allocator.stats();
+    REQUIRE(stats.mapped_bytes == 0);
+    REQUIRE(stats.peak_mapped_bytes >= 300000);
+}
+
+TEST_CASE("stats() writes text and JSON", "[pool_allocator][stats]") {
+    slab::PoolAllocator allocator;
+    void* ptr = allocator.allocate(24);
+    slab::PoolStats stats = allocator.stats();
+
+    std::ostringstream text;
+    stats.write_text(text);
+    REQUIRE(text.str().find("large") != std::string::npos);
+    std::size_t end = text.str().size();
+    text << 0.25;                                   // the stream's formatting is as it was
+    REQUIRE(text.str().substr(end) == "0.25");
+
+    std::ostringstream json;
+    stats.write_json(json);
+    std::string out = json.str();
+    REQUIRE(out.front() == '{');
+    REQUIRE(out.find("\"classes\"") != std::string::npos);
+    REQUIRE(out.find("\"chunk_size\":24") != std::string::npos);
+    REQUIRE(out.find("\"peak_mapped_bytes\"") != std::string::npos);
+    allocator.deallocate(ptr);
+}
+
+TEST_CASE("collect_stats = false leaves the event counters at zero", "[pool_allocator][stats]") {
+    slab::PoolOptions options;
+    options.collect_stats = false;
+    slab::PoolAllocator allocator(options);
+
+    void* ptr = allocator.allocate(64);
+    slab::PoolStats stats = allocator.stats();
+    const slab::ClassStats& cs = classFor(stats, 64);
+    REQUIRE(cs.allocs == 0);
+    REQUIRE(cs.live_chunks == 1);   // structural state is always reported
+    allocator.deallocate(ptr);
+}
+
+TEST_CASE("Refills prefer the most occupied partial slab", "[pool_allocator][slab_selection]") {
+    for (slab::SlabSelection selection : {slab::SlabSelection::kFirstFit, slab::SlabSelection::kMostOccupied}) {
+        slab::PoolOptions options;
+        options.slab_selection = selection;
+        slab::PoolAllocator allocator(options);
+
+        slab::PoolStats stats = allocator.stats();
+        const std::size_t per_slab = classFor(stats, 64).slab_bytes / classFor(stats, 64).chunk_size;
+
+        // Ten full slabs, filled in order
+        std::vector<void*> ptrs;
+        for (std::size_t i = 0; i < 10 * per_slab; ++i) ptrs.push_back(allocator.allocate(64));
+
+        // Slabs 0-7 keep one chunk each, slab 8 keeps half, slab 9 stays full
+        std::vector<void*> sparse, half;
+        for (std::size_t slab_index = 0; slab_index < 9; ++slab_index) {
+            std::size_t keep = slab_index < 8 ? 1 : per_slab / 2;
+            for (std::size_t i = keep; i < per_slab; ++i) {
+                void* ptr = ptrs[slab_index * per_slab + i];
+                allocator.deallocate(ptr);
+                (slab_index < 8 ? sparse : half).push_back(ptr);
+            }
+        }
+        std::sort(sparse.begin(), sparse.end());
+        std::sort(half.begin(), half.end());
+
+        std::vector<void*> again;
+        if (selection == slab::SlabSelection::kMostOccupied) {
+            // Slab 8 fills up before any sparse slab is touched
+            for (std::size_t i = 0; i < half.size(); ++i) {
+                again.push_back(allocator.allocate(64));
+                REQUIRE(std::binary_search(half.begin(), half.end(), again.back()));
+            }
+        }
+        again.push_back(allocator.allocate(64));
+        REQUIRE(std::binary_search(sparse.begin(), sparse.end(), again.back()));
+
+        for (std::size_t slab_index = 0; slab_index < 10; ++slab_index) {
+            std::size_t keep = slab_index < 8 ? 1 : slab_index == 8 ? per_slab / 2 : per_slab;
+            for (std::size_t i = 0; i < keep; ++i) allocator.deallocate(ptrs[slab_index * per_slab + i]);
+        }
+        for (void* ptr : again) allocator.deallocate(ptr);
+        stats = allocator.stats();
+        REQUIRE(classFor(stats, 64).live_chunks == 0);
+        REQUIRE(classFor(stats, 64).slabs <= options.max_empty_slabs_per_class + 1);  // and the one allocated from
+    }
+
+    SECTION("thread-safe pools re-file slabs that remote frees have drained") {
+        slab::PoolOptions options;
+        options.thread_safe = true;
+        slab::PoolAllocator allocator(options);
+
+        constexpr std::size_t kCount = 20 * slab::Slab::kSlabSize / 64;
+        std::vector<void*> ptrs;
+        for (std::size_t i = 0; i < kCount; ++i) ptrs.push_back(allocator.allocate(64));
+        // Another thread frees all but every sixteenth chunk, after the
+        // slabs were filed by their occupancy
+        for (std::size_t i = 0; i < kCount; ++i) {
+            if (i % 4 == 0) allocator.deallocate(ptrs[i]);
+        }
+        std::thread([&] {
+            for (std::size_t i = 0; i < kCount; ++i) {
+                if (i % 4 != 0 && i % 16 != 1) allocator.deallocate(ptrs[i]);
+            }
+        }).join();
+
+        // The freed chunks are reused rather than new slabs created
+        std::size_t slabs = classFor(allocator.stats(), 64).slabs;
+        std::vector<void*> again;
+        for (std::size_t i = 0; i < kCount / 2; ++i) again.push_back(allocator.allocate(64));
+        REQUIRE(classFor(allocator.stats(), 64).slabs <= slabs);
+
+        for (std::size_t i = 1; i < kCount; i += 16) allocator.deallocate(ptrs[i]);
+        for (void* ptr : again) allocator.deallocate(ptr);
+    }
+}
+
+TEST_CASE("Tracing records every allocation and free", "[pool_allocator][trace]") {
+    const char* path = "pool_trace_test.bin";
+    for (bool thread_safe : {false, true}) {
+        std::vector<void*> ptrs;
+        {
+            slab::PoolOptions options;
+            options.thread_safe = thread_safe;
+            options.trace_path = path;
+            slab::PoolAllocator allocator(options);
+
+            for (int i = 0; i < 5000; ++i) ptrs.push_back(allocator.allocate(16 + i % 100));
+            void* aligned = allocator.allocate(100, 256);
+            void* large = allocator.allocate(300000);
+            allocator.deallocate(aligned, 100, 256);
+            allocator.deallocate(large);
+            allocator.deallocate_bulk(ptrs.data(), 100);
+            for (int i = 100; i < 5000; ++i) allocator.deallocate(ptrs[i], 16 + i % 100);
+
+            std::thread worker([&] { allocator.deallocate(allocator.allocate(64)); });
+            worker.join();
+        }
+
+        std::vector<slab::TraceRecord> records;
+        REQUIRE(slab::readTrace(path, records));
+        REQUIRE(records.size() == 2 * 5000 + 4 + 2);
+        for (std::size_t i = 1; i < records.size(); ++i) {
+            REQUIRE(records[i - 1].time_ns() <= records[i].time_ns());
+        }
+
+        // The main thread's events come first, in program order
+        for (int i = 0; i < 5000; ++i) {
+            REQUIRE(records[i].op() == slab::TraceOp::kAllocate);
+            REQUIRE(records[i].id == reinterpret_cast<std::uintptr_t>(ptrs[i]));
+            REQUIRE(records[i].size() == static_cast<std::size_t>(16 + i % 100));
+            REQUIRE(records[i].alignment() == 1);
+        }
+        REQUIRE(records[5000].alignment() == 256);
+        REQUIRE(records[5001].size() == 300000);
+        REQUIRE(records[5002].op() == slab::TraceOp::kFree);
+        REQUIRE(records[5002].size() == 100);
+        REQUIRE(records[5003].size() == 0);                 // unsized
+        REQUIRE(records[5004].id == reinterpret_cast<std::uintptr_t>(ptrs[0]));
+        REQUIRE(records.back().op() == slab::TraceOp::kFree);
+        if (thread_safe) REQUIRE(records.back().thread() != records.front().thread());
+        std::remove(path);
+    }
+}
+
+TEST_CASE("readTrace rejects files that are not traces", "[trace]") {
+    std::vector<slab::TraceRecord> records;
+    REQUIRE_FALSE(slab::readTrace("/proc/self/status", records));
+    REQUIRE_FALSE(slab::readTrace("no_such_trace.bin", records));
+}
+
+TEST_CASE("FixedSlab geometry is fixed at compile time", "[fixed_slab]") {
+    using Slab48 = slab::FixedSlab<48>;
+    static_assert(Slab48::kHeaderBytes == 40);
+    static_assert(Slab48::kChunks == (slab::Slab::kSlabSize - 40) / 48);
+    static_assert(Slab48::kAlignment == 16);
+    static_assert(slab::FixedSlab<72>::kChunks == slab::Slab::kSlabSize / 72);   // the header fits in the slack
+    static_assert(slab::FixedSlab<64>::kChunks == slab::Slab::kSlabSize / 64 - 1);
+
+    Slab48* fixed = Slab48::create();
+    REQUIRE(fixed != nullptr);
+    std::vector<void*> ptrs;
+    while (void* ptr = fixed->allocate()) {
+        REQUIRE(Slab48::owner(ptr) == fixed);
+        REQUIRE(fixed->contains(ptr));
+        REQUIRE(reinterpret_cast<std::uintptr_t>(ptr) % Slab48::kAlignment == 0);
+        std::memset(ptr, 0xAB, 48);
+        ptrs.push_back(ptr);
+    }
+    REQUIRE(ptrs.size() == Slab48::kChunks);
+    REQUIRE(fixed->full());
+
+    for (void* ptr : ptrs) fixed->deallocate(ptr);
+    REQUIRE(fixed->empty());
+    REQUIRE(fixed->allocate() == ptrs.back());   // most recently freed first
+    Slab48::destroy(fixed);
+}
+
+TEST_CASE("FixedPool spans many slabs and gives them back", "[fixed_slab]") {
+    slab::FixedPool<64, 1 << 16> pool;
+    constexpr std::size_t kCount = 10 * slab::FixedSlab<64, 1 << 16>::kChunks;
+
+    std::vector<void*> ptrs;
+    for (std::size_t i = 0; i < kCount; ++i) {
+        void* ptr = pool.allocate();
+        REQUIRE(ptr != nullptr);
+        *static_cast<std::size_t*>(ptr) = i;
+        ptrs.push_back(ptr);
+    }
+    for (std::size_t i = 0; i < kCount; ++i) REQUIRE(*static_cast<std::size_t*>(ptrs[i]) == i);
+
+    std::mt19937 gen(3);
+    std::shuffle(ptrs.begin(), ptrs.end(), gen);
+    for (std::size_t i = 0; i < kCount / 2; ++i) pool.deallocate(ptrs[i]);
+    for (std::size_t i = 0; i < kCount / 2; ++i) ptrs[i] = pool.allocate();   // refills partial slabs
+    for (void* ptr : ptrs) {
+        REQUIRE(pool.owns(ptr));
+        pool.deallocate(ptr);
+    }
+    // All but the last slab (and one spare, which is not listed) are unmapped
+    std::size_t still_owned = 0;
+    for (void* ptr : ptrs) still_owned += pool.owns(ptr);
+    REQUIRE(still_owned <= slab::FixedSlab<64, 1 << 16>::kChunks);
+    pool.deallocate(nullptr);
+}
+
+TEST_CASE("FixedPool::owns rejects pointers it did not hand out", "[fixed_slab]") {
+    slab::FixedPool<64> pool;
+    slab::FixedPool<64> other;
+    void* mine = pool.allocate();
+    void* theirs = other.allocate();
+    int local = 0;
+
+    REQUIRE(pool.owns(mine));
+    REQUIRE_FALSE(pool.owns(theirs));
+    REQUIRE_FALSE(pool.owns(&local));
+    REQUIRE_FALSE(pool.owns(slab::FixedSlab<64>::owner(mine)));   // the header is not a chunk
+
+    pool.deallocate(mine);
+    other.deallocate(theirs);
+}
+
+namespace {
+
+struct alignas(64) Tracked {
+    static int live;
+    explicit Tracked(int v) : value(v) {
+        if (v < 0) throw std::runtime_error("negative");
+        ++live;
+    }
+    ~Tracked() { --live; }
+    int value;
+};
+
+int Tracked::live = 0;
+
+} // namespace
+
+TEST_CASE("ObjectPool constructs and destroys T in aligned chunks", "[fixed_slab][object_pool]") {
+    static_assert(slab::ObjectPool<Tracked>::kChunkSize == 64);
+    static_assert(slab::ObjectPool<char>::kChunkSize == sizeof(void*));
+
+    slab::ObjectPool<Tracked> pool;
+    std::vector<Tracked*> objects;
+    for (int i = 0; i < 1000; ++i) {
+        Tracked* object = pool.create(i);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(object) % 64 == 0);
+        objects.push_back(object);
+    }
+    REQUIRE(Tracked::live == 1000);
+    for (int i = 0; i < 1000; ++i) REQUIRE(objects[i]->value == i);
+
+    bool threw = false;
+    try {
+        pool.create(-1);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    REQUIRE(threw);
+    REQUIRE(Tracked::live == 1000);
+
+    for (Tracked* object : objects) pool.destroy(object);
+    REQUIRE(Tracked::live == 0);
+}
+
+TEST_CASE("BitmapSlab hands out the lowest free chunk and refuses bad frees", "[bitmap_slab]") {
+    SECTION("Chunks smaller than a pointer") {
+        slab::BitmapSlab tiny(1, 1 << 12);
+        REQUIRE(tiny.chunk_count() == 1 << 12);
+        char* base = static_cast<char*>(tiny.memory());
+        for (std::size_t i = 0; i < tiny.chunk_count(); ++i) {
+            char* ptr = static_cast<char*>(tiny.allocate());
+            REQUIRE(ptr == base + i);
+            *ptr = static_cast<char>(i);
+        }
+        REQUIRE(tiny.full());
+        REQUIRE(tiny.allocate() == nullptr);
+        for (std::size_t i = 0; i < tiny.chunk_count(); ++i) REQUIRE(base[i] == static_cast<char>(i));
+
+        slab::BitmapSlab odd(3, 1000);
+        REQUIRE(odd.chunk_count() == 333);
+        void* first = odd.allocate();
+        void* second = odd.allocate();
+        REQUIRE(static_cast<char*>(second) == static_cast<char*>(first) + 3);
+    }
+
+    SECTION("Freed chunks are reused lowest first") {
+        slab::BitmapSlab slab(48, 1 << 16);
+        std::vector<void*> ptrs;
+        while (void* ptr = slab.allocate()) ptrs.push_back(ptr);
+        REQUIRE(ptrs.size() == slab.chunk_count());
+        REQUIRE(std::is_sorted(ptrs.begin(), ptrs.end()));
+
+        REQUIRE(slab.deallocate(ptrs[900]));
+        REQUIRE(slab.deallocate(ptrs[5]));
+        REQUIRE(slab.deallocate(ptrs[300]));
+        REQUIRE(slab.allocate() == ptrs[5]);
+        REQUIRE(slab.allocate() == ptrs[300]);
+        REQUIRE(slab.allocate() == ptrs[900]);
+        REQUIRE(slab.allocate() == nullptr);
+    }
+
+    SECTION("Double, misaligned and foreign frees change nothing") {
+        slab::BitmapSlab slab(24);
+        void* a = slab.allocate();
+        void* b = slab.allocate();
+        REQUIRE(slab.deallocate(a));
+        REQUIRE_FALSE(slab.deallocate(a));
+        REQUIRE_FALSE(slab.deallocate(static_cast<char*>(b) + 1));
+        int local = 0;
+        REQUIRE_FALSE(slab.deallocate(&local));
+        REQUIRE_FALSE(slab.deallocate(nullptr));
+        REQUIRE(slab.is_live(b));
+        REQUIRE_FALSE(slab.is_live(a));
+        REQUIRE(slab.live_chunks() == 1);
+        REQUIRE(slab.deallocate(b));
+        REQUIRE(slab.empty());
+    }
+
+    SECTION("A slab that could not be mapped hands out nothing") {
+        pid_t child = fork();   // the address-space limit stays with the child
+        REQUIRE(child >= 0);
+        if (child == 0) {
+            rlimit limit;
+            limit.rlim_cur = limit.rlim_max = 0;   // below what is mapped already: every new mmap fails
+            if (setrlimit(RLIMIT_AS, &limit) != 0) _exit(2);
+            slab::BitmapSlab slab(64, 1 << 20);
+            int local = 0;
+            bool ok = slab.memory() == nullptr && slab.chunk_count() == 0 && slab.allocate() == nullptr &&
+                      slab.count_live() == 0 && !slab.deallocate(&local);
+            _exit(ok ? 0 : 1);
+        }
+        int status = 0;
+        REQUIRE(waitpid(child, &status, 0) == child);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == 0);
+    }
+
+    SECTION("Live chunks can be counted and enumerated") {
+        slab::BitmapSlab slab(40);
+        std::vector<void*> ptrs;
+        while (void* ptr = slab.allocate()) ptrs.push_back(ptr);
+        std::mt19937 gen(21);
+        std::shuffle(ptrs.begin(), ptrs.end(), gen);
+        std::size_t freed = ptrs.size() / 3;
+        for (std::size_t i = 0; i < freed; ++i) REQUIRE(slab.deallocate(ptrs[i]));
+        REQUIRE(slab.count_live() == slab.live_chunks());
+        REQUIRE(slab.live_chunks() == ptrs.size() - freed);
+
+        std::vector<void*> live(ptrs.begin() + freed, ptrs.end());
+        std::sort(live.begin(), live.end());
+        std::vector<void*> seen;
+        slab.for_each_live([&](void* ptr) { seen.push_back(ptr); });
+        REQUIRE(seen == live);
+    }
+}
+
+namespace {
+
+struct Entity {
+    static int live;
+    explicit Entity(int v) : value(v) {
+        if (v < 0) throw std::runtime_error("negative");
+        ++live;
+    }
+    Entity(Entity&& other) noexcept : value(other.value), name(std::move(other.name)) { ++live; }
+    ~Entity() { --live; }
+    int value;
+    std::string name = "entity";
+};
+
+int Entity::live = 0;
+
+} // namespace
+
+TEST_CASE("HandlePool resolves handles, rejects stale ones and packs live objects", "[handle_pool]") {
+    using Pool = slab::HandlePool<Entity, 16>;
+    static_assert(sizeof(Pool::Handle) == 4);
+
+    {
+        Pool pool;
+        REQUIRE(pool.get(Pool::Handle{}) == nullptr);
+
+        std::vector<Pool::Handle> handles;
+        for (int i = 0; i < 5000; ++i) {
+            Pool::Handle handle = pool.create(i);
+            REQUIRE(handle);
+            handles.push_back(handle);
+        }
+        REQUIRE(Entity::live == 5000);
+        for (int i = 0; i < 5000; ++i) REQUIRE(pool.get(handles[i])->value == i);
+
+        // Destroy every third; survivors stay reachable and packed
+        for (int i = 0; i < 5000; i += 3) REQUIRE(pool.destroy(handles[i]));
+        REQUIRE(pool.size() == 5000 - 1667);
+        REQUIRE(Entity::live == 5000 - 1667);
+        for (int i = 0; i < 5000; ++i) {
+            if (i % 3 == 0) {
+                REQUIRE_FALSE(pool.valid(handles[i]));
+                REQUIRE_FALSE(pool.destroy(handles[i]));
+            } else {
+                REQUIRE(pool.get(handles[i])->value == i);
+                REQUIRE(pool.get(handles[i])->name == "entity");
+            }
+        }
+        long sum = 0;
+        for (const Entity& entity : pool) sum += entity.value;
+        long expected = 0;
+        for (int i = 0; i < 5000; ++i) expected += i % 3 == 0 ? 0 : i;
+        REQUIRE(sum == expected);
+        for (std::uint32_t position = 0; position < pool.size(); ++position) {
+            REQUIRE(pool.get(pool.handle_at(position)) == pool.begin() + position);
+        }
+
+        // Reused slots get new generations: old handles stay stale
+        std::vector<Pool::Handle> reused;
+        for (int i = 0; i < 3000; ++i) reused.push_back(pool.create(100000 + i));
+        for (int i = 0; i < 5000; i += 3) REQUIRE_FALSE(pool.valid(handles[i]));
+        for (int i = 0; i < 3000; ++i) REQUIRE(pool.get(reused[i])->value == 100000 + i);
+
+        // A throwing constructor leaves the pool as it was
+        std::uint32_t size = pool.size();
+        bool threw = false;
+        try {
+            pool.create(-1);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        REQUIRE(threw);
+        REQUIRE(pool.size() == size);
+        pool.trim();
+        for (int i = 0; i < 3000; ++i) REQUIRE(pool.get(reused[i])->value == 100000 + i);
+    }
+    REQUIRE(Entity::live == 0);
+
+    SECTION("A full pool returns null handles") {
+        slab::HandlePool<int, 8> small(100);
+        for (int i = 0; i < 100; ++i) REQUIRE(small.create(i));
+        REQUIRE_FALSE(small.create(100));
+        REQUIRE(small.capacity() == 100);
+    }
+
+    SECTION("Generations wrap without reviving stale handles") {
+        slab::HandlePool<int, 28> pool(1);   // 4 generation bits: one slot cycles through them
+        slab::HandlePool<int, 28>::Handle first = pool.create(0);
+        for (int i = 0; i < 100; ++i) {
+            slab::HandlePool<int, 28>::Handle handle = pool.create(i);
+            REQUIRE_FALSE(handle);   // full
+            REQUIRE(pool.destroy(first));
+            REQUIRE_FALSE(pool.valid(first));
+            REQUIRE(pool.get(slab::HandlePool<int, 28>::Handle{}) == nullptr);
+            first = pool.create(i);
+            REQUIRE(*pool.get(first) == i);
+        }
+    }
+}
+
+TEST_CASE("Arena carves aligned spans and reuses freed ones", "[arena]") {
+    slab::Arena arena(std::size_t{4} << 20, slab::HugePages::kNone);
+    REQUIRE(arena.allocate(3 << 12) == nullptr);   // not a power of two
+    REQUIRE(arena.reserved_bytes() == 0);
+
+    std::vector<std::pair<char*, std::size_t>> spans;
+    for (std::size_t bytes : {16384, 65536, 16384, 32768, 131072, 16384}) {
+        char* span = static_cast<char*>(arena.allocate(bytes));
+        REQUIRE(span != nullptr);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(span) % bytes == 0);
+        std::memset(span, 0x5A, bytes);
+        spans.push_back({span, bytes});
+    }
+    REQUIRE(arena.reserved_bytes() == std::size_t{4} << 20);   // one region holds them all
+
+    // No two spans overlap
+    std::sort(spans.begin(), spans.end());
+    for (std::size_t i = 1; i < spans.size(); ++i) {
+        REQUIRE(spans[i - 1].first + spans[i - 1].second <= spans[i].first);
+    }
+
+    // A freed span comes back for the same size, decommitted to zeros
+    char* freed = spans[0].first;
+    arena.deallocate(freed, spans[0].second);
+    char* again = static_cast<char*>(arena.allocate(spans[0].second));
+    REQUIRE(again == freed);
+    REQUIRE(again[0] == 0);
+
+    // Larger than a region: a region of its own
+    void* big = arena.allocate(std::size_t{8} << 20);
+    REQUIRE(big != nullptr);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(big) % (std::size_t{8} << 20) == 0);
+    REQUIRE(arena.reserved_bytes() == std::size_t{12} << 20);
+}
+
+TEST_CASE("Pool slabs come from the arena unless arena_bytes is 0", "[pool_allocator][arena]") {
+    for (std::size_t arena_bytes : {std::size_t{0}, std::size_t{8} << 20}) {
+        slab::PoolOptions options;
+        options.arena_bytes = arena_bytes;
+        options.huge_pages = slab::HugePages::kTransparent;   // only advice: fine where THP is off
+        slab::PoolAllocator allocator(options);
+
+        std::vector<void*> ptrs;
+        for (std::size_t i = 0; i < 20000; ++i) {
+            std::size_t size = 8 + (i * 37) % 4000;
+            void* ptr = allocator.allocate(size);
+            REQUIRE(ptr != nullptr);
+            std::memset(ptr, 0xA5, size);
+            ptrs.push_back(ptr);
+        }
+        slab::PoolStats stats = allocator.stats();
+        if (arena_bytes == 0) REQUIRE(stats.arena_reserved_bytes == 0);
+        else REQUIRE(stats.arena_reserved_bytes >= stats.mapped_bytes);
+
+        for (void* ptr : ptrs) REQUIRE(allocator.owns(ptr));
+        for (void* ptr : ptrs) allocator.deallocate(ptr);
+        allocator.trim();
+        REQUIRE(allocator.stats().mapped_bytes == 0);
+
+        // Slabs released to the arena are handed out again
+        void* ptr = allocator.allocate(64);
+        REQUIRE(allocator.owns(ptr));
+        allocator.deallocate(ptr);
+    }
+}
+
+TEST_CASE("NUMA queries fall back to a single node", "[numa]") {
+    REQUIRE(slab::numaNodeCount() >= 1);
+    REQUIRE(slab::currentNumaNode() < slab::numaNodeCount());
+}
+
+TEST_CASE("Each NUMA node allocates from its own slabs", "[pool_allocator][numa]") {
+    constexpr std::size_t kObjects = 5000;
+
+    SECTION("single-threaded") {
+        slab::PoolOptions options;
+        options.numa_nodes = 2;   // more than this host may have: placement is only a preference
+        slab::PoolAllocator allocator(options);
+        REQUIRE(allocator.stats().numa_nodes == 2);
+
+        allocator.set_numa_node(1);
+        std::vector<void*> remote;
+        for (std::size_t i = 0; i < kObjects; ++i) remote.push_back(allocator.allocate(64));
+        allocator.set_numa_node(0);
+        void* local = allocator.allocate(64);
+        REQUIRE(std::find(remote.begin(), remote.end(), local) == remote.end());
+
+        for (void* ptr : remote) allocator.deallocate(ptr);
+        allocator.deallocate(local, 64);
+        slab::PoolStats stats = allocator.stats();
+        REQUIRE(stats.remote_frees == kObjects);
+        REQUIRE(stats.local_frees == 1);
+        REQUIRE(stats.classes[0].frees + stats.frees() > 0);
+    }
+
+    SECTION("thread-safe: frees from another node go back to the owning slab") {
+        slab::PoolOptions options;
+        options.thread_safe = true;
+        options.numa_nodes = 2;
+        slab::PoolAllocator allocator(options);
+
+        std::vector<void*> objects;
+        std::thread producer([&] {
+            allocator.set_numa_node(0);
+            for (std::size_t i = 0; i < kObjects; ++i) {
+                objects.push_back(allocator.allocate(i % 2 == 0 ? 48 : 200));
+                std::memset(objects.back(), 0x11, 48);
+            }
+        });
+        producer.join();
+
+        std::thread consumer([&] {
+            allocator.set_numa_node(1);
+            for (std::size_t i = 0; i < objects.size(); ++i) {
+                if (i % 2 == 0) allocator.deallocate(objects[i], 48);
+                else allocator.deallocate(objects[i]);
+            }
+            // Node 1 never reuses node 0's chunks
+            std::vector<void*> own;
+            for (std::size_t i = 0; i < 100; ++i) own.push_back(allocator.allocate(48));
+            for (void* ptr : own) {
+                REQUIRE(std::find(objects.begin(), objects.end(), ptr) == objects.end());
+                allocator.deallocate(ptr);
+            }
+        });
+        consumer.join();
+
+        allocator.trim();   // collects the remote frees, so live counts are exact
+        slab::PoolStats stats = allocator.stats();
+        REQUIRE(stats.remote_frees == kObjects);
+        REQUIRE(stats.local_frees == 100);
+        std::size_t live = 0;
+        for (std::size_t cls = 0; cls < stats.class_count; ++cls) live += stats.classes[cls].live_chunks;
+        REQUIRE(live == 0);
+    }
+}
+
+TEST_CASE("Region bumps, rewinds to marks and reuses its blocks", "[region]") {
+    slab::PoolAllocator pool;
+    slab::Region region(pool);
+
+    SECTION("alignment and bad requests") {
+        REQUIRE(region.allocate(8, 3) == nullptr);
+        for (std::size_t alignment : {1, 8, 16, 64, 256, 4096}) {
+            void* ptr = region.allocate(24, alignment);
+            REQUIRE(ptr != nullptr);
+            REQUIRE(reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0);
+        }
+        void* huge_align = region.allocate(100, 1 << 16);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(huge_align) % (1 << 16) == 0);
+        REQUIRE(region.allocate(SIZE_MAX - 16) == nullptr);
+    }
+
+    SECTION("a scope gives back everything allocated inside it") {
+        std::vector<char*> first;
+        {
+            slab::Region::Scope scope(region);
+            for (int i = 0; i < 2000; ++i) {
+                first.push_back(static_cast<char*>(region.allocate(40)));
+                std::memset(first.back(), i & 0xFF, 40);
+            }
+        }
+        std::size_t retained = region.retained_bytes();
+        REQUIRE(retained >= 2000 * 40);
+
+        // The next request walks the same blocks and maps nothing new
+        {
+            slab::Region::Scope scope(region);
+            for (int i = 0; i < 2000; ++i) REQUIRE(region.allocate(40) == first[i]);
+        }
+        REQUIRE(region.retained_bytes() == retained);
+
+        region.release();
+        REQUIRE(region.retained_bytes() == 0);
+    }
+
+    SECTION("nested marks and oversized allocations") {
+        int* outer = region.create<int>(7);
+        slab::Region::Mark mark = region.mark();
+        char* big = static_cast<char*>(region.allocate(1 << 20));
+        REQUIRE(big != nullptr);
+        std::memset(big, 1, 1 << 20);
+        void* inner = region.allocate(16);
+        region.rewind(mark);
+        REQUIRE(*outer == 7);
+        REQUIRE(region.allocate(16) == inner);   // the big one never took block space
+
+        // Objects that outlive the region go to the pool
+        void* kept = region.pool().allocate(64);
+        region.reset();
+        REQUIRE(pool.owns(kept));
+        pool.deallocate(kept);
+    }
+}
+
+TEST_CASE("reallocate grows in place within the chunk and moves only when needed", "[pool_allocator][realloc]") {
+    slab::PoolOptions options;
+    options.error_handler = &recordMisuse;
+    slab::PoolAllocator allocator(options);
+    misuse_reports.clear();
+
+    char* ptr = static_cast<char*>(allocator.allocate(50));
+    std::size_t usable = allocator.usable_size(ptr);
+    REQUIRE(usable >= 50);
+    std::memset(ptr, 'a', 50);
+    REQUIRE(allocator.reallocate(ptr, usable) == ptr);        // the slack is the caller's to use
+    REQUIRE(allocator.reallocate(ptr, usable / 2 + 1) == ptr);
+
+    // Growing past the chunk moves the contents to a bigger class
+    char* grown = static_cast<char*>(allocator.reallocate(ptr, 1000));
+    REQUIRE(grown != ptr);
+    REQUIRE(allocator.usable_size(grown) >= 1000);
+    for (int i = 0; i < 50; ++i) REQUIRE(grown[i] == 'a');
+
+    // Shrinking to under half moves it down, giving the big chunk back
+    char* shrunk = static_cast<char*>(allocator.reallocate(grown, 40));
+    REQUIRE(allocator.usable_size(shrunk) < 1000);
+    for (int i = 0; i < 40; ++i) REQUIRE(shrunk[i] == 'a');
+
+    // Small to large, then large objects are remapped with their contents
+    char* large = static_cast<char*>(allocator.reallocate(shrunk, 100000));
+    for (int i = 0; i < 40; ++i) REQUIRE(large[i] == 'a');
+    std::memset(large, 'b', 100000);
+    large = static_cast<char*>(allocator.reallocate(large, 3000000));
+    REQUIRE(allocator.usable_size(large) >= 3000000);
+    for (int i = 0; i < 100000; i += 997) REQUIRE(large[i] == 'b');
+    std::memset(large, 'c', 3000000);
+    REQUIRE(allocator.stats().large_live_bytes == allocator.usable_size(large));
+    large = static_cast<char*>(allocator.reallocate(large, 500000));
+    REQUIRE(large[499999] == 'c');
+    REQUIRE(allocator.stats().large_live_bytes == allocator.usable_size(large));
+
+    // realloc edge cases
+    void* fresh = allocator.reallocate(nullptr, 24);
+    REQUIRE(allocator.owns(fresh));
+    REQUIRE(allocator.reallocate(fresh, 0) == nullptr);
+    REQUIRE(misuse_reports.empty());
+    void* foreign = std::malloc(16);
+    REQUIRE(allocator.reallocate(foreign, 32) == nullptr);
+    REQUIRE(misuse_reports.size() == 1);
+    std::free(foreign);
+
+    allocator.deallocate(large);
+    allocator.trim();
+    REQUIRE(allocator.stats().mapped_bytes == 0);
+}
+
+namespace {
+
+// Two distinct call sites for the profile to tell apart
+__attribute__((noinline)) void* profiledKept(slab::PoolAllocator& allocator) { return allocator.allocate(64); }
+__attribute__((noinline)) void* profiledChurn(slab::PoolAllocator& allocator) { return allocator.allocate(512); }
+
+} // namespace
+
+TEST_CASE("Heap profile samples by bytes and tracks sampled objects until freed", "[pool_allocator][profile]") {
+    REQUIRE(slab::PoolAllocator().heap_profile().sites.empty());
+
+    for (bool thread_safe : {false, true}) {
+        slab::PoolOptions options;
+        options.thread_safe = thread_safe;
+        options.profile_sample_bytes = 4096;
+        slab::PoolAllocator allocator(options);
+
+        std::vector<void*> kept;
+        for (int i = 0; i < 20000; ++i) kept.push_back(profiledKept(allocator));
+        std::vector<void*> churn;
+        for (int i = 0; i < 10000; ++i) churn.push_back(profiledChurn(allocator));
+        allocator.deallocate_bulk(churn.data(), churn.size(), 512);
+
+        // About 300 live samples: within 30% is five standard deviations
+        slab::HeapProfile profile = allocator.heap_profile();
+        REQUIRE(profile.sample_bytes == 4096);
+        REQUIRE(profile.dropped_samples == 0);
+        CHECK(profile.estimated_live_bytes() > 0.7 * 20000 * 64);
+        CHECK(profile.estimated_live_bytes() < 1.3 * 20000 * 64);
+        CHECK(profile.estimated_alloc_bytes() > 0.7 * (20000 * 64 + 10000 * 512));
+        CHECK(profile.estimated_alloc_bytes() < 1.3 * (20000 * 64 + 10000 * 512));
+
+        std::size_t kept_sites = 0, churn_sites = 0;
+        for (const slab::HeapProfile::Site& site : profile.sites) {
+            if (site.alloc_samples == 0) continue;
+            REQUIRE(site.depth > 0);
+            if (site.live_samples > 0) {
+                REQUIRE(site.live_bytes == 64 * site.live_samples);
+                ++kept_sites;
+            } else {
+                REQUIRE(site.alloc_bytes == 512 * site.alloc_samples);
+                ++churn_sites;
+            }
+        }
+        REQUIRE(kept_sites >= 1);
+        REQUIRE(churn_sites >= 1);
+
+        std::ostringstream pprof;
+        profile.write_pprof(pprof);
+        REQUIRE(pprof.str().rfind("heap profile: ", 0) == 0);
+        REQUIRE(pprof.str().find("@ heap_v2/4096\n") != std::string::npos);
+        REQUIRE(pprof.str().find("MAPPED_LIBRARIES:") != std::string::npos);
+        std::ostringstream text;
+        profile.write_text(text, 2);
+        REQUIRE(text.str().find("bytes live") != std::string::npos);
+        std::size_t end = text.str().size();
+        text << 0.25;
+        REQUIRE(text.str().substr(end) == "0.25");
+
+        // Sampled large objects survive a remap; everything freed leaves nothing live
+        void* large = allocator.allocate(1 << 20);
+        large = allocator.reallocate(large, 4 << 20);
+        allocator.deallocate(large);
+        for (std::size_t i = 0; i < kept.size(); ++i) {
+            if (i % 2 == 0) allocator.deallocate(kept[i]);
+            else allocator.deallocate(kept[i], 64);
+        }
+        profile = allocator.heap_profile();
+        REQUIRE(profile.estimated_live_bytes() == 0);
+        REQUIRE(profile.estimated_alloc_bytes() > 20000 * 64);
+    }
+}
+
+TEST_CASE("A reallocate that cannot move keeps the block's sample", "[pool_allocator][profile][realloc]") {
+    for (bool thread_safe : {false, true}) {
+        slab::PoolOptions options;
+        options.thread_safe = thread_safe;
+        options.profile_sample_bytes = 1;   // every allocation is sampled
+        slab::PoolAllocator allocator(options);
+        auto live = [&] {
+            std::uint64_t samples = 0, bytes = 0;
+            for (const slab::HeapProfile::Site& site : allocator.heap_profile().sites) {
+                samples += site.live_samples;
+                bytes += site.live_bytes;
+            }
+            return std::make_pair(samples, bytes);
+        };
+
+        void* ptr = allocator.allocate(64);
+        REQUIRE(live() == std::make_pair(std::uint64_t{1}, std::uint64_t{64}));
+
+        REQUIRE(allocator.reallocate(ptr, std::size_t{1} << 62) == nullptr);   // no room to move
+        CHECK(live() == std::make_pair(std::uint64_t{1}, std::uint64_t{64}));
+
+        ptr = allocator.reallocate(ptr, 4096);
+        REQUIRE(ptr != nullptr);
+        CHECK(live() == std::make_pair(std::uint64_t{1}, std::uint64_t{4096}));
+        allocator.deallocate(ptr);
+        CHECK(live().first == 0);
+    }
+}
+
+TEST_CASE("SharedPool allocates by offset and every mapping sees the same objects", "[shared_pool]") {
+    std::string name = "/slab_test_" + std::to_string(getpid());
+    slab::SharedPool::unlink(name.c_str());
+    slab::SharedPool pool(name.c_str(), 1 << 20);
+    REQUIRE(pool.valid());
+    REQUIRE(!slab::SharedPool(name.c_str(), 1 << 20).valid());   // exists already
+
+    REQUIRE(pool.allocate(0) == slab::SharedPool::kNull);
+    REQUIRE(pool.allocate(slab::SharedPool::kMaxSize + 1) == slab::SharedPool::kNull);
+
+    std::vector<std::pair<slab::SharedPool::Offset, std::size_t>> objects;
+    for (std::size_t size : {1, 16, 17, 100, 1000, 4096, 16384}) {
+        slab::SharedPool::Offset offset = pool.allocate(size);
+        REQUIRE(offset != slab::SharedPool::kNull);
+        std::size_t chunk = std::max<std::size_t>(std::bit_ceil(size), slab::SharedPool::kMinChunk);
+        REQUIRE(offset % std::min<std::size_t>(chunk, 4096) == 0);
+        std::memset(pool.at(offset), static_cast<int>(size), size);
+        objects.emplace_back(offset, size);
+    }
+
+    {
+        // A second mapping, at another address: same bytes at the same offsets
+        slab::SharedPool other(name.c_str());
+        REQUIRE(other.valid());
+        REQUIRE(other.region_bytes() == pool.region_bytes());
+        for (auto [offset, size] : objects) {
+            REQUIRE(other.at(offset) != pool.at(offset));
+            REQUIRE(std::memcmp(other.at(offset), pool.at(offset), size) == 0);
+        }
+        // Freed through one mapping, reused through the other
+        REQUIRE(other.deallocate(objects[3].first));
+        REQUIRE(pool.allocate(100) == objects[3].first);
+    }
+
+    REQUIRE(!pool.deallocate(slab::SharedPool::kNull));
+    REQUIRE(!pool.deallocate(objects[4].first + 8));
+    REQUIRE(!pool.deallocate(pool.region_bytes()));
+    REQUIRE(!pool.deallocate(pool.region_bytes() - slab::SharedPool::kSlabBytes));   // not carved yet
+
+    // Running out of slabs fails only the classes that need a new one
+    while (pool.allocate(16384) != slab::SharedPool::kNull) {}
+    REQUIRE(pool.used_bytes() == 1 << 20);
+    REQUIRE(pool.allocate(16) != slab::SharedPool::kNull);
+
+    REQUIRE(slab::SharedPool::unlink(name.c_str()));
+    REQUIRE(!slab::SharedPool(name.c_str()).valid());
+    REQUIRE(pool.at(objects[0].first) != nullptr);   // the mapping outlives the name
+}
+
+TEST_CASE("SharedPool passes objects between processes by offset", "[shared_pool]") {
+    std::string name = "/slab_test_" + std::to_string(getpid());
+    slab::SharedPool::unlink(name.c_str());
+    slab::SharedPool pool(name.c_str(), 16 << 20);
+    REQUIRE(pool.valid());
+
+    struct Message {
+        std::uint32_t index;
+        std::uint32_t size;   // payload bytes that follow
+    };
+    auto payload = [](const Message* message) { return reinterpret_cast<const unsigned char*>(message + 1); };
+    constexpr std::uint32_t kMessages = 20000;
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+
+    pid_t child = fork();
+    REQUIRE(child >= 0);
+    if (child == 0) {
+        // Maps the region by name, as an unrelated process would; frees of
+        // its own race the parent's on the same free lists
+        close(fds[0]);
+        slab::SharedPool sender(name.c_str());
+        if (!sender.valid()) _exit(1);
+        for (std::uint32_t i = 0; i < kMessages; ++i) {
+            std::uint32_t size = 64 + i % 200;
+            slab::SharedPool::Offset offset;
+            while ((offset = sender.allocate(sizeof(Message) + size)) == slab::SharedPool::kNull) sched_yield();
+            Message* message = sender.get<Message>(offset);
+            message->index = i;
+            message->size = size;
+            std::memset(message + 1, static_cast<int>(i), size);
+            if (i % 3 == 0) sender.deallocate(sender.allocate(sizeof(Message) + size));
+            if (write(fds[1], &offset, sizeof(offset)) != sizeof(offset)) _exit(1);
+        }
+        close(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    bool intact = true, freed = true;
+    std::uint32_t received = 0;
+    slab::SharedPool::Offset offset;
+    while (read(fds[0], &offset, sizeof(offset)) == sizeof(offset)) {
+        const Message* message = pool.get<Message>(offset);
+        intact = intact && message->index == received && message->size == 64 + received % 200 &&
+                 payload(message)[0] == static_cast<unsigned char>(received) &&
+                 payload(message)[message->size - 1] == static_cast<unsigned char>(received);
+        freed = freed && pool.deallocate(offset);
+        ++received;
+    }
+    close(fds[0]);
+    int status = 0;
+    REQUIRE(waitpid(child, &status, 0) == child);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+    REQUIRE(received == kMessages);
+    REQUIRE(intact);
+    REQUIRE(freed);
+
+    // Everything came back: another round fits in the slabs already carved
+    std::size_t used = pool.used_bytes();
+    std::vector<slab::SharedPool::Offset> again;
+    for (std::uint32_t i = 0; i < 1000; ++i) again.push_back(pool.allocate(sizeof(Message) + 64 + i % 200));
+    REQUIRE(pool.used_bytes() == used);
+    for (slab::SharedPool::Offset chunk : again) REQUIRE(pool.deallocate(chunk));
+    slab::SharedPool::unlink(name.c_str());
+}